@@ -8,7 +8,250 @@
 #include <stdbool.h>
 #include <pthread.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef void* AD_POINTER; /* find bit depth independent pointer type */
+
+/* pool flags (set ypool_STC.flags before ypool_init()) */
+#define YPOOL_FLAG_LOCKFREE    (1u << 0) /* Treiber stack with tagged head instead of mutex protected free list */
+#define YPOOL_FLAG_TCACHE      (1u << 1) /* per-thread block caches in front of the shared free list */
+#define YPOOL_FLAG_COMPACT     (1u << 2) /* no per-block header: free list link lives in free block payload, allocation state in side bitmap */
+#define YPOOL_FLAG_MMAP        (1u << 3) /* arena from anonymous mmap instead of malloc */
+#define YPOOL_FLAG_HUGEPAGES   (1u << 4) /* mmap arena with MAP_HUGETLB, fall back to transparent huge pages (implies YPOOL_FLAG_MMAP) */
+#define YPOOL_FLAG_POPULATE    (1u << 5) /* pre-fault whole arena in ypool_init() (implies YPOOL_FLAG_MMAP) */
+#define YPOOL_FLAG_MLOCK       (1u << 6) /* lock arena in RAM (implies YPOOL_FLAG_MMAP) */
+#define YPOOL_FLAG_LAZY        (1u << 7) /* O(1) init: never used blocks are handed out by bump cursor, no yformat() pass */
+#define YPOOL_FLAG_GROWABLE    (1u << 8) /* map new slab instead of -ENOMEM (mutex mode, not YPOOL_FLAG_COMPACT) */
+#define YPOOL_FLAG_SHARED      (1u << 9) /* arena & free list in shm_open/memfd mapping shared between processes (implies YPOOL_FLAG_LOCKFREE) */
+#define YPOOL_FLAG_PERSISTENT  (1u << 10) /* arena & free list in file mapping, re-attached by next ypool_init() as is (implies YPOOL_FLAG_SHARED) */
+#define YPOOL_FLAG_NUMA        (1u << 11) /* sub-pool per NUMA node bound with mbind, blocks come from caller's node (implies YPOOL_FLAG_MMAP) */
+#define YPOOL_FLAG_HARDENED    (1u << 12) /* exact block ownership check & allocation bitmap as the only allocation state (not YPOOL_FLAG_GROWABLE) */
+#define YPOOL_FLAG_CANARY      (1u << 13) /* guard word after every block, checked by free (implies YPOOL_FLAG_HARDENED) */
+#define YPOOL_FLAG_POISON      (1u << 14) /* fill freed blocks with YPOOL_POISON_BYTE (implies YPOOL_FLAG_HARDENED) */
+#define YPOOL_FLAG_LOWFIRST    (1u << 15) /* lowest free block first: allocation bitmap with summary levels instead of LIFO free list (mutex mode, not YPOOL_FLAG_GROWABLE) */
+#define YPOOL_FLAG_ZEROTRACK   (1u << 16) /* track blocks known to be zero, yalloc_block_zeroed() clears dirty blocks only (not YPOOL_FLAG_GROWABLE) */
+#define YPOOL_FLAG_TRACE       (1u << 17) /* record alloc/free events to per-thread rings, read by ypool_trace_dump() */
+#define YPOOL_FLAG_EPOCH       (1u << 18) /* epoch-based reclamation: ypool_enter()/ypool_exit() read sections, yfree_block_deferred() */
+
+/* arena backing actually got by ypool_init() (ypool_STC.backing) */
+#define YPOOL_BACKING_MMAP        (1u << 0) /* anonymous mmap (malloc otherwise) */
+#define YPOOL_BACKING_HUGETLB     (1u << 1) /* explicit huge pages (MAP_HUGETLB) */
+#define YPOOL_BACKING_THP         (1u << 2) /* transparent huge pages requested with madvise */
+#define YPOOL_BACKING_POPULATED   (1u << 3) /* arena is pre-faulted */
+#define YPOOL_BACKING_LOCKED      (1u << 4) /* arena is locked with mlock */
+#define YPOOL_BACKING_SHARED      (1u << 5) /* MAP_SHARED mapping with ypool_shm_STC header (YPOOL_FLAG_SHARED) */
+#define YPOOL_BACKING_NUMA        (1u << 6) /* arena is bound to its node with mbind (YPOOL_FLAG_NUMA, all nodes) */
+
+#ifndef YPOOL_HUGEPAGE_SIZE
+#define YPOOL_HUGEPAGE_SIZE    (2u * 1024 * 1024)
+#endif
+
+/* per-thread cache geometry (YPOOL_FLAG_TCACHE) */
+#ifndef YTCACHE_SIZE
+#define YTCACHE_SIZE    32 /* max blocks cached by one thread (high-water mark) */
+#endif
+#ifndef YTCACHE_BATCH
+#define YTCACHE_BATCH   16 /* blocks moved between thread cache & shared free list at once */
+#endif
+
+/* freed block filler (YPOOL_FLAG_POISON) */
+#ifndef YPOOL_POISON_BYTE
+#define YPOOL_POISON_BYTE   0xDB
+#endif
+
+/* zeroed allocation (yalloc_block_zeroed()) */
+#ifndef YPOOL_ZERO_NT_SIZE
+#define YPOOL_ZERO_NT_SIZE  (16u * 1024) /* blocks from this size are cleared with non-temporal stores (bypass the cache) */
+#endif
+
+/* allocation tracing (YPOOL_FLAG_TRACE) */
+#ifndef YPOOL_TRACE_EVENTS
+#define YPOOL_TRACE_EVENTS  4096 /* events kept per thread (power of 2), older ones are overwritten */
+#endif
+
+/* address to pool map (ypool_lookup(), yfree()): 3 map levels over user address space, grains at unaligned arena ends are found by range */
+#define YPOOL_MAP_SHIFT      12 /* grain: 4KB */
+#define YPOOL_MAP_GRAIN      (1ul << YPOOL_MAP_SHIFT)
+#define YPOOL_MAP_BITS       48 /* user address bits */
+#define YPOOL_MAP_LEVEL_BITS 12 /* (YPOOL_MAP_BITS - YPOOL_MAP_SHIFT) / 3 */
+#define YPOOL_MAP_FANOUT     (1ul << YPOOL_MAP_LEVEL_BITS)
+
+/* epoch-based reclamation (YPOOL_FLAG_EPOCH): garbage is bounded by 3 bags per thread */
+#ifndef YPOOL_EBR_BATCH
+#define YPOOL_EBR_BATCH  64 /* retired blocks per bag, a bag goes back to the free list at once */
+#endif
+
+/* NUMA sub-pools (YPOOL_FLAG_NUMA) */
+#ifndef YNUMA_MAX_NODES
+#define YNUMA_MAX_NODES   64 /* nodes with higher id share sub-pools (node id % YNUMA_MAX_NODES) */
+#endif
+
+/* summary levels over allocation bitmap (YPOOL_FLAG_LOWFIRST): pools up to 64^(YPOOL_LOW_LEVELS + 1) blocks */
+#define YPOOL_LOW_LEVELS   5
+
+/* idle memory release (ypool_trim()) */
+#ifndef YPOOL_TRIM_PAGES
+#define YPOOL_TRIM_PAGES   64 /* pages released per mutex hold (never used blocks of mutex mode pool) */
+#endif
+#ifndef YPOOL_TRIM_INTERVAL_MS
+#define YPOOL_TRIM_INTERVAL_MS 100 /* min time between trims started from free (pool->trim_threshold) */
+#endif
+
+/* live block iteration (ypool_cursor_next(), ypool_for_each_allocated()) */
+#ifndef YPOOL_SCAN_WORDS
+#define YPOOL_SCAN_WORDS   64 /* bitmap words (64 blocks each) scanned per mutex hold, header pools scan 64 * YPOOL_SCAN_WORDS blocks */
+#endif
+#ifndef YPOOL_VISIT_BATCH
+#define YPOOL_VISIT_BATCH  64 /* blocks collected by ypool_for_each_allocated() before callbacks run */
+#endif
+
+/* pool statistics (STATS == 1) */
+#ifndef YSTATS_SHARDS
+#define YSTATS_SHARDS   16 /* counter shards per pool, threads are spread over them (power of 2) */
+#endif
+
+typedef struct _ystats_shard
+{
+    uint64_t           allocs;
+    uint64_t           frees;
+    uint64_t           enomem;
+    uint64_t           exdev;
+    uint64_t           ealready;
+    uint64_t           eoverflow;      /* frees of blocks with damaged guard word (YPOOL_FLAG_CANARY) */
+    uint64_t           mutex_waits;    /* contended mutex acquisitions */
+    uint64_t           mutex_wait_ns;
+}__attribute__((aligned(64))) ystats_shard_STC;
+
+typedef struct _ypool_stats
+{
+    size_t             total_blocks;
+    size_t             used_blocks;
+    size_t             free_blocks;
+    size_t             peak_used;      /* high-water mark of used_blocks */
+    uint64_t           allocs;
+    uint64_t           frees;
+    uint64_t           enomem;
+    uint64_t           exdev;
+    uint64_t           ealready;
+    uint64_t           eoverflow;
+    uint64_t           mutex_waits;
+    uint64_t           mutex_wait_ns;
+}ypool_stats_STC;
+
+typedef struct _yslab
+{
+    AD_POINTER         start_PTR;
+    AD_POINTER         end_PTR;    /* end of the last block */
+    size_t             map_size;
+}yslab_STC;
+
+typedef struct _ymap_range
+{
+    AD_POINTER         start_PTR;
+    AD_POINTER         end_PTR;
+    struct _ypool    * pool;
+}ymap_range_STC;
+
+typedef struct _yslab_index
+{
+    struct _yslab_index * prev;    /* replaced index (lock-free readers may still use it) */
+    size_t             count;
+    yslab_STC          slabs[];    /* sorted by start_PTR */
+}yslab_index_STC;
+
+/* header of shared mapping (YPOOL_FLAG_SHARED), arena follows it */
+#define YPOOL_SHM_MAGIC         0x4C4F4F5044415959ull /* "YYADPOOL" */
+#define YPOOL_SHM_VERSION       1
+#define YPOOL_SHM_HEADER_SIZE   64
+
+typedef struct _ypool_shm
+{
+    uint64_t           magic;      /* set last, when pool is formatted */
+    uint32_t           version;
+    uint32_t           flags;      /* YPOOL_FLAG_* of the creator */
+    uint64_t           block_size;
+    uint64_t           pool_size;
+    uint64_t           lf_head;    /* shared ypool_STC.lf_head */
+    size_t             bump_index; /* shared ypool_STC.bump_index */
+    uint32_t           clean;      /* 1 - the last user detached with ypool_close() (pool state is consistent) */
+}ypool_shm_STC;
+
+/* position of the pool bump cursor (ypool_mark()/ypool_release()) */
+typedef struct _ypool_mark
+{
+    size_t             bump_index;
+    uint64_t           resets;     /* ypool_reset() count when mark was taken */
+    uint64_t           used;       /* STATS: used blocks when mark was taken */
+}ypool_mark_STC;
+
+/* trace event (ytrace_event_STC.op) */
+#define YTRACE_ALLOC   1
+#define YTRACE_FREE    2
+
+/* header of ypool_trace_dump() output, events follow it */
+#define YTRACE_MAGIC    0x3145434152544459ull /* "YDTRACE1" */
+#define YTRACE_VERSION  1
+
+typedef struct _ytrace_event
+{
+    uint64_t           ticks;      /* trace clock: TSC on x86, CLOCK_MONOTONIC ns otherwise */
+    uint64_t           block;      /* user block (0 - allocation failed) */
+    uint64_t           caller;     /* return address of yalloc_block()/yfree_block() call */
+    uint32_t           thread;     /* kernel thread id */
+    uint16_t           op;         /* YTRACE_ALLOC, YTRACE_FREE */
+    int16_t            ret;        /* call result (0 or -errno) */
+}ytrace_event_STC;
+
+typedef struct _ytrace_header
+{
+    uint64_t           magic;
+    uint32_t           version;
+    uint32_t           event_size; /* sizeof(ytrace_event_STC) */
+    uint64_t           block_size;
+    uint64_t           start_ticks; /* trace clock & CLOCK_MONOTONIC ns taken by ypool_init() ... */
+    uint64_t           start_ns;
+    uint64_t           dump_ticks;  /* ... & by ypool_trace_dump(): ticks to ns scale */
+    uint64_t           dump_ns;
+    uint64_t           events;     /* events after the header (ring order, not sorted) */
+    uint64_t           lost;       /* events overwritten before the dump */
+}ytrace_header_STC;
+
+/* per-thread event ring (YPOOL_FLAG_TRACE) */
+typedef struct _ytrace_ring
+{
+    struct _ytrace_ring * next;    /* rings of all threads, never removed */
+    uint32_t           owned;      /* 1 - ring is used by a live thread, 0 - free for next new thread */
+    uint32_t           thread;     /* kernel thread id of the owner */
+    uint64_t           head;       /* events written (single writer, ring index = head % YPOOL_TRACE_EVENTS) */
+    ytrace_event_STC   events[YPOOL_TRACE_EVENTS];
+}ytrace_ring_STC;
+
+typedef struct _yebr_bag
+{
+    uint64_t           epoch;      /* global epoch the blocks were retired in */
+    uint64_t           resets;     /* pool->resets at retire (bag is dropped by ypool_reset()) */
+    size_t             count;
+    AD_POINTER         blocks[YPOOL_EBR_BATCH];
+}yebr_bag_STC;
+
+typedef struct _yebr_record
+{
+    struct _yebr_record * next;    /* records of all threads, never removed */
+    uint32_t           owned;      /* 1 - record is used by a live thread (or being reclaimed), 0 - free for next new thread */
+    uint32_t           nesting;    /* ypool_enter() depth */
+    uint64_t           active;     /* (epoch << 1) | 1 inside read section, 0 - quiescent */
+    yebr_bag_STC       bags[3];    /* bag of epoch e is bags[e % 3] */
+}yebr_record_STC;
+
+typedef struct _ywaiter
+{
+    pthread_cond_t     cond;
+    AD_POINTER         block;      /* user block handed over by free (NULL - still waiting) */
+    struct _ywaiter  * next;
+}ywaiter_STC;
+
 typedef struct _ypool
 {
     AD_POINTER         start_PTR;
@@ -17,8 +260,71 @@ typedef struct _ypool
     AD_POINTER         next_free_block_PTR;
     pthread_mutex_t    mutex;
     /* ToDo: mb implement free space (if needed quck free space info) */
+    uint32_t           flags;
+    uint64_t           lf_head;  /* YPOOL_FLAG_LOCKFREE: [63..32] ABA tag, [31..0] index of first free block + 1 (0 - pool is empty) */
+    pthread_key_t      tcache_key; /* YPOOL_FLAG_TCACHE: thread's ytcache_STC */
+    uint64_t         * alloc_map;  /* YPOOL_FLAG_COMPACT, YPOOL_FLAG_HARDENED: 1 bit per block (set - allocated) */
+    uint32_t           backing;    /* YPOOL_BACKING_* */
+    size_t             arena_size; /* mapped arena length (YPOOL_BACKING_MMAP) */
+    size_t             bump_index; /* blocks from bump_index to the pool end were never used (YPOOL_FLAG_LAZY) */
+    uint32_t           growth_factor; /* YPOOL_FLAG_GROWABLE: new slab size = previous slab size * growth_factor (0, 1 - same size) */
+    size_t             max_pool_size; /* YPOOL_FLAG_GROWABLE: limit for pool size with all slabs (0 - unlimited) */
+    size_t             total_blocks;  /* blocks in arena & all slabs */
+    size_t             slab_blocks;   /* blocks in the newest slab (or arena) */
+    yslab_index_STC  * slab_index;    /* YPOOL_FLAG_GROWABLE: slabs except arena */
+    uint32_t           waiters;       /* threads inside yalloc_block_wait() slow path */
+    ywaiter_STC      * wait_head;     /* FIFO of parked yalloc_block_wait() callers (under the mutex) */
+    ywaiter_STC      * wait_tail;
+    uint64_t         * lf_head_PTR;    /* lf_head, or lf_head in shared mapping (YPOOL_FLAG_SHARED) */
+    size_t           * bump_index_PTR; /* bump_index, or bump_index in shared mapping (YPOOL_FLAG_SHARED) */
+    const char       * shm_name;   /* YPOOL_FLAG_SHARED: shm_open() name to create or attach (NULL - memfd) */
+    int                shm_fd;     /* YPOOL_FLAG_SHARED: memfd to attach (0 - create new one), set by ypool_init() */
+    ypool_shm_STC    * shm;        /* YPOOL_FLAG_SHARED: mapping header */
+    const char       * file_path;  /* YPOOL_FLAG_PERSISTENT: pool file to create or attach */
+    ystats_shard_STC * stats;      /* STATS: YSTATS_SHARDS counter shards (counters of this process) */
+    int64_t            stats_peak; /* STATS: peak of stats_used */
+    int64_t            stats_used; /* STATS: allocs - frees of all shards (may go below 0 for a moment: block freed before its allocation is counted) */
+    struct _ypool    * numa_pools; /* YPOOL_FLAG_NUMA: sub-pool per node (index - node id) */
+    uint32_t           numa_nodes; /* YPOOL_FLAG_NUMA: sub-pools count */
+    uint32_t           numa_node;  /* sub-pool of YPOOL_FLAG_NUMA pool: node its arena is bound to */
+    uint64_t           canary;     /* YPOOL_FLAG_CANARY: guard word secret (guard = canary ^ block address) */
+    uint64_t           stride_magic; /* YPOOL_FLAG_HARDENED, YPOOL_FLAG_LOWFIRST: 2^64 / stride rounded up (arena under 4GB, 0 - divide) */
+    uint64_t           epoch;      /* incremented by ypool_reset()/ypool_release(): thread caches of older epoch are dropped */
+    uint64_t           resets;     /* ypool_reset() count: marks taken before are stale */
+    uint64_t         * full_map[YPOOL_LOW_LEVELS]; /* YPOOL_FLAG_LOWFIRST: summary levels, bit set - word of the level below is full */
+    uint32_t           full_levels; /* YPOOL_FLAG_LOWFIRST: used summary levels (top one is a single word) */
+    size_t             trim_threshold; /* bytes freed since the last trim which start ypool_trim() from free (0 - manual trim only) */
+    size_t             trim_pending;   /* bytes freed since the last trim */
+    uint64_t           trim_next;      /* CLOCK_MONOTONIC ns before which free doesn't start a trim */
+    uint64_t         * dirty_map;      /* YPOOL_FLAG_ZEROTRACK: 1 bit per block (set - payload may be not zero) */
+    pthread_key_t      trace_key;      /* YPOOL_FLAG_TRACE: thread's ytrace_ring_STC */
+    ytrace_ring_STC  * trace_rings;    /* YPOOL_FLAG_TRACE: rings of all threads */
+    uint64_t           trace_ticks;    /* YPOOL_FLAG_TRACE: trace clock at ypool_init() */
+    uint64_t           trace_ns;       /* YPOOL_FLAG_TRACE: CLOCK_MONOTONIC ns at ypool_init() */
+    pthread_key_t      ebr_key;        /* YPOOL_FLAG_EPOCH: thread's yebr_record_STC */
+    yebr_record_STC  * ebr_records;    /* YPOOL_FLAG_EPOCH: records of all threads */
+    uint64_t           ebr_epoch;      /* YPOOL_FLAG_EPOCH: global epoch, blocks retired in epoch e are freed from epoch e + 2 */
 }ypool_STC;
 
+/* position of live block iteration (ypool_cursor_init()) */
+typedef struct _ypool_cursor
+{
+    ypool_STC        * pool;
+    uint32_t           node;       /* YPOOL_FLAG_NUMA: sub-pool being scanned */
+    size_t             index;      /* next block index to scan */
+}ypool_cursor_STC;
+
+/* ypool_for_each_allocated() callback (not 0 - stop iteration) */
+typedef int (*ypool_visit_FN)(AD_POINTER user_block, void *ctx);
+
+typedef struct _ytcache
+{
+    ypool_STC     * pool;
+    uint64_t        epoch;      /* pool->epoch of cached blocks */
+    size_t          count;
+    AD_POINTER      blocks[YTCACHE_SIZE]; /* cached system blocks (last one is the hottest) */
+}ytcache_STC;
+
 typedef struct __attribute__((__packed__)) _yblock
 {
     AD_POINTER    next_block;
@@ -29,13 +335,116 @@ typedef struct __attribute__((__packed__)) _yblock
 /* public funcs */
 int ypool_init(ypool_STC *pool);
 int yalloc_block(ypool_STC *pool, AD_POINTER *block);
+int yalloc_block_zeroed(ypool_STC *pool, AD_POINTER *block);
 int yfree_block(ypool_STC *pool, AD_POINTER *user_block);
+int yalloc_blocks(ypool_STC *pool, size_t count, AD_POINTER user_blocks[]);
+int yfree_blocks(ypool_STC *pool, size_t count, AD_POINTER user_blocks[]);
+int yalloc_block_wait(ypool_STC *pool, AD_POINTER *block, long timeout_us);
+int ypool_close(ypool_STC *pool);
+int ypool_get_stats(ypool_STC *pool, ypool_stats_STC *stats);
+int ypool_get_node_stats(ypool_STC *pool, uint32_t node, ypool_stats_STC *stats);
+int ypool_reset(ypool_STC *pool);
+int ypool_mark(ypool_STC *pool, ypool_mark_STC *mark);
+int ypool_release(ypool_STC *pool, ypool_mark_STC *mark);
+int ypool_trim(ypool_STC *pool, size_t *released);
+int ypool_cursor_init(ypool_STC *pool, ypool_cursor_STC *cursor);
+int ypool_cursor_next(ypool_cursor_STC *cursor, size_t count, AD_POINTER user_blocks[]);
+int ypool_for_each_allocated(ypool_STC *pool, ypool_visit_FN visit, void *ctx);
+int ypool_trace_dump(ypool_STC *pool, int fd);
+int ypool_lookup(AD_POINTER user_block, ypool_STC **pool);
+int ypool_enter(ypool_STC *pool);
+int ypool_exit(ypool_STC *pool);
+int yfree_block_deferred(ypool_STC *pool, AD_POINTER user_block);
+int ypool_synchronize(ypool_STC *pool);
 
 /* private funcs */
 static int yformat(ypool_STC *pool);
+static AD_POINTER yarena_alloc(ypool_STC *pool, size_t size);
+static AD_POINTER yarena_map(ypool_STC *pool, size_t size, size_t *map_size, uint32_t *backing);
+static AD_POINTER ymap_aligned(size_t size, size_t align);
+static void yarena_prefault(AD_POINTER arena, size_t size);
+static void yarena_free(ypool_STC *pool);
+static void yslabs_free(ypool_STC *pool);
+static int ykeys_create(ypool_STC *pool);
+static void ykeys_delete(ypool_STC *pool);
+static int ymap_set(AD_POINTER start, size_t size, ypool_STC *pool);
+static ypool_STC **ymap_entry(uintptr_t grain, bool create);
+static int yrange_set(AD_POINTER start, size_t size, ypool_STC *pool);
+static ypool_STC *yrange_find(AD_POINTER address);
+static int yshm_init(ypool_STC *pool, size_t blocks_in_pool);
+static int yshm_lock(int fd, off_t byte, short type, bool wait);
 static bool yblock_belongs_to_pool(ypool_STC *pool, AD_POINTER user_block);
 static int ypool_check(ypool_STC *pool);
 static size_t sys_block_size(size_t user_block_size);
+static size_t yblock_stride(ypool_STC *pool);
+static size_t yblock_header(ypool_STC *pool);
+static void ymark_allocated(ypool_STC *pool, AD_POINTER sys_block);
+static int yclaim_free(ypool_STC *pool, AD_POINTER sys_block);
+static size_t yblock_index(ypool_STC *pool, AD_POINTER sys_block);
+static uint64_t ycanary_of(ypool_STC *pool, AD_POINTER sys_block);
+static int ylf_pop(ypool_STC *pool, AD_POINTER *sys_block);
+static void ylf_splice(ypool_STC *pool, AD_POINTER first, AD_POINTER last);
+static size_t ylf_pop_chain(ypool_STC *pool, size_t count, AD_POINTER sys_blocks[]);
+static size_t ybump(ypool_STC *pool, size_t count, size_t *first_index);
+static size_t ybump_chain(ypool_STC *pool, size_t count, AD_POINTER sys_blocks[]);
+static yslab_STC *yslab_find(ypool_STC *pool, AD_POINTER user_block);
+static int ygrow(ypool_STC *pool);
+static int ypop_block(ypool_STC *pool, AD_POINTER *sys_block);
+static void ylock(ypool_STC *pool);
+static ystats_shard_STC *ystats_shard(ypool_STC *pool);
+static void ystats_alloc(ypool_STC *pool, int ret, size_t count);
+static void ystats_free(ypool_STC *pool, int ret, size_t count);
+static void ystats_uncount_enomem(ypool_STC *pool);
+static uint64_t ystats_used(ypool_STC *pool);
+static void ystats_drop(ypool_STC *pool, uint64_t used);
+static void yrewind(ypool_STC *pool, size_t bump_index);
+static int ylow_init(ypool_STC *pool, size_t blocks_in_pool);
+static void ylow_format(ypool_STC *pool);
+static size_t ylow_find(ypool_STC *pool);
+static void ylow_set(ypool_STC *pool, size_t index);
+static void ylow_clear(ypool_STC *pool, size_t index);
+static bool ytrim_pages(ypool_STC *pool, size_t page, size_t *first, size_t *end, AD_POINTER *from, AD_POINTER *to);
+static int ytrim_runs(ypool_STC *pool, size_t page, size_t *released);
+static int ytrim_tail(ypool_STC *pool);
+static int ytrim_bump(ypool_STC *pool, size_t page, size_t *released);
+static void ytrim_auto(ypool_STC *pool, size_t freed);
+static void ydirty_mark(ypool_STC *pool, size_t first, size_t end, bool dirty);
+static void ydirty_drop(ypool_STC *pool, size_t first, size_t end);
+static void ydirty_trimmed(ypool_STC *pool, AD_POINTER from, AD_POINTER to);
+static void yzero(AD_POINTER block, size_t size);
+static size_t yscan(ypool_STC *pool, size_t *index, size_t count, AD_POINTER user_blocks[]);
+static int ynuma_init(ypool_STC *pool, size_t blocks_in_pool);
+static uint32_t ynuma_nodes(void);
+static uint32_t ynuma_current(ypool_STC *pool);
+static int ynuma_bind(AD_POINTER arena, size_t size, uint32_t node);
+static ypool_STC *ynuma_owner(ypool_STC *pool, AD_POINTER user_block);
+static int ynuma_alloc(ypool_STC *pool, size_t count, AD_POINTER user_blocks[]);
+static int ynuma_free_blocks(ypool_STC *pool, size_t count, AD_POINTER user_blocks[]);
+static void ywaiters_feed(ypool_STC *pool);
+static void ywake_waiters(ypool_STC *pool);
+static void ywaiter_wake(ypool_STC *pool, AD_POINTER user_block);
+static size_t ypop_chain(ypool_STC *pool, size_t count, AD_POINTER sys_blocks[]);
+static void ychain_link(ypool_STC *pool, AD_POINTER sys_block, AD_POINTER next_sys_block);
+static void ysplice_chain(ypool_STC *pool, AD_POINTER first, AD_POINTER last);
+static void ypush_chain(ypool_STC *pool, size_t count, AD_POINTER sys_blocks[]);
+static ytcache_STC *ytcache_get(ypool_STC *pool);
+static int ytcache_alloc(ytcache_STC *cache, AD_POINTER *user_block);
+static int ytcache_free(ytcache_STC *cache, AD_POINTER user_block);
+static void ytcache_destroy(void *cache);
+static int yalloc_block_at(ypool_STC *pool, AD_POINTER *user_block, AD_POINTER caller);
+static int yfree_block_at(ypool_STC *pool, AD_POINTER *user_block, AD_POINTER caller);
+static void ytrace(ypool_STC *pool, uint16_t op, int ret, AD_POINTER user_block, AD_POINTER caller);
+static ytrace_ring_STC *ytrace_ring(ypool_STC *pool);
+static void ytrace_release(void *ring);
+static uint64_t ytrace_clock(void);
+static uint64_t ytrace_ns(void);
+static int ywrite_all(int fd, const void *data, size_t size);
+static yebr_record_STC *yebr_record(ypool_STC *pool);
+static void yebr_release(void *record);
+static bool yebr_advance(ypool_STC *pool, uint64_t epoch);
+static void yebr_reclaim(ypool_STC *pool, yebr_record_STC *record);
+static void yebr_reclaim_orphans(ypool_STC *pool, yebr_record_STC *self);
+static void yebr_flush(ypool_STC *pool, yebr_bag_STC *bag);
 
 /* debug */
 #if DEBUG == 1
@@ -44,4 +453,8 @@ static int _yblock_print(yblock_STC* block, size_t user_block_size);
 static int _sysblock_print_raw(AD_POINTER data, size_t block_size);
 #endif
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif //ALLOCATOR_H
\ No newline at end of file
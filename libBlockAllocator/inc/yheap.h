@@ -0,0 +1,66 @@
+#ifndef YHEAP_H
+#define YHEAP_H
+
+#include "allocator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* size classes: 16 byte steps up to 128, then 4 classes per size doubling */
+#define YHEAP_MIN_SIZE        16
+#define YHEAP_MAX_SIZE        1024
+#define YHEAP_CLASS_COUNT     20
+#define YHEAP_SIZE_SHIFT      4     /* size to class lookup table granularity (log2 of YHEAP_MIN_SIZE) */
+
+/* default heap used by yalloc()/yfree() */
+#ifndef YHEAP_DEFAULT_POOL_SIZE
+#define YHEAP_DEFAULT_POOL_SIZE   (1024 * 1024) /* arena of every class pool */
+#endif
+#define YHEAP_DEFAULT_FLAGS   (YPOOL_FLAG_COMPACT | YPOOL_FLAG_LAZY | YPOOL_FLAG_TCACHE)
+
+typedef struct _yheap_class
+{
+    ypool_STC          pool;
+    uint64_t           allocs;
+    uint64_t           frees;
+    uint64_t           failures;   /* -ENOMEM */
+    uint64_t           peak;       /* high-water mark of allocated blocks */
+}yheap_class_STC;
+
+typedef struct _yheap_class_stats
+{
+    size_t             block_size;
+    size_t             capacity;   /* blocks in class pool */
+    size_t             used;       /* allocated blocks */
+    size_t             peak;
+    uint64_t           allocs;
+    uint64_t           frees;
+    uint64_t           failures;
+}yheap_class_stats_STC;
+
+typedef struct _yheap
+{
+    size_t             class_pool_size; /* arena size of every class pool (set before yheap_init()) */
+    uint32_t           flags;           /* YPOOL_FLAG_* of class pools (set before yheap_init()) */
+    bool               initialized;
+    yheap_class_STC    classes[YHEAP_CLASS_COUNT];
+}yheap_STC;
+
+/* public funcs */
+int yheap_init(yheap_STC *heap);
+int yheap_alloc(yheap_STC *heap, size_t size, AD_POINTER *block);
+int yheap_free(yheap_STC *heap, AD_POINTER block);
+int yheap_get_stats(yheap_STC *heap, yheap_class_stats_STC stats[YHEAP_CLASS_COUNT]);
+int yalloc(size_t size, AD_POINTER *block);
+int yfree(AD_POINTER block);
+
+/* private funcs */
+static yheap_class_STC *yheap_class_of(yheap_STC *heap, ypool_STC *pool);
+static void yheap_default_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //YHEAP_H
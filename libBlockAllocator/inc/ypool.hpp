@@ -0,0 +1,288 @@
+#ifndef YPOOL_HPP
+#define YPOOL_HPP
+
+/**
+    \file
+    \brief Header-only C++ block pool with compile-time geometry (C++17)
+
+    \details
+        Same free list design as ypool_STC in mutex mode: every system block
+        starts with next block pointer (NULL - block is allocated), freed blocks
+        are pushed to LIFO free list and never used blocks are handed out by bump
+        cursor, so there is no format pass. Block size & count are template
+        arguments: stride, arena size & ownership arithmetic are constants and
+        alloc/free are inlined into call sites. Arena is a member of the pool,
+        pools of any geometry can live in one binary next to autoconf.h pools.
+*/
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace yad {
+
+/* lock of the pool used by one thread only */
+struct ynull_mutex
+{
+    void lock() noexcept {}
+    void unlock() noexcept {}
+};
+
+/**
+    \brief Fixed size block pool
+
+    \tparam BlockSize User block size in bytes
+    \tparam Count Blocks in pool
+    \tparam Align Alignment of user blocks (power of 2, at least pointer alignment)
+    \tparam Mutex Lock type (ynull_mutex - single thread pool without locking)
+*/
+
+template <std::size_t BlockSize, std::size_t Count, std::size_t Align = alignof(void *), class Mutex = std::mutex>
+class ypool
+{
+    static_assert(BlockSize > 0 && Count > 0, "pool must have blocks");
+    static_assert((Align & (Align - 1)) == 0 && Align >= alignof(void *), "Align must be power of 2 not less than pointer alignment");
+
+public:
+    static constexpr std::size_t block_size  = BlockSize;
+    static constexpr std::size_t block_count = Count;
+    static constexpr std::size_t header      = Align;   /* next block pointer padded to user block alignment */
+    static constexpr std::size_t stride      = header + (BlockSize + Align - 1) / Align * Align;
+    static constexpr std::size_t arena_size  = stride * Count;
+
+    ypool() noexcept = default;
+    ypool(const ypool &) = delete;
+    ypool &operator=(const ypool &) = delete;
+
+    /**
+        \brief Allocate block from the pool
+        \param[out] *block Pointer to allocated memory
+        \return
+            -ENOMEM    - Pool has no free memory
+                     0 - Successfuly allocated block
+    */
+    int alloc_block(void **block) noexcept {
+        unsigned char *sys_block;
+        std::lock_guard<Mutex> guard(mutex_);
+
+        if (free_head_ != nullptr){
+            sys_block = free_head_;
+            free_head_ = (link(sys_block) != list_end()) ? link(sys_block) : nullptr;
+        }else if (bump_index_ < Count){
+            sys_block = arena_ + bump_index_++ * stride;
+        }else{
+            return -ENOMEM;
+        }
+
+        link(sys_block) = nullptr; /* allocated */
+        used_++;
+        *block = sys_block + header;
+
+        return 0;
+    }
+
+    /**
+        \brief Return block to the pool
+        \param[in] block Block allocated by alloc_block()
+        \return
+            -EXDEV     - Block is not belong the pool
+            -EALREADY  - Block is marked as free
+                     0 - Successfuly freed block
+    */
+    int free_block(void *block) noexcept {
+        unsigned char *sys_block;
+
+        if (!owns(block))
+            return -EXDEV;
+
+        sys_block = static_cast<unsigned char *>(block) - header;
+
+        std::lock_guard<Mutex> guard(mutex_);
+
+        if (!allocated(sys_block))
+            return -EALREADY;
+
+        link(sys_block) = (free_head_ != nullptr) ? free_head_ : list_end();
+        free_head_ = sys_block;
+        used_--;
+
+        return 0;
+    }
+
+    /**
+        \brief Check block before free
+        \param[in] block Pointer to check
+        \return
+            -EXDEV     - Block is not belong the pool
+            -EALREADY  - Block is marked as free
+                     0 - Block is allocated
+    */
+    int check_block(const void *block) noexcept {
+        if (!owns(block))
+            return -EXDEV;
+
+        std::lock_guard<Mutex> guard(mutex_);
+
+        return allocated(static_cast<const unsigned char *>(block) - header) ? 0 : -EALREADY;
+    }
+
+    /**
+        \brief Take allocated block out of use before it is freed
+        \details
+            Block is checked & marked in one locked step, so only one of threads
+            freeing the same block gets 0, others get -EALREADY. Claimed block
+            stays counted as used until release_block().
+        \param[in] block Block allocated by alloc_block()
+        \return
+            -EXDEV     - Block is not belong the pool
+            -EALREADY  - Block is marked as free or claimed already
+                     0 - Successfuly claimed block
+    */
+    int claim_block(void *block) noexcept {
+        unsigned char *sys_block;
+
+        if (!owns(block))
+            return -EXDEV;
+
+        sys_block = static_cast<unsigned char *>(block) - header;
+
+        std::lock_guard<Mutex> guard(mutex_);
+
+        if (!allocated(sys_block))
+            return -EALREADY;
+
+        link(sys_block) = claimed();
+
+        return 0;
+    }
+
+    /* return block claimed by claim_block() to the pool */
+    void release_block(void *block) noexcept {
+        unsigned char *sys_block = static_cast<unsigned char *>(block) - header;
+
+        std::lock_guard<Mutex> guard(mutex_);
+
+        link(sys_block) = (free_head_ != nullptr) ? free_head_ : list_end();
+        free_head_ = sys_block;
+        used_--;
+    }
+
+    /* block start of the arena (allocated or not) */
+    bool owns(const void *block) const noexcept {
+        std::uintptr_t offset = reinterpret_cast<std::uintptr_t>(block) - reinterpret_cast<std::uintptr_t>(arena_ + header);
+
+        return offset < arena_size && offset % stride == 0;
+    }
+
+    std::size_t used_blocks() noexcept {
+        std::lock_guard<Mutex> guard(mutex_);
+
+        return used_;
+    }
+
+    std::size_t free_blocks() noexcept { return Count - used_blocks(); }
+
+private:
+    static unsigned char *&link(unsigned char *sys_block) noexcept { return *reinterpret_cast<unsigned char **>(sys_block); }
+    static unsigned char *list_end() noexcept { return reinterpret_cast<unsigned char *>(UINTPTR_MAX); }
+    static unsigned char *claimed() noexcept { return reinterpret_cast<unsigned char *>(UINTPTR_MAX - 1); }
+
+    /* blocks behind bump cursor were never allocated, their links are garbage */
+    bool allocated(const unsigned char *sys_block) const noexcept {
+        return static_cast<std::size_t>(sys_block - arena_) / stride < bump_index_ && *reinterpret_cast<unsigned char *const *>(sys_block) == nullptr;
+    }
+
+    alignas(Align) unsigned char arena_[arena_size];
+    unsigned char *free_head_ = nullptr;
+    std::size_t bump_index_ = 0;
+    std::size_t used_ = 0;
+    Mutex mutex_;
+};
+
+/**
+    \brief Typed pool of N objects
+
+    \details
+        construct() returns nullptr if pool is exhausted (exception of T
+        constructor returns block to the pool & is rethrown). destroy() claims
+        block before destructor runs, so foreign object or object destroyed
+        already (or by other thread at the same time) is reported instead of
+        being destroyed twice.
+
+    \tparam T Object type
+    \tparam N Objects in pool
+    \tparam Mutex Lock type (ynull_mutex - single thread pool without locking)
+*/
+
+template <class T, std::size_t N, class Mutex = std::mutex>
+class object_pool
+{
+public:
+    using pool_type = ypool<sizeof(T), N, (alignof(T) > alignof(void *)) ? alignof(T) : alignof(void *), Mutex>;
+
+    /* unique_ptr deleter which destroys object in its pool */
+    struct deleter
+    {
+        object_pool *pool = nullptr;
+
+        void operator()(T *object) const noexcept { pool->destroy(object); }
+    };
+
+    using unique_ptr = std::unique_ptr<T, deleter>;
+
+    template <class... Args>
+    T *construct(Args &&... args) {
+        void *block;
+
+        if (blocks_.alloc_block(&block) != 0)
+            return nullptr;
+
+        try{
+            return ::new (block) T(std::forward<Args>(args)...);
+        }catch (...){
+            blocks_.free_block(block);
+            throw;
+        }
+    }
+
+    /**
+        \brief Destroy object & return its block to the pool
+        \param[in] object Object created by construct()
+        \return
+            -EXDEV     - Object is not belong the pool
+            -EALREADY  - Object is destroyed already
+                     0 - Successfuly destroyed object
+    */
+    int destroy(T *object) noexcept {
+        int ret = blocks_.claim_block(object);
+
+        if (ret != 0)
+            return ret;
+
+        object->~T();
+        blocks_.release_block(object);
+
+        return 0;
+    }
+
+    /* construct() owned by unique_ptr (empty if pool is exhausted) */
+    template <class... Args>
+    unique_ptr make_unique(Args &&... args) {
+        return unique_ptr(construct(std::forward<Args>(args)...), deleter{this});
+    }
+
+    bool owns(const T *object) const noexcept { return blocks_.owns(object); }
+    std::size_t used() noexcept { return blocks_.used_blocks(); }
+    std::size_t available() noexcept { return blocks_.free_blocks(); }
+
+private:
+    pool_type blocks_;
+};
+
+} /* namespace yad */
+
+#endif //YPOOL_HPP
@@ -0,0 +1,131 @@
+#ifndef YPOOL_RESOURCE_HPP
+#define YPOOL_RESOURCE_HPP
+
+/**
+    \file
+    \brief std::pmr::memory_resource & standard Allocator over ypool_STC (C++17, link allocator.a)
+
+    \details
+        Requests which fit pool block (size & alignment) are served by
+        yalloc_block(), others & requests made while pool is exhausted go to the
+        upstream resource. Node based containers allocate one node per request,
+        so all their nodes come from the pool if block_size fits node size.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+#include "allocator.h"
+
+namespace yad {
+
+class ypool_resource : public std::pmr::memory_resource
+{
+public:
+    /**
+        \brief Wrap initialized pool
+        \param[in] pool Pool after successful ypool_init() (must outlive the resource)
+        \param[in] upstream Resource for requests pool can't serve
+    */
+    explicit ypool_resource(ypool_STC *pool, std::pmr::memory_resource *upstream = std::pmr::get_default_resource()) noexcept
+        : pool_(pool), upstream_(upstream), block_align_(pool_block_align(pool)) {}
+
+    ypool_resource(const ypool_resource &) = delete;
+    ypool_resource &operator=(const ypool_resource &) = delete;
+
+    ypool_STC *pool() const noexcept { return pool_; }
+    std::pmr::memory_resource *upstream_resource() const noexcept { return upstream_; }
+
+    /* max alignment every pool block has */
+    std::size_t block_alignment() const noexcept { return block_align_; }
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        AD_POINTER block;
+
+        if (fits(bytes, alignment) && yalloc_block(pool_, &block) == 0)
+            return block;
+
+        return upstream_->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *block, std::size_t bytes, std::size_t alignment) override {
+        /* fitting request got upstream memory if pool was exhausted (-EXDEV) */
+        if (fits(bytes, alignment) && yfree_block(pool_, static_cast<AD_POINTER *>(block)) != -EXDEV)
+            return;
+
+        upstream_->deallocate(block, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+private:
+    bool fits(std::size_t bytes, std::size_t alignment) const noexcept {
+        return bytes <= pool_->block_size && alignment <= block_align_;
+    }
+
+    /* user blocks are at start_PTR + header + N * stride, lowest set bit of all three is their common alignment */
+    static std::size_t pool_block_align(const ypool_STC *pool) noexcept {
+        std::uintptr_t header = (pool->flags & YPOOL_FLAG_COMPACT) ? 0 : sizeof(AD_POINTER);
+        std::uintptr_t guard = (pool->flags & YPOOL_FLAG_CANARY) ? sizeof(uint64_t) : 0;
+        std::uintptr_t stride = pool->block_size + header + guard;
+        std::uintptr_t bits = reinterpret_cast<std::uintptr_t>(pool->start_PTR) | header | stride;
+
+        /* slabs of YPOOL_FLAG_GROWABLE pool are page aligned */
+        return static_cast<std::size_t>(bits & (~bits + 1));
+    }
+
+    ypool_STC *pool_;
+    std::pmr::memory_resource *upstream_;
+    std::size_t block_align_;
+};
+
+/**
+    \brief Standard Allocator over ypool_resource
+
+    \details
+        For containers without pmr support: std::list<T, ypool_allocator<T>>.
+        Allocators are equal if they use the same resource.
+*/
+
+template <class T>
+class ypool_allocator
+{
+public:
+    using value_type = T;
+
+    explicit ypool_allocator(ypool_resource *resource) noexcept : resource_(resource) {}
+
+    template <class U>
+    ypool_allocator(const ypool_allocator<U> &other) noexcept : resource_(other.resource()) {}
+
+    T *allocate(std::size_t n) {
+        if (n > SIZE_MAX / sizeof(T))
+            throw std::bad_array_new_length();
+
+        return static_cast<T *>(resource_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *object, std::size_t n) noexcept {
+        resource_->deallocate(object, n * sizeof(T), alignof(T));
+    }
+
+    ypool_resource *resource() const noexcept { return resource_; }
+
+    template <class U>
+    bool operator==(const ypool_allocator<U> &other) const noexcept { return resource_ == other.resource(); }
+
+    template <class U>
+    bool operator!=(const ypool_allocator<U> &other) const noexcept { return resource_ != other.resource(); }
+
+private:
+    ypool_resource *resource_;
+};
+
+} /* namespace yad */
+
+#endif //YPOOL_RESOURCE_HPP
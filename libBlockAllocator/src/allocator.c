@@ -1,7 +1,20 @@
+#define _GNU_SOURCE /* memfd_create() */
 #include <stdio.h>
 #include "allocator.h"
 #include <stdlib.h>
 #include <memory.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <sys/random.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /**
     \file
@@ -10,15 +23,75 @@
     \todo Warning! OS can prevent inter-process memory sharing theoretically
 */
 
+/* next_block of the last free block (NULL marks allocated block) */
+#define YBLOCK_LIST_END   ((AD_POINTER)UINTPTR_MAX)
+
+/* map entry of a grain shared by several arenas (owner is found in ymap_ranges) */
+#define YMAP_SHARED       ((ypool_STC*)1)
+
+/* YPOOL_FLAG_LOCKFREE free list encoding: next_block of a free block holds index of the next free block + 1 */
+#define YLF_INDEX_MASK    0xFFFFFFFFull             /* lf_head bits with block index + 1 */
+#define YLF_TAG_ONE       (1ull << 32)              /* lf_head ABA tag increment */
+
+/* next_block of a free block which is not linked to the shared free list yet (thread cache, being freed) */
+#define YBLOCK_FREE_MARK  ((AD_POINTER)(UINTPTR_MAX - 1))
+
+/* pool flags supported by YPOOL_FLAG_SHARED pools (state outside of the mapping is per process) */
+#define YPOOL_FLAGS_SHARED  (YPOOL_FLAG_SHARED | YPOOL_FLAG_PERSISTENT | YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_LAZY)
+
+/* OFD lock bytes of YPOOL_FLAG_SHARED pool file: read lock per attached handle, write lock while users are checked */
+#define YSHM_LOCK_USERS   0
+#define YSHM_LOCK_GATE    1
+
+/* sub-pool of YPOOL_FLAG_NUMA pool (arena is bound to pool->numa_node) */
+#define YPOOL_FLAG_NUMA_NODE  (1u << 31)
+
+/* mbind() policy (linux/mempolicy.h MPOL_BIND) */
+#define YMPOL_BIND        2
+
+/* pool flags which need allocation bitmap */
+#define YPOOL_FLAGS_HARDENED  (YPOOL_FLAG_HARDENED | YPOOL_FLAG_CANARY | YPOOL_FLAG_POISON)
+
+/* madvise() advice of ypool_trim() (MADV_FREE - pages are reclaimed under memory pressure only) */
+#ifndef YPOOL_TRIM_ADVICE
+#define YPOOL_TRIM_ADVICE  MADV_DONTNEED
+#endif
+
+/* pool flags which keep allocation state in alloc_map */
+#define YPOOL_FLAGS_BITMAP    (YPOOL_FLAG_COMPACT | YPOOL_FLAG_HARDENED | YPOOL_FLAG_LOWFIRST)
+
+/* pool flags which need mmap-backed arena */
+#define YPOOL_FLAGS_MMAP  (YPOOL_FLAG_MMAP | YPOOL_FLAG_HUGEPAGES | YPOOL_FLAG_POPULATE | YPOOL_FLAG_MLOCK)
+
+/* address to pool map: root -> middle nodes -> leaves of ypool_STC pointers per grain (nodes are never freed) */
+static void *ymap_root[YPOOL_MAP_FANOUT];
+
+/* arenas with an unaligned end, which may share its grain with other allocations (sorted by start_PTR) */
+static ymap_range_STC   *ymap_ranges;
+static size_t            ymap_ranges_count;
+static size_t            ymap_ranges_capacity;
+static pthread_rwlock_t  ymap_ranges_lock = PTHREAD_RWLOCK_INITIALIZER;
+
 /**
     \brief 
         Used to allocate memory from the pool
 
+    \details
+        Arena comes from malloc, or from mmap for YPOOL_FLAG_MMAP & friends.
+        Backing which was actually got is reported in pool->backing
+        (YPOOL_BACKING_*): huge pages, pre-faulting & mlock fall back silently.
+        YPOOL_FLAG_LAZY pool is initialized in constant time without touching the arena.
+        YPOOL_FLAG_NUMA pool is split into pool->numa_nodes sub-pools.
+        YPOOL_FLAG_ZEROTRACK pool takes blocks of fresh mmap arena as zero,
+        blocks of malloc arena as dirty.
+
     \param[in/out] pool Pointer to the pool to which the operation will be applied
 
     \return 
         -EFAULT    - Pool pointer is NULL
         -EALREADY  - Pool is initialized already
+        -EINVAL    - Pool geometry is not supported by requested pool flags
+        -EAGAIN    - Unable to create thread cache, trace ring or epoch record key (YPOOL_FLAG_TCACHE, YPOOL_FLAG_TRACE, YPOOL_FLAG_EPOCH)
         -ENOMEM    - There are no free memory in system to allocate it for requested pool
                  0 - Successfuly initialized pool
 */
@@ -35,16 +108,188 @@ int ypool_init(ypool_STC *pool){
         return -EALREADY;
 
     blocks_in_pool = pool->pool_size/pool->block_size;
+
+    if (pool->flags & YPOOL_FLAG_PERSISTENT){
+        if (pool->file_path == NULL)
+            return -EINVAL;
+
+        pool->flags |= YPOOL_FLAG_SHARED;
+    }
+
+    /* shared state lives in the mapping, links are block indexes (position independent) */
+    if (pool->flags & YPOOL_FLAG_SHARED){
+        if (pool->flags & ~YPOOL_FLAGS_SHARED)
+            return -EINVAL;
+
+        pool->flags |= YPOOL_FLAG_LOCKFREE;
+    }
+
+    if (pool->flags & YPOOL_FLAGS_HARDENED)
+        pool->flags |= YPOOL_FLAG_HARDENED;
+
+    /* free list link lives in block payload */
+    if (pool->flags & YPOOL_FLAG_COMPACT){
+        if (pool->block_size < sizeof(AD_POINTER))
+            return -EINVAL;
+    }
+
+    /* slabs are chained by pointers under the mutex, allocation state lives in block headers */
+    if ((pool->flags & YPOOL_FLAG_GROWABLE) && (pool->flags & (YPOOL_FLAG_LOCKFREE | YPOOL_FLAGS_BITMAP | YPOOL_FLAG_ZEROTRACK)))
+        return -EINVAL;
+
+    /* bitmap summaries are updated under the mutex */
+    if ((pool->flags & YPOOL_FLAG_LOWFIRST) && (pool->flags & (YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_TCACHE)))
+        return -EINVAL;
+
+    /* lock-free head keeps 32 bit block index */
+    if ((pool->flags & YPOOL_FLAG_LOCKFREE) && blocks_in_pool >= YLF_INDEX_MASK)
+        return -EINVAL;
+
+    /* links are accessed atomically outside the mutex (must be aligned) */
+    if ((pool->flags & (YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_TCACHE)) && yblock_stride(pool) % sizeof(AD_POINTER) != 0)
+        return -EINVAL;
+
+    /* sub-pools are initialized with the rest of the flags */
+    if ((pool->flags & YPOOL_FLAG_NUMA) && (pool->flags & (YPOOL_FLAG_SHARED | YPOOL_FLAG_GROWABLE)))
+        return -EINVAL;
+
+    /* flags are valid, keys are deleted on every failure below */
+    ret = ykeys_create(pool);
+
+    if (ret != 0)
+        return ret;
+
+    /* logical pool of sub-pools */
+    if (pool->flags & YPOOL_FLAG_NUMA){
+        ret = ynuma_init(pool, blocks_in_pool);
+
+        if (ret != 0)
+            ykeys_delete(pool);
+        return ret;
+    }
     
     pthread_mutex_init(&pool->mutex, NULL); //fixme check all pool usage inside mutex locked block
+
+    pool->lf_head_PTR = &pool->lf_head;
+    pool->bump_index_PTR = &pool->bump_index;
+    pool->total_blocks = blocks_in_pool;
+    pool->slab_blocks = blocks_in_pool;
+    pool->slab_index = NULL;
+    pool->stats = NULL;
+    pool->stats_peak = 0;
+    pool->stats_used = 0;
+    pool->trim_pending = 0;
+    pool->trim_next = 0;
+    pool->dirty_map = NULL;
+
+    pool->stride_magic = 0;
+    if ((pool->flags & (YPOOL_FLAG_HARDENED | YPOOL_FLAG_LOWFIRST)) && blocks_in_pool * yblock_stride(pool) <= UINT32_MAX)
+        pool->stride_magic = UINT64_MAX / yblock_stride(pool) + 1;
+
+    /* guard words differ between pools & runs */
+    if ((pool->flags & YPOOL_FLAG_CANARY) && getrandom(&pool->canary, sizeof(pool->canary), GRND_NONBLOCK) != sizeof(pool->canary))
+        pool->canary = (uint64_t)(uintptr_t)pool ^ (uint64_t)time(NULL) * 0x9E3779B97F4A7C15ull;
+
+#if STATS == 1
+    pool->stats = aligned_alloc(64, YSTATS_SHARDS * sizeof(ystats_shard_STC));
+
+    if (pool->stats == NULL){
+        ykeys_delete(pool);
+        return -ENOMEM;
+    }
+
+    memset(pool->stats, 0, YSTATS_SHARDS * sizeof(ystats_shard_STC));
+#endif
+
+    if (pool->flags & YPOOL_FLAG_SHARED){
+        ret = yshm_init(pool, blocks_in_pool);
+
+        if (ret != 0){
+            free(pool->stats);
+            pool->stats = NULL;
+            ykeys_delete(pool);
+        }
+        return ret;
+    }
+
     pthread_mutex_lock(&pool->mutex);
 
-    pool->start_PTR = malloc( blocks_in_pool * (sizeof(AD_POINTER)+pool->block_size) );
+    pool->start_PTR = yarena_alloc(pool, blocks_in_pool * yblock_stride(pool));
 
-    if(pool->start_PTR == NULL)
+    if(pool->start_PTR == NULL){
+        free(pool->stats);
+        pool->stats = NULL;
+        ykeys_delete(pool);
+        pthread_mutex_unlock(&pool->mutex);
         return -ENOMEM;
+    }
+
+    if (pool->flags & YPOOL_FLAGS_BITMAP){
+        pool->alloc_map = calloc((blocks_in_pool + 63) / 64, sizeof(uint64_t));
+
+        if (pool->alloc_map == NULL){
+            yarena_free(pool);
+            free(pool->stats);
+            pool->stats = NULL;
+            ykeys_delete(pool);
+            pthread_mutex_unlock(&pool->mutex);
+            return -ENOMEM;
+        }
+    }
+
+    /* fresh anonymous mapping is zero (yformat() writes headers only, links of YPOOL_FLAG_COMPACT are cleared by yalloc_block_zeroed()) */
+    if (pool->flags & YPOOL_FLAG_ZEROTRACK){
+        pool->dirty_map = calloc((blocks_in_pool + 63) / 64, sizeof(uint64_t));
+
+        if (pool->dirty_map == NULL){
+            free(pool->alloc_map);
+            yarena_free(pool);
+            free(pool->stats);
+            pool->stats = NULL;
+            ykeys_delete(pool);
+            pthread_mutex_unlock(&pool->mutex);
+            return -ENOMEM;
+        }
+
+        if (!(pool->backing & YPOOL_BACKING_MMAP))
+            memset(pool->dirty_map, 0xFF, (blocks_in_pool + 63) / 64 * sizeof(uint64_t));
+    }
+
+    /* bitmap is the free list, arena stays untouched until blocks are used */
+    if (pool->flags & YPOOL_FLAG_LOWFIRST){
+        ret = ylow_init(pool, blocks_in_pool);
+
+        if (ret != 0){
+            free(pool->dirty_map);
+            pool->dirty_map = NULL;
+            free(pool->alloc_map);
+            yarena_free(pool);
+            free(pool->stats);
+            pool->stats = NULL;
+            ykeys_delete(pool);
+            pthread_mutex_unlock(&pool->mutex);
+            return ret;
+        }
+
+        pool->next_free_block_PTR = NULL;
+        *pool->bump_index_PTR = blocks_in_pool;
+
+        pthread_mutex_unlock(&pool->mutex);
+        return 0;
+    }
+
+    if (pool->flags & YPOOL_FLAG_LAZY){
+        /* free list holds freed blocks only, arena stays untouched until blocks are used */
+        pool->next_free_block_PTR = NULL;
+        *pool->lf_head_PTR = 0;
+        *pool->bump_index_PTR = 0;
+
+        pthread_mutex_unlock(&pool->mutex);
+        return 0;
+    }
 
     pool->next_free_block_PTR = pool->start_PTR;
+    *pool->bump_index_PTR = blocks_in_pool;
 
 
     pthread_mutex_unlock(&pool->mutex);
@@ -69,57 +314,126 @@ int ypool_init(ypool_STC *pool){
 */
 
 int yalloc_block(ypool_STC *pool, AD_POINTER *user_block){
-    int ret = 0;
+    return yalloc_block_at(pool, user_block, __builtin_return_address(0));
+}
 
-    /* using this mid buff we can prevent next pointer damaged by user situation */
-    yblock_STC *block;
+/**
+    \brief yalloc_block() with call site recorded by YPOOL_FLAG_TRACE
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[out] *user_block Pointer to allocated memory
+    \param[in] caller Return address of the public call
+    \return Same as yalloc_block()
+*/
+
+static int yalloc_block_at(ypool_STC *pool, AD_POINTER *user_block, AD_POINTER caller){
+    int ret = 0;
     AD_POINTER allocate_PTR;
-    AD_POINTER next_free_block_PTR; 
+    ytcache_STC *cache;
 
     if (pool == NULL)
         return -EFAULT;
 
-    pthread_mutex_lock(&pool->mutex); //fixme: resolve situation with double mutex lock
-
-    if (pool->start_PTR == NULL)
-    {
-        ret = -EINVAL; /* Wrong pool */
-        goto error;
+    if (pool->flags & YPOOL_FLAG_NUMA){
+        ret = ynuma_alloc(pool, 1, user_block);
+        ret = (ret > 0) ? 0 : ret;
+        ytrace(pool, YTRACE_ALLOC, ret, (ret == 0) ? *user_block : NULL, caller);
+        return ret;
     }
 
-    /* prevent end of pool */
-    if(pool->next_free_block_PTR == NULL)
-    {
-        ret = -ENOMEM; /* No memory in pool */
-        goto error;
+    /* thread cache (falls to shared free list if cache can't be created) */
+    if ((pool->flags & YPOOL_FLAG_TCACHE) && pool->start_PTR != NULL && (cache = ytcache_get(pool)) != NULL){
+        ret = ytcache_alloc(cache, user_block);
+        ystats_alloc(pool, ret, 1);
+        ytrace(pool, YTRACE_ALLOC, ret, (ret == 0) ? *user_block : NULL, caller);
+        if (DEBUG) printf("yalloc_block ret = %d\n",ret);
+        return ret;
     }
 
-    block = (yblock_STC*) pool->next_free_block_PTR;
-    /* save pointer from allocating block */
-    next_free_block_PTR = block->next_block;
+    if (pool->flags & YPOOL_FLAG_LOCKFREE){
+        ret = ypool_check(pool);
 
-    // Throw memory to user
-    allocate_PTR = pool->next_free_block_PTR;
-    
-    allocate_PTR += sizeof(AD_POINTER); /* skip next block pointer (give user memory starting right after next block pointer) */
+        if (ret == 0)
+            ret = ylf_pop(pool, &allocate_PTR);
 
-    /* mark curr block as allocated (set next_block = NULL) */
-    *(AD_POINTER*)pool->next_free_block_PTR = NULL;
+        if (ret == 0)
+            *user_block = allocate_PTR + yblock_header(pool); /* skip next block pointer */
 
-    *user_block = allocate_PTR; /* ToDo: clear block if needed */
+        ystats_alloc(pool, ret, 1);
+        ytrace(pool, YTRACE_ALLOC, ret, (ret == 0) ? *user_block : NULL, caller);
 
-    // and user can damage pointer in data
-    // But we have an a copy
+        if (DEBUG) printf("yalloc_block ret = %d\n",ret);
+        return ret;
+    }
 
-    /* move pointer to new block */
-    pool->next_free_block_PTR = next_free_block_PTR;
+    ylock(pool); //fixme: resolve situation with double mutex lock
+
+    if (pool->start_PTR == NULL)
+    {
+        ret = -EINVAL; /* Wrong pool */
+        goto error;
+    }
+
+    ret = ypop_block(pool, &allocate_PTR);
+
+    if (ret == 0)
+        *user_block = allocate_PTR + yblock_header(pool); /* content is not cleared, see yalloc_block_zeroed() */
 
     error:
     pthread_mutex_unlock(&pool->mutex); //fixme retcode??
+    ystats_alloc(pool, ret, 1);
+    ytrace(pool, YTRACE_ALLOC, ret, (ret == 0) ? *user_block : NULL, caller);
     if (DEBUG) printf("yalloc_block ret = %d\n",ret);
     return ret;
 }
 
+/**
+    \brief 
+        Used to allocate block of memory filled with zeros
+
+    \details
+        YPOOL_FLAG_ZEROTRACK pool skips clearing of blocks known to be zero:
+        never used blocks of fresh mmap arena & blocks released to the OS by
+        ypool_trim() (YPOOL_TRIM_ADVICE is MADV_DONTNEED). Freed blocks &
+        blocks dropped by ypool_reset()/ypool_release() are dirty. Other
+        pools clear every block. Blocks of YPOOL_ZERO_NT_SIZE & bigger are
+        cleared with non-temporal stores.
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[out] *user_block Pointer to allocated zeroed memory
+
+    \return 
+        Same as yalloc_block()
+*/
+
+int yalloc_block_zeroed(ypool_STC *pool, AD_POINTER *user_block){
+    ypool_STC *owner;
+    size_t index;
+    int ret;
+
+    ret = yalloc_block_at(pool, user_block, __builtin_return_address(0));
+
+    if (ret != 0)
+        return ret;
+
+    owner = (pool->flags & YPOOL_FLAG_NUMA) ? ynuma_owner(pool, *user_block) : pool;
+
+    if (owner != NULL && owner->dirty_map != NULL){
+        index = yblock_index(owner, *user_block - yblock_header(owner));
+
+        if ((__atomic_load_n(&owner->dirty_map[index / 64], __ATOMIC_RELAXED) & (1ull << (index % 64))) == 0){
+            /* free list link lived in block payload */
+            if (owner->flags & YPOOL_FLAG_COMPACT)
+                memset(*user_block, 0, sizeof(AD_POINTER));
+
+            return 0;
+        }
+    }
+
+    yzero(*user_block, pool->block_size);
+
+    return 0;
+}
+
 /**
     \brief 
         Used to free single user block & return it to the pool
@@ -132,22 +446,81 @@ int yalloc_block(ypool_STC *pool, AD_POINTER *user_block){
         -EINVAL    - Pool has no pointer to the beginning
         -EXDEV     - user_block is not belong the pool
         -EALREADY  - user_block is marked as free
+        -EOVERFLOW - Guard word after user_block is overwritten, block is not freed (YPOOL_FLAG_CANARY)
                  0 - Successfuly freed user_block
 */
 
 int yfree_block(ypool_STC *pool, AD_POINTER *user_block){
+    return yfree_block_at(pool, user_block, __builtin_return_address(0));
+}
+
+/**
+    \brief yfree_block() with call site recorded by YPOOL_FLAG_TRACE
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] *user_block Block which needed to free
+    \param[in] caller Return address of the public call
+    \return Same as yfree_block()
+*/
+
+static int yfree_block_at(ypool_STC *pool, AD_POINTER *user_block, AD_POINTER caller){
     int ret;
     yblock_STC *block;
     AD_POINTER user_block_PTR;
     yblock_STC *returned_block;
 
+    ytcache_STC *cache;
+    ypool_STC *node_pool;
+
     ret = ypool_check(pool);
 
+    /* block goes back to the node which owns it */
+    if (ret == 0 && (pool->flags & YPOOL_FLAG_NUMA)){
+        node_pool = ynuma_owner(pool, user_block);
+        ret = (node_pool != NULL) ? yfree_block(node_pool, user_block) : -EXDEV;
+        ytrace(pool, YTRACE_FREE, ret, user_block, caller);
+        return ret;
+    }
+
     if(ret != 0){
-        goto error;
+        ystats_free(pool, ret, 1);
+        ytrace(pool, YTRACE_FREE, ret, user_block, caller);
+        if(DEBUG) printf("yfree ret=%d\n", ret);
+        return ret;
     }
 
-    pthread_mutex_lock(&pool->mutex);
+    /* parked yalloc_block_wait() callers can't see thread cache, return block to shared free list */
+    if ((pool->flags & YPOOL_FLAG_TCACHE) && __atomic_load_n(&pool->waiters, __ATOMIC_RELAXED) == 0 && (cache = ytcache_get(pool)) != NULL){
+        ret = ytcache_free(cache, user_block);
+        ystats_free(pool, ret, 1);
+        ytrace(pool, YTRACE_FREE, ret, user_block, caller);
+        if(DEBUG) printf("yfree ret=%d\n", ret);
+        return ret;
+    }
+
+    if (pool->flags & YPOOL_FLAG_LOCKFREE){
+        if (!yblock_belongs_to_pool(pool,user_block)){
+            ret = -EXDEV;
+        }else{
+            user_block_PTR = user_block;
+            user_block_PTR -= yblock_header(pool);
+
+            /* claim block (allocated -> free), so only one of concurrent frees of the same block wins */
+            ret = yclaim_free(pool, user_block_PTR);
+
+            if (ret == 0){
+                ylf_splice(pool, user_block_PTR, user_block_PTR);
+                ywake_waiters(pool);
+            }
+        }
+
+        ystats_free(pool, ret, 1);
+        ytrace(pool, YTRACE_FREE, ret, user_block, caller);
+
+        if(DEBUG) printf("yfree ret=%d\n", ret);
+        return ret;
+    }
+
+    ylock(pool);
 
     if (!yblock_belongs_to_pool(pool,user_block)){
         ret =  -EXDEV; /* ToDo: replace with special codes */
@@ -156,157 +529,4395 @@ int yfree_block(ypool_STC *pool, AD_POINTER *user_block){
 
     /* shift back returned block to PTR size (to correct work with yblock_STC) */
     user_block_PTR = user_block;
-    user_block_PTR -= sizeof(AD_POINTER);
+    user_block_PTR -= yblock_header(pool);
 
     /* decode returned block */
     returned_block = (yblock_STC*) user_block_PTR;
 
-    /* Check if block allocated */
-    if (returned_block->next_block != NULL){ /* for allocated block next_block ptr must be NULL */
-        ret = -EALREADY; /* block is not allocated (already free) */
+    /* Check if block allocated & claim it */
+    ret = yclaim_free(pool, user_block_PTR); /* for allocated block next_block ptr must be NULL */
+
+    if (ret != 0)
+        goto error;
+
+    /* hand block over to the first parked yalloc_block_wait() caller */
+    if (pool->wait_head != NULL){
+        ymark_allocated(pool, user_block_PTR);
+        ywaiter_wake(pool, user_block);
         goto error;
     }
 
+    /* cleared bitmap bit is the free list (YPOOL_FLAG_LOWFIRST) */
+    if (pool->flags & YPOOL_FLAG_LOWFIRST)
+        goto error;
+
     /* write previous allocate pointer to returned block */    
-    returned_block->next_block = pool->next_free_block_PTR;
+    returned_block->next_block = (pool->next_free_block_PTR != NULL) ? pool->next_free_block_PTR : YBLOCK_LIST_END;
     
     /* set pool pointer to returned block */
     pool->next_free_block_PTR = user_block_PTR;
 
     error:
     pthread_mutex_unlock(&pool->mutex); //fixme retcode??
+    ystats_free(pool, ret, 1);
+    ytrace(pool, YTRACE_FREE, ret, user_block, caller);
+
+    if (ret == 0)
+        ytrim_auto(pool, 1);
+
     if(DEBUG) printf("yfree ret=%d\n", ret);
     return ret;
 }
 
 /**
     \brief 
-        Used to format initiated pool to singly linked list
+        Used to allocate several blocks of memory from the pool at once
+
+    \details
+        Blocks are popped from the free list as a single chain under one lock
+        acquisition (or one CAS in YPOOL_FLAG_LOCKFREE mode). With
+        YPOOL_FLAG_TCACHE calling thread cache is drained first.
 
     \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] count Number of blocks requested
+    \param[out] user_blocks Array of at least `count` pointers, filled with allocated memory
 
     \return 
-        -EFAULT - Pool pointer is NULL
-        -EINVAL - Pool has no pointer to the beginning
-              0 - On success
+        -EFAULT    - Pool pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning or count is out of int range
+        -ENOMEM    - Pool has no free memory (nothing allocated)
+          1..count - Number of allocated blocks (user_blocks[0..ret-1]); less than count if pool ran out of free memory
+                 0 - count is 0
 */
 
-static int yformat(ypool_STC *pool){
-    yblock_STC        * block;
-    AD_POINTER          block_PTR;
-    uint32_t            curr_block_num;
-    int                 ret;
-    size_t              blocks_in_pool;
+int yalloc_blocks(ypool_STC *pool, size_t count, AD_POINTER user_blocks[]){
+    int ret;
+    size_t allocated = 0;
+    size_t i;
+    bool locked;
+    ytcache_STC *cache;
 
-    /* 1. Check the pool for validity */
     ret = ypool_check(pool);
 
-    if(ret != 0)
+    if (ret != 0)
         return ret;
-    /* 2. reserved */
-    //fixme: prevent format while memory is allocated to user
 
-    /* 3. Lock pool */ 
-    pthread_mutex_lock(&pool->mutex);
-    /* 4. Set block_PTR to the beginning of the pool */
-    block_PTR = pool->start_PTR;
+    if (pool->flags & YPOOL_FLAG_NUMA){
+        ret = ynuma_alloc(pool, count, user_blocks);
 
-    blocks_in_pool = pool->pool_size/pool->block_size;
+        for (i = 0; (pool->flags & YPOOL_FLAG_TRACE) && ret > 0 && i < (size_t)ret; i++)
+            ytrace(pool, YTRACE_ALLOC, 0, user_blocks[i], __builtin_return_address(0));
 
-    /* */
-    for (curr_block_num=0; curr_block_num < blocks_in_pool-1; curr_block_num++)
-    {
-        /* decode current block */
-        block = (yblock_STC*) block_PTR;
-        /* set pointer to next block */
-        block->next_block = block_PTR + sys_block_size(pool->block_size);
+        return ret;
+    }
+
+    if (count > INT_MAX)
+        return -EINVAL;
 
-        block_PTR += sys_block_size(pool->block_size);
+    if (count == 0)
+        return 0;
+
+    /* cache of older epoch is dropped by its thread's next single block call */
+    if ((pool->flags & YPOOL_FLAG_TCACHE) && (cache = pthread_getspecific(pool->tcache_key)) != NULL
+        && cache->epoch == __atomic_load_n(&pool->epoch, __ATOMIC_ACQUIRE)){
+        while (allocated < count && cache->count != 0)
+            user_blocks[allocated++] = cache->blocks[--cache->count];
     }
 
-    /* set next as NULL for last block */
-    block = (yblock_STC*) block_PTR;
-    block->next_block = NULL;
+    allocated += ypop_chain(pool, count - allocated, user_blocks + allocated);
 
-    pthread_mutex_unlock(&pool->mutex);
+    if (allocated == 0){
+        ystats_alloc(pool, -ENOMEM, 1);
+        if (DEBUG) printf("yalloc_blocks ret = %d\n",-ENOMEM);
+        return -ENOMEM; /* No memory in pool */
+    }
 
-    return 0;
+    /* alloc_map of mutex mode pool is updated under the mutex */
+    locked = (pool->flags & YPOOL_FLAGS_BITMAP) && !(pool->flags & (YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_TCACHE));
+
+    if (locked)
+        ylock(pool);
+
+    for (i = 0; i < allocated; i++)
+    {
+        /* mark block as allocated (set next_block = NULL) */
+        ymark_allocated(pool, user_blocks[i]);
+        user_blocks[i] += yblock_header(pool); /* skip next block pointer */
+    }
+
+    if (locked)
+        pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; (pool->flags & YPOOL_FLAG_TRACE) && i < allocated; i++)
+        ytrace(pool, YTRACE_ALLOC, 0, user_blocks[i], __builtin_return_address(0));
+
+    ystats_alloc(pool, 0, allocated);
+    if (DEBUG) printf("yalloc_blocks ret = %zu\n",allocated);
+    return (int)allocated;
 }
 
 /**
     \brief 
-        Checks belonging of a user block to the pool
+        Used to free several user blocks at once & return them to the pool
 
     \details
+        Ownership of the whole batch is validated first, so nothing is freed if
+        any block does not belong to the pool. Blocks are claimed & linked into
+        a chain which is spliced to the free list under one lock acquisition
+        (or one CAS in YPOOL_FLAG_LOCKFREE mode). Blocks which are free already
+        (including duplicates inside the batch) are skipped.
 
     \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] count Number of blocks in user_blocks
+    \param[in] user_blocks Blocks which needed to free
 
     \return 
-        false - Not belongs to the pool
-        true  - Belongs to the pool
+        -EFAULT    - Pool pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning or count is out of int range
+        -EXDEV     - some of user_blocks is not belong the pool (nothing freed)
+          0..count - Number of freed blocks; less than count if some blocks were marked as free (or had damaged guard word)
 */
 
-static bool yblock_belongs_to_pool(ypool_STC *pool, AD_POINTER user_block)
-{
-    AD_POINTER      lowest_user_pointer;
-    AD_POINTER      highest_user_pointer;
-    size_t          blocks_in_pool;
+int yfree_blocks(ypool_STC *pool, size_t count, AD_POINTER user_blocks[]){
+    int ret;
+    size_t freed = 0;
+    size_t overflowed = 0;
+    size_t i;
+    AD_POINTER block_PTR;
+    AD_POINTER first = NULL;
+    AD_POINTER last = NULL;
 
-    if(ypool_check(pool) != 0)
-        return false;
+    ret = ypool_check(pool);
 
-    blocks_in_pool = pool->pool_size/pool->block_size;
+    if (ret != 0)
+        return ret;
 
-    lowest_user_pointer = pool->start_PTR + sizeof(AD_POINTER);
-    highest_user_pointer = lowest_user_pointer + (sys_block_size(pool->block_size) * (blocks_in_pool-1));
+    /* sub-pools are not traced: blocks of the batch are recorded as freed */
+    if (pool->flags & YPOOL_FLAG_NUMA){
+        ret = ynuma_free_blocks(pool, count, user_blocks);
 
-    if (DEBUG) printf("#ybbtp pool->start_PTR=0x%x\n",pool->start_PTR);
-    if (DEBUG) printf("#ybbtp highest_user_pointer=0x%x\n",highest_user_pointer);
-    if (DEBUG) printf("#ybbtp user_block=0x%x\n",user_block);
-    if (DEBUG) printf("#ybbtp lowest_user_pointer=0x%x\n",lowest_user_pointer);
+        for (i = 0; (pool->flags & YPOOL_FLAG_TRACE) && ret >= 0 && i < count; i++)
+            ytrace(pool, YTRACE_FREE, 0, user_blocks[i], __builtin_return_address(0));
 
-    return (lowest_user_pointer <= user_block && user_block <= highest_user_pointer); /* true if user block is between pool edges */
-}
+        return ret;
+    }
 
-/**
+    if (count > INT_MAX)
+        return -EINVAL;
 
-    \brief 
-        Validate pool
+    for (i = 0; i < count; i++)
+    {
+        if (!yblock_belongs_to_pool(pool, user_blocks[i])){
+            ystats_free(pool, -EXDEV, 1);
+            if (DEBUG) printf("yfree_blocks ret = %d\n",-EXDEV);
+            return -EXDEV;
+        }
+    }
 
-    \details
-        1. Check that pool PTR is not NULL
-        2. Check that start_PTR is not NULL
-        3. reserved
+    if (!(pool->flags & YPOOL_FLAG_LOCKFREE))
+        ylock(pool);
 
-    \param[in] pool Pointer to the pool to which the operation will be applied
+    for (i = 0; i < count; i++)
+    {
+        block_PTR = user_blocks[i] - yblock_header(pool);
 
-    \return 
-        -EFAULT - Pool pointer is NULL
-        -EINVAL - Pool has no pointer to the beginning
-              0 - Pool correct
+        /* claim block (allocated -> free), skip blocks which are free already */
+        ret = yclaim_free(pool, block_PTR);
+        ytrace(pool, YTRACE_FREE, ret, user_blocks[i], __builtin_return_address(0));
 
-*/
+        if (ret == -EOVERFLOW)
+            overflowed++;
 
-static int ypool_check(ypool_STC *pool){
-    if (pool == NULL)
-        return -EFAULT;
+        if (ret != 0)
+            continue;
 
-    if (pool->start_PTR == NULL)
-        return -EINVAL;
+        if (last == NULL)
+            first = block_PTR;
+        else
+            ychain_link(pool, last, block_PTR);
 
-    // what else needs to be checked? (& how much to stay fast)
+        last = block_PTR;
+        freed++;
+    }
 
-    return 0;
+    if (pool->flags & YPOOL_FLAG_LOCKFREE){
+        if (freed != 0){
+            ylf_splice(pool, first, last);
+            ywake_waiters(pool);
+        }
+    }else{
+        /* cleared bitmap bits are the free list (YPOOL_FLAG_LOWFIRST) */
+        if (freed != 0 && !(pool->flags & YPOOL_FLAG_LOWFIRST)){
+            ((yblock_STC*)last)->next_block = (pool->next_free_block_PTR != NULL) ? pool->next_free_block_PTR : YBLOCK_LIST_END;
+            pool->next_free_block_PTR = first;
+        }
+
+        if (freed != 0)
+            ywaiters_feed(pool);
+        pthread_mutex_unlock(&pool->mutex);
+
+        ytrim_auto(pool, freed);
+    }
+
+    ystats_free(pool, 0, freed);
+    ystats_free(pool, -EOVERFLOW, overflowed);
+    ystats_free(pool, -EALREADY, count - freed - overflowed);
+    if (DEBUG) printf("yfree_blocks ret = %zu\n",freed);
+    return (int)freed;
 }
 
 /**
-    \brief Get system block size using user block size
+    \brief 
+        Used to allocate block of memory from the pool, waiting for a free block if pool is exhausted
+
+    \details
+        Caller is parked on a condition variable & woken by yfree_block() which
+        hands the block over directly. Parked callers are served in FIFO order.
+        Blocks held in other threads caches (YPOOL_FLAG_TCACHE) are not handed
+        over until they are flushed to the shared free list. Parked callers of
+        YPOOL_FLAG_SHARED pool are woken by frees of the same process only.
+        Caller of YPOOL_FLAG_NUMA pool is parked on the sub-pool of its node,
+        blocks freed to other nodes don't wake it. -ENOMEM of the first try is
+        counted in statistics only if it is returned (timeout_us is 0).
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[out] *block Pointer to allocated memory
+    \param[in] timeout_us Max wait time in microseconds (0 - don't wait, negative - wait forever)
+
+    \return 
+        -EFAULT    - Pool pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOMEM    - Pool has no free memory (timeout_us is 0)
+        -ETIMEDOUT - No block was freed in timeout_us
+                 0 - Successfuly allocated block
+*/
+
+int yalloc_block_wait(ypool_STC *pool, AD_POINTER *block, long timeout_us){
+    int ret;
+    ywaiter_STC waiter;
+    ywaiter_STC **link;
+    ywaiter_STC *prev = NULL;
+    pthread_condattr_t cond_attr;
+    struct timespec deadline;
+    AD_POINTER sys_block;
+
+    /* fast path is plain allocation */
+    ret = yalloc_block_at(pool, block, __builtin_return_address(0));
+
+    if (ret != -ENOMEM || timeout_us == 0)
+        return ret;
+
+    /* caller goes on waiting, the first try is not a failure */
+    ystats_uncount_enomem(pool);
+
+    /* wait for a block of caller's node */
+    if (pool->flags & YPOOL_FLAG_NUMA){
+        ret = yalloc_block_wait(&pool->numa_pools[ynuma_current(pool)], block, timeout_us);
+        ytrace(pool, YTRACE_ALLOC, ret, (ret == 0) ? *block : NULL, __builtin_return_address(0));
+        return ret;
+    }
+
+    if (timeout_us > 0){
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_us / 1000000;
+        deadline.tv_nsec += (timeout_us % 1000000) * 1000;
+        if (deadline.tv_nsec >= 1000000000){
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&waiter.cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    waiter.block = NULL;
+    waiter.next = NULL;
+
+    ylock(pool);
+
+    /* announce before the last try: lock-free free either sees waiters, or its block is visible to ypop_block() */
+    __atomic_add_fetch(&pool->waiters, 1, __ATOMIC_SEQ_CST);
+
+    /* don't overtake parked callers */
+    if (pool->wait_head == NULL && ypop_block(pool, &sys_block) == 0){
+        waiter.block = sys_block + yblock_header(pool);
+    }else{
+        if (pool->wait_head == NULL)
+            pool->wait_head = &waiter;
+        else
+            pool->wait_tail->next = &waiter;
+        pool->wait_tail = &waiter;
+
+        ret = 0;
+        while (waiter.block == NULL && ret != ETIMEDOUT)
+            ret = (timeout_us > 0) ? pthread_cond_timedwait(&waiter.cond, &pool->mutex, &deadline) : pthread_cond_wait(&waiter.cond, &pool->mutex);
+
+        /* timed out: leave the queue (handed over caller is removed by yfree_block()) */
+        if (waiter.block == NULL){
+            for (link = &pool->wait_head; *link != &waiter; link = &(*link)->next)
+                prev = *link;
+
+            *link = waiter.next;
+            if (pool->wait_tail == &waiter)
+                pool->wait_tail = prev;
+        }
+    }
+
+    __atomic_sub_fetch(&pool->waiters, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pool->mutex);
+    pthread_cond_destroy(&waiter.cond);
+
+    if (waiter.block == NULL){
+        if (DEBUG) printf("yalloc_block_wait ret = %d\n",-ETIMEDOUT);
+        return -ETIMEDOUT;
+    }
+
+    *block = waiter.block;
+    ystats_alloc(pool, 0, 1);
+    ytrace(pool, YTRACE_ALLOC, 0, *block, __builtin_return_address(0));
+    if (DEBUG) printf("yalloc_block_wait ret = %d\n",0);
+    return 0;
+}
+
+/**
+    \brief 
+        Used to release the pool, or to detach YPOOL_FLAG_SHARED pool from the calling process
+
+    \details
+        Arena, slabs & side maps of the pool are given back to the system, its
+        thread keys are deleted & address lookup no longer finds its blocks.
+        Thread cache of the calling thread is dropped with the pool, caches of
+        other threads are leaked (key destructors don't run after the key is
+        deleted). Sub-pools of YPOOL_FLAG_NUMA pool are closed as well.
+
+        The last attached handle of YPOOL_FLAG_SHARED pool marks it as clean
+        (YPOOL_FLAG_PERSISTENT pool file is flushed before), so the next
+        ypool_init() re-attaches it as is. Blocks stay allocated & keep their
+        content.
+
+        Pool must not be used by other threads of the process. Closed pool may
+        be initialized again with ypool_init().
+
+    \param[in/out] pool Pointer to the pool to which the operation will be applied
+
+    \return 
+        -EFAULT    - Pool pointer is NULL
+        -EINVAL    - Pool is not initialized
+        -EIO       - Unable to flush pool file (pool is detached, but not marked as clean)
+                 0 - Successfuly released pool
+*/
+
+int ypool_close(ypool_STC *pool){
+    ytcache_STC *cache;
+    uint32_t node;
+    int ret = 0;
+
+    if (pool == NULL)
+        return -EFAULT;
+
+    if (pool->start_PTR == NULL)
+        return -EINVAL;
+
+    /* the last user (under the gate other handles don't attach or detach meanwhile) */
+    if ((pool->backing & YPOOL_BACKING_SHARED) && yshm_lock(pool->shm_fd, YSHM_LOCK_GATE, F_WRLCK, true) == 0 && yshm_lock(pool->shm_fd, YSHM_LOCK_USERS, F_WRLCK, false) == 0){
+        /* blocks must reach the file before clean flag */
+        if ((pool->flags & YPOOL_FLAG_PERSISTENT) && msync(pool->shm, pool->arena_size, MS_SYNC) != 0)
+            ret = -EIO;
+
+        if (ret == 0){
+            pool->shm->clean = 1;
+
+            if ((pool->flags & YPOOL_FLAG_PERSISTENT) && msync(pool->shm, YPOOL_SHM_HEADER_SIZE, MS_SYNC) != 0)
+                ret = -EIO;
+        }
+    }
+
+    if (pool->flags & YPOOL_FLAG_NUMA){
+        for (node = 0; node < pool->numa_nodes; node++)
+            ypool_close(&pool->numa_pools[node]);
+
+        free(pool->numa_pools);
+        pool->numa_pools = NULL;
+        pool->numa_nodes = 0;
+        pool->start_PTR = NULL;
+    }else{
+        /* cached blocks belong to the arena, so the cache is dropped without flush */
+        if ((pool->flags & YPOOL_FLAG_TCACHE) && (cache = pthread_getspecific(pool->tcache_key)) != NULL)
+            free(cache);
+
+        yslabs_free(pool);
+        yarena_free(pool);
+
+        if (pool->backing & YPOOL_BACKING_SHARED){
+            close(pool->shm_fd); /* drops both locks at once */
+            pool->shm = NULL;
+            pool->shm_fd = 0;
+        }
+
+        if (pool->flags & YPOOL_FLAGS_BITMAP){
+            free(pool->alloc_map);
+            pool->alloc_map = NULL;
+        }
+
+        if (pool->flags & YPOOL_FLAG_LOWFIRST){
+            free(pool->full_map[0]);
+            memset(pool->full_map, 0, sizeof(pool->full_map));
+        }
+
+        pool->lf_head_PTR = &pool->lf_head;
+        pool->bump_index_PTR = &pool->bump_index;
+        free(pool->dirty_map);
+        pool->dirty_map = NULL;
+        free(pool->stats);
+        pool->stats = NULL;
+    }
+
+    ykeys_delete(pool);
+
+    pool->backing = 0;
+    pthread_mutex_destroy(&pool->mutex);
+
+    if (DEBUG) printf("ypool_close ret = %d\n",ret);
+    return ret;
+}
+
+/**
+    \brief 
+        Used to read pool statistics
+
+    \details
+        Counter shards are summed without locking, so snapshot of busy pool is
+        approximate. Peak is sampled when a thread's shard reaches its own new
+        maximum of allocated blocks. Counters of YPOOL_FLAG_SHARED pool are
+        counters of the calling process. Statistics of YPOOL_FLAG_NUMA pool are
+        sums over its nodes (peak_used is sum of node peaks).
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[out] stats Pool statistics
+
+    \return 
+        -EFAULT    - Pool or stats pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOTSUP   - Library is built without statistics (STATS != 1)
+                 0 - On success
+*/
+
+int ypool_get_stats(ypool_STC *pool, ypool_stats_STC *stats){
+    ypool_stats_STC node_stats;
+    int ret;
+    size_t i;
+
+    if (stats == NULL)
+        return -EFAULT;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    if (pool->flags & YPOOL_FLAG_NUMA){
+        memset(stats, 0, sizeof(*stats));
+
+        for (i = 0; i < pool->numa_nodes; i++)
+        {
+            ret = ypool_get_stats(&pool->numa_pools[i], &node_stats);
+
+            if (ret != 0)
+                return ret;
+
+            stats->total_blocks += node_stats.total_blocks;
+            stats->used_blocks += node_stats.used_blocks;
+            stats->free_blocks += node_stats.free_blocks;
+            stats->peak_used += node_stats.peak_used;
+            stats->allocs += node_stats.allocs;
+            stats->frees += node_stats.frees;
+            stats->enomem += node_stats.enomem;
+            stats->exdev += node_stats.exdev;
+            stats->ealready += node_stats.ealready;
+            stats->eoverflow += node_stats.eoverflow;
+            stats->mutex_waits += node_stats.mutex_waits;
+            stats->mutex_wait_ns += node_stats.mutex_wait_ns;
+        }
+
+        return 0;
+    }
+
+    if (pool->stats == NULL)
+        return -ENOTSUP;
+
+    memset(stats, 0, sizeof(*stats));
+
+    for (i = 0; i < YSTATS_SHARDS; i++)
+    {
+        stats->allocs += __atomic_load_n(&pool->stats[i].allocs, __ATOMIC_RELAXED);
+        stats->frees += __atomic_load_n(&pool->stats[i].frees, __ATOMIC_RELAXED);
+        stats->enomem += __atomic_load_n(&pool->stats[i].enomem, __ATOMIC_RELAXED);
+        stats->exdev += __atomic_load_n(&pool->stats[i].exdev, __ATOMIC_RELAXED);
+        stats->ealready += __atomic_load_n(&pool->stats[i].ealready, __ATOMIC_RELAXED);
+        stats->eoverflow += __atomic_load_n(&pool->stats[i].eoverflow, __ATOMIC_RELAXED);
+        stats->mutex_waits += __atomic_load_n(&pool->stats[i].mutex_waits, __ATOMIC_RELAXED);
+        stats->mutex_wait_ns += __atomic_load_n(&pool->stats[i].mutex_wait_ns, __ATOMIC_RELAXED);
+    }
+
+    stats->total_blocks = __atomic_load_n(&pool->total_blocks, __ATOMIC_RELAXED);
+    stats->used_blocks = (stats->allocs > stats->frees) ? stats->allocs - stats->frees : 0;
+    if (stats->used_blocks > stats->total_blocks)
+        stats->used_blocks = stats->total_blocks;
+    stats->free_blocks = stats->total_blocks - stats->used_blocks;
+    stats->peak_used = __atomic_load_n(&pool->stats_peak, __ATOMIC_RELAXED);
+    if (stats->peak_used < stats->used_blocks)
+        stats->peak_used = stats->used_blocks;
+
+    return 0;
+}
+
+/**
+    \brief 
+        Used to read statistics of one node of YPOOL_FLAG_NUMA pool
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] node Node id (0 .. pool->numa_nodes - 1)
+    \param[out] stats Statistics of node sub-pool
+
+    \return 
+        -EFAULT    - Pool or stats pointer is NULL
+        -EINVAL    - Pool is not initialized YPOOL_FLAG_NUMA pool or node is out of range
+        -ENOTSUP   - Library is built without statistics (STATS != 1)
+                 0 - On success
+*/
+
+int ypool_get_node_stats(ypool_STC *pool, uint32_t node, ypool_stats_STC *stats){
+    int ret;
+
+    if (stats == NULL)
+        return -EFAULT;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    if (!(pool->flags & YPOOL_FLAG_NUMA) || node >= pool->numa_nodes)
+        return -EINVAL;
+
+    return ypool_get_stats(&pool->numa_pools[node], stats);
+}
+
+/**
+    \brief 
+        Used to return all blocks to the pool in constant time
+
+    \details
+        Free list is dropped & bump cursor moves to the pool start, so every
+        block is handed out as never used block. Blocks cached by threads
+        (YPOOL_FLAG_TCACHE) are dropped on their next pool access.
+        YPOOL_FLAG_LOWFIRST pool clears its bitmap instead (blocks / 64 words).
+        Pool must not be used by other threads during reset, blocks allocated
+        before reset must not be used or freed after it.
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+
+    \return 
+        -EFAULT    - Pool pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOTSUP   - Pool is YPOOL_FLAG_GROWABLE (slabs are linked to the free list)
+                 0 - Successfuly reset pool
+*/
+
+int ypool_reset(ypool_STC *pool){
+    uint32_t node;
+    int ret;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    if (pool->flags & YPOOL_FLAG_NUMA){
+        for (node = 0; node < pool->numa_nodes; node++)
+        {
+            ret = ypool_reset(&pool->numa_pools[node]);
+
+            if (ret != 0)
+                return ret;
+        }
+        return 0;
+    }
+
+    if (pool->flags & YPOOL_FLAG_GROWABLE)
+        return -ENOTSUP;
+
+    ylock(pool);
+
+    ystats_drop(pool, ystats_used(pool));
+
+    if (pool->dirty_map != NULL)
+        ydirty_drop(pool, 0, *pool->bump_index_PTR);
+
+    /* bitmap is the free list */
+    if (pool->flags & YPOOL_FLAG_LOWFIRST)
+        ylow_format(pool);
+    else
+        yrewind(pool, 0);
+
+    pool->resets++;
+    ywaiters_feed(pool);
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (DEBUG) printf("ypool_reset ret = %d\n",0);
+    return 0;
+}
+
+/**
+    \brief 
+        Used to remember bump cursor position at the start of a nested request phase
+
+    \details
+        Pool free list must be empty (right after ypool_reset(), ypool_release()
+        or YPOOL_FLAG_LAZY init), so blocks of the phase are handed out by bump
+        cursor & ypool_release() drops them at once.
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[out] mark Position to release to
+
+    \return 
+        -EFAULT    - Pool or mark pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOTSUP   - Pool is YPOOL_FLAG_GROWABLE, YPOOL_FLAG_NUMA, YPOOL_FLAG_TCACHE or YPOOL_FLAG_LOWFIRST
+        -EBUSY     - Pool free list is not empty
+                 0 - On success
+*/
+
+int ypool_mark(ypool_STC *pool, ypool_mark_STC *mark){
+    bool list_empty;
+    int ret;
+
+    if (mark == NULL)
+        return -EFAULT;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    /* thread caches take blocks from bump cursor in batches, lowest-first pools don't use it */
+    if (pool->flags & (YPOOL_FLAG_GROWABLE | YPOOL_FLAG_NUMA | YPOOL_FLAG_TCACHE | YPOOL_FLAG_LOWFIRST))
+        return -ENOTSUP;
+
+    ylock(pool);
+
+    if (pool->flags & YPOOL_FLAG_LOCKFREE)
+        list_empty = (__atomic_load_n(pool->lf_head_PTR, __ATOMIC_ACQUIRE) & YLF_INDEX_MASK) == 0;
+    else
+        list_empty = pool->next_free_block_PTR == NULL;
+
+    if (list_empty){
+        mark->bump_index = __atomic_load_n(pool->bump_index_PTR, __ATOMIC_ACQUIRE);
+        mark->resets = pool->resets;
+        mark->used = ystats_used(pool);
+    }else{
+        ret = -EBUSY;
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (DEBUG) printf("ypool_mark ret = %d\n",ret);
+    return ret;
+}
+
+/**
+    \brief 
+        Used to free all blocks allocated after ypool_mark() in constant time
+
+    \details
+        Bump cursor moves back to the mark & free list is dropped: blocks
+        allocated before the mark & freed after it are not reused until outer
+        release or ypool_reset(). Inner marks are stale after release of outer
+        one. Same threading rules as ypool_reset().
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] mark Position taken by ypool_mark()
+
+    \return 
+        -EFAULT    - Pool or mark pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOTSUP   - Pool is YPOOL_FLAG_GROWABLE, YPOOL_FLAG_NUMA, YPOOL_FLAG_TCACHE or YPOOL_FLAG_LOWFIRST
+        -ESTALE    - Pool was reset or released below the mark after mark was taken
+                 0 - Successfuly released blocks
+*/
+
+int ypool_release(ypool_STC *pool, ypool_mark_STC *mark){
+    uint64_t used;
+    int ret;
+
+    if (mark == NULL)
+        return -EFAULT;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    /* thread caches take blocks from bump cursor in batches, lowest-first pools don't use it */
+    if (pool->flags & (YPOOL_FLAG_GROWABLE | YPOOL_FLAG_NUMA | YPOOL_FLAG_TCACHE | YPOOL_FLAG_LOWFIRST))
+        return -ENOTSUP;
+
+    ylock(pool);
+
+    if (mark->resets != pool->resets || mark->bump_index > __atomic_load_n(pool->bump_index_PTR, __ATOMIC_ACQUIRE)){
+        ret = -ESTALE;
+    }else{
+        used = ystats_used(pool);
+
+        if (used > mark->used)
+            ystats_drop(pool, used - mark->used);
+
+        if (pool->dirty_map != NULL)
+            ydirty_drop(pool, mark->bump_index, *pool->bump_index_PTR);
+
+        yrewind(pool, mark->bump_index);
+        ywaiters_feed(pool);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (DEBUG) printf("ypool_release ret = %d\n",ret);
+    return ret;
+}
+
+/**
+    \brief 
+        Used to return memory of free blocks to the OS
+
+    \details
+        Pages which hold free blocks only are released with madvise()
+        (YPOOL_TRIM_ADVICE), RSS drops & released pages are faulted in again
+        (zero filled) when blocks are used. YPOOL_FLAG_LOWFIRST pool releases
+        page aligned runs of free blocks anywhere in the arena: its free
+        blocks keep no links & lowest-first order keeps the arena tail cold.
+        Free list links of other mutex mode pools live in free blocks, so they
+        release never used blocks from the bump cursor: free blocks right below
+        the cursor are unlinked first & the cursor moves back over them (pool
+        which is idle after a burst releases everything above its highest
+        allocated block). Free blocks below an allocated one stay resident.
+        Moved cursor makes ypool_mark() positions above it stale.
+
+        The scan takes the mutex for one chunk at a time: run of
+        YPOOL_FLAG_LOWFIRST pool is reserved in the bitmap while madvise()
+        runs without lock (ypool_for_each_allocated() may report reserved
+        blocks), never used blocks are released under the mutex by
+        YPOOL_TRIM_PAGES pages. With pool->trim_threshold set, free calls
+        ypool_trim() after every trim_threshold freed bytes, once per
+        YPOOL_TRIM_INTERVAL_MS at most.
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[out] released Released bytes (may be NULL)
+
+    \return 
+        -EFAULT    - Pool pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOTSUP   - Pool is YPOOL_FLAG_LOCKFREE (bump cursor moves without lock) or its arena is locked
+        -ENOMEM    - There is no memory to scan the free list
+        other < 0  - madvise() error (released counts pages released before it)
+                 0 - On success
+*/
+
+int ypool_trim(ypool_STC *pool, size_t *released){
+    size_t total = 0;
+    size_t node_total;
+    size_t page;
+    uint32_t node;
+    int ret;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    if (pool->flags & YPOOL_FLAG_NUMA){
+        for (node = 0; node < pool->numa_nodes && ret == 0; node++)
+        {
+            ret = ypool_trim(&pool->numa_pools[node], &node_total);
+            total += node_total;
+        }
+    }else if ((pool->flags & YPOOL_FLAG_LOCKFREE) || (pool->backing & YPOOL_BACKING_LOCKED)){
+        ret = -ENOTSUP;
+    }else{
+        /* explicit huge pages are released whole */
+        page = (pool->backing & YPOOL_BACKING_HUGETLB) ? YPOOL_HUGEPAGE_SIZE : (size_t)sysconf(_SC_PAGESIZE);
+
+        if (pool->flags & YPOOL_FLAG_LOWFIRST){
+            ret = ytrim_runs(pool, page, &total);
+        }else{
+            /* bump cursor in the mapping is shared with other processes */
+            if (!(pool->flags & YPOOL_FLAG_SHARED))
+                ret = ytrim_tail(pool);
+
+            if (ret == 0)
+                ret = ytrim_bump(pool, page, &total);
+        }
+    }
+
+    if (released != NULL)
+        *released = total;
+
+    if (DEBUG) printf("ypool_trim ret = %d released = %zu\n", ret, total);
+    return ret;
+}
+
+/**
+    \brief 
+        Used to start iteration over allocated blocks
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[out] cursor Iteration position (at the pool start)
+
+    \return 
+        -EFAULT    - Pool or cursor pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOTSUP   - Pool is YPOOL_FLAG_GROWABLE
+                 0 - On success
+*/
+
+int ypool_cursor_init(ypool_STC *pool, ypool_cursor_STC *cursor){
+    int ret;
+
+    if (cursor == NULL)
+        return -EFAULT;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    /* slabs are chained under the mutex, there is no stable block index over them */
+    if (pool->flags & YPOOL_FLAG_GROWABLE)
+        return -ENOTSUP;
+
+    cursor->pool = pool;
+    cursor->node = 0;
+    cursor->index = 0;
+
+    return 0;
+}
+
+/**
+    \brief 
+        Used to get next batch of allocated blocks in address order
+
+    \details
+        Pools with allocation bitmap (YPOOL_FLAG_COMPACT, YPOOL_FLAG_HARDENED)
+        are scanned word by word & empty words are skipped, other pools are
+        scanned by block headers. Mutex mode pool is locked for one chunk of
+        YPOOL_SCAN_WORDS words at a time, YPOOL_FLAG_LOCKFREE/YPOOL_FLAG_TCACHE
+        pools are scanned without lock. Iteration is weakly consistent: blocks
+        allocated or freed during the walk may be reported or not, every block
+        allocated for the whole walk is reported once. Reported block may be
+        freed by other thread before caller looks at it.
+
+    \param[in/out] cursor Position from ypool_cursor_init() (moves past returned blocks)
+    \param[in] count Capacity of user_blocks
+    \param[out] user_blocks Allocated user blocks
+
+    \return 
+        -EFAULT    - Cursor or user_blocks pointer is NULL
+        -EINVAL    - Cursor is not initialized or count is 0
+                >0 - Number of blocks put to user_blocks
+                 0 - Iteration is over
+*/
+
+int ypool_cursor_next(ypool_cursor_STC *cursor, size_t count, AD_POINTER user_blocks[]){
+    ypool_STC *pool;
+    size_t found;
+
+    if (cursor == NULL || user_blocks == NULL)
+        return -EFAULT;
+
+    if (cursor->pool == NULL || count == 0)
+        return -EINVAL;
+
+    if (count > INT_MAX)
+        count = INT_MAX;
+
+    for (;;)
+    {
+        pool = cursor->pool;
+
+        if (pool->flags & YPOOL_FLAG_NUMA){
+            if (cursor->node >= pool->numa_nodes)
+                return 0;
+
+            pool = &pool->numa_pools[cursor->node];
+        }
+
+        found = yscan(pool, &cursor->index, count, user_blocks);
+
+        if (found != 0)
+            return (int)found;
+
+        /* scanned up to the bump cursor */
+        if (cursor->index >= __atomic_load_n(pool->bump_index_PTR, __ATOMIC_ACQUIRE)){
+            if (!(cursor->pool->flags & YPOOL_FLAG_NUMA))
+                return 0;
+
+            cursor->node++;
+            cursor->index = 0;
+        }
+    }
+}
+
+/**
+    \brief 
+        Used to call visit for every allocated block
+
+    \details
+        Blocks are collected by ypool_cursor_next() in batches of
+        YPOOL_VISIT_BATCH, callbacks run without pool lock (they may allocate
+        & free blocks of the same pool). Same consistency as ypool_cursor_next().
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] visit Callback (not 0 - stop iteration)
+    \param[in] ctx Callback argument
+
+    \return 
+        -EFAULT    - Pool or visit pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOTSUP   - Pool is YPOOL_FLAG_GROWABLE
+                 0 - All blocks are visited
+             other - Value returned by visit
+*/
+
+int ypool_for_each_allocated(ypool_STC *pool, ypool_visit_FN visit, void *ctx){
+    ypool_cursor_STC cursor;
+    AD_POINTER blocks[YPOOL_VISIT_BATCH];
+    int found;
+    int ret;
+    int i;
+
+    if (visit == NULL)
+        return -EFAULT;
+
+    ret = ypool_cursor_init(pool, &cursor);
+
+    if (ret != 0)
+        return ret;
+
+    while ((found = ypool_cursor_next(&cursor, YPOOL_VISIT_BATCH, blocks)) > 0)
+    {
+        for (i = 0; i < found; i++)
+        {
+            ret = visit(blocks[i], ctx);
+
+            if (ret != 0)
+                return ret;
+        }
+    }
+
+    return found;
+}
+
+/**
+    \brief 
+        Used to write events recorded by YPOOL_FLAG_TRACE pool
+
+    \details
+        Output is ytrace_header_STC followed by header.events ytrace_event_STC
+        records (ring by ring, every ring oldest first). Rings are copied without
+        stopping writers: events overwritten during the copy are dropped &
+        counted in header.lost, like events overwritten before the dump.
+        Timestamps are converted to ns with the two clock pairs of the header.
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] fd File descriptor to write to
+
+    \return 
+        -EFAULT    - Pool pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOTSUP   - Pool is not YPOOL_FLAG_TRACE pool
+        -ENOMEM    - Unable to allocate copy of the rings
+        -errno     - write() error
+                 0 - On success
+*/
+
+int ypool_trace_dump(ypool_STC *pool, int fd){
+    ytrace_header_STC    header;
+    ytrace_event_STC   * events = NULL;
+    ytrace_ring_STC    * rings;
+    ytrace_ring_STC    * ring;
+    size_t               capacity = 0;
+    size_t               start;
+    uint64_t             head;
+    uint64_t             first;
+    uint64_t             valid;
+    uint64_t             i;
+    int                  ret;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    if (!(pool->flags & YPOOL_FLAG_TRACE))
+        return -ENOTSUP;
+
+    /* rings are pushed to the list head, rings after snapshot are skipped */
+    rings = __atomic_load_n(&pool->trace_rings, __ATOMIC_ACQUIRE);
+
+    for (ring = rings; ring != NULL; ring = ring->next)
+        capacity += YPOOL_TRACE_EVENTS;
+
+    if (capacity != 0 && (events = malloc(capacity * sizeof(ytrace_event_STC))) == NULL)
+        return -ENOMEM;
+
+    memset(&header, 0, sizeof(header));
+
+    for (ring = rings; ring != NULL; ring = ring->next)
+    {
+        /* slot of the oldest event is the slot being written by the owner */
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        first = (head > YPOOL_TRACE_EVENTS - 1) ? head - (YPOOL_TRACE_EVENTS - 1) : 0;
+        start = header.events;
+
+        for (i = first; i < head; i++)
+            events[header.events++] = ring->events[i % YPOOL_TRACE_EVENTS];
+
+        /* drop events the owner overwrote while they were copied */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        valid = (head > YPOOL_TRACE_EVENTS - 1) ? head - (YPOOL_TRACE_EVENTS - 1) : 0;
+
+        if (valid > first){
+            if (valid - first > header.events - start)
+                valid = first + (header.events - start);
+
+            memmove(&events[start], &events[start + (valid - first)], (header.events - start - (valid - first)) * sizeof(ytrace_event_STC));
+            header.events -= valid - first;
+            first = valid;
+        }
+
+        header.lost += first;
+    }
+
+    header.magic = YTRACE_MAGIC;
+    header.version = YTRACE_VERSION;
+    header.event_size = sizeof(ytrace_event_STC);
+    header.block_size = pool->block_size;
+    header.start_ticks = pool->trace_ticks;
+    header.start_ns = pool->trace_ns;
+    header.dump_ticks = ytrace_clock();
+    header.dump_ns = ytrace_ns();
+
+    ret = ywrite_all(fd, &header, sizeof(header));
+
+    if (ret == 0)
+        ret = ywrite_all(fd, events, header.events * sizeof(ytrace_event_STC));
+
+    free(events);
+
+    if (DEBUG) printf("ypool_trace_dump ret = %d events = %llu\n", ret, (unsigned long long)header.events);
+    return ret;
+}
+
+/**
+    \brief 
+        Used to find pool whose arena (or slab) holds the address
+
+    \details
+        Every arena & slab is registered in the address map by
+        ypool_init()/ygrow() & unregistered when it is released. Grains which
+        an arena owns whole are found in constant time. Malloc arena is not
+        aligned to the grain (YPOOL_MAP_GRAIN), so its first & last grains
+        may be shared with other allocations: blocks there are found by
+        binary search over such arenas under a read lock (small arena is all
+        in shared grains). Blocks of YPOOL_FLAG_NUMA sub-pools are mapped to
+        the logical pool. Address inside an arena is not checked to be a block
+        start (yfree_block() does).
+
+    \param[in] user_block Address to look up
+    \param[out] *pool Owning pool
+
+    \return 
+        -EFAULT    - Pool pointer is NULL
+        -EXDEV     - Address is not inside any pool arena
+                 0 - Pool is found
+*/
+
+int ypool_lookup(AD_POINTER user_block, ypool_STC **pool){
+    ypool_STC **entry;
+    uintptr_t grain;
+
+    if (pool == NULL)
+        return -EFAULT;
+
+    grain = (uintptr_t)user_block >> YPOOL_MAP_SHIFT;
+    entry = (grain >> (YPOOL_MAP_BITS - YPOOL_MAP_SHIFT)) == 0 ? ymap_entry(grain, false) : NULL;
+    *pool = (entry != NULL) ? __atomic_load_n(entry, __ATOMIC_ACQUIRE) : NULL;
+
+    if (*pool == YMAP_SHARED)
+        *pool = yrange_find(user_block);
+
+    return (*pool != NULL) ? 0 : -EXDEV;
+}
+
+/**
+    \brief 
+        Used to start read section of YPOOL_FLAG_EPOCH pool
+
+    \details
+        Blocks retired by yfree_block_deferred() are not reused until every
+        section which could see them is left. Sections nest & must be short:
+        a thread inside a section holds back reclamation of all threads.
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+
+    \return 
+        -EFAULT    - Pool pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOTSUP   - Pool is not YPOOL_FLAG_EPOCH pool
+        -ENOMEM    - Unable to allocate epoch record of the thread
+                 0 - Section is started
+*/
+
+int ypool_enter(ypool_STC *pool){
+    yebr_record_STC *record;
+    uint64_t epoch;
+    int ret;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    if (!(pool->flags & YPOOL_FLAG_EPOCH))
+        return -ENOTSUP;
+
+    record = pthread_getspecific(pool->ebr_key);
+
+    if (record == NULL && (record = yebr_record(pool)) == NULL)
+        return -ENOMEM;
+
+    if (record->nesting++ == 0){
+        epoch = __atomic_load_n(&pool->ebr_epoch, __ATOMIC_RELAXED);
+        __atomic_store_n(&record->active, (epoch << 1) | 1, __ATOMIC_RELAXED);
+
+        /* announcement is visible to yebr_advance() before any load of the section */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+
+    return 0;
+}
+
+/**
+    \brief 
+        Used to leave read section started by ypool_enter()
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+
+    \return 
+        -EFAULT    - Pool pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning or thread is not inside read section
+        -ENOTSUP   - Pool is not YPOOL_FLAG_EPOCH pool
+                 0 - Section is left
+*/
+
+int ypool_exit(ypool_STC *pool){
+    yebr_record_STC *record;
+    int ret;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    if (!(pool->flags & YPOOL_FLAG_EPOCH))
+        return -ENOTSUP;
+
+    record = pthread_getspecific(pool->ebr_key);
+
+    if (record == NULL || record->nesting == 0)
+        return -EINVAL;
+
+    /* loads of the section are done before the thread is seen quiescent */
+    if (--record->nesting == 0)
+        __atomic_store_n(&record->active, 0, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+    \brief 
+        Used to retire block which may still be read inside read sections of other threads
+
+    \details
+        Block must be unlinked from the shared structure before the call. It goes
+        to the bag of the current epoch & back to the free list with the whole bag
+        (yfree_blocks()) once the global epoch is 2 epochs ahead: every section
+        which could see the block is left by then. Full bag moves the epoch on;
+        if readers hold it back, the call waits outside read section, or fails
+        inside one (the thread would wait for itself). So garbage is bounded by
+        3 * YPOOL_EBR_BATCH blocks per thread. Bags of exited threads are
+        reclaimed by other threads. Bags pending at ypool_reset() are dropped.
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] user_block Block to retire
+
+    \return 
+        -EFAULT    - Pool pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOTSUP   - Pool is not YPOOL_FLAG_EPOCH pool
+        -EXDEV     - Block doesn't belong to the pool
+        -EBUSY     - Bag is full & readers hold the epoch back (called inside read section, block is not retired)
+        -ENOMEM    - Unable to allocate epoch record of the thread
+                 0 - Block is retired
+*/
+
+int yfree_block_deferred(ypool_STC *pool, AD_POINTER user_block){
+    yebr_record_STC *record;
+    yebr_bag_STC *bag;
+    ypool_STC *owner;
+    uint64_t epoch;
+    int ret;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    if (!(pool->flags & YPOOL_FLAG_EPOCH))
+        return -ENOTSUP;
+
+    owner = (pool->flags & YPOOL_FLAG_NUMA) ? ynuma_owner(pool, user_block) : pool;
+
+    if (owner == NULL || !yblock_belongs_to_pool(owner, user_block))
+        return -EXDEV;
+
+    record = pthread_getspecific(pool->ebr_key);
+
+    if (record == NULL && (record = yebr_record(pool)) == NULL)
+        return -ENOMEM;
+
+    while (true)
+    {
+        epoch = __atomic_load_n(&pool->ebr_epoch, __ATOMIC_ACQUIRE);
+        bag = &record->bags[epoch % 3];
+
+        /* bag of epoch - 3 (or older) is safe to reuse, bag of older pool reset is dropped */
+        if (bag->epoch != epoch || bag->resets != __atomic_load_n(&pool->resets, __ATOMIC_RELAXED)){
+            yebr_flush(pool, bag);
+            bag->epoch = epoch;
+            bag->resets = __atomic_load_n(&pool->resets, __ATOMIC_RELAXED);
+        }
+
+        if (bag->count < YPOOL_EBR_BATCH)
+            break;
+
+        if (yebr_advance(pool, epoch)){
+            yebr_reclaim_orphans(pool, record);
+            continue;
+        }
+
+        if (record->nesting != 0)
+            return -EBUSY;
+
+        sched_yield();
+    }
+
+    bag->blocks[bag->count++] = user_block;
+
+    return 0;
+}
+
+/**
+    \brief 
+        Used to wait for read sections started before the call & free retired blocks
+
+    \details
+        Frees blocks retired by the calling thread & bags of exited threads,
+        e.g. before the pool is dropped. Blocks retired concurrently by other
+        live threads stay in their bags.
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+
+    \return 
+        -EFAULT    - Pool pointer is NULL
+        -EINVAL    - Pool has no pointer to the beginning
+        -ENOTSUP   - Pool is not YPOOL_FLAG_EPOCH pool
+        -EBUSY     - Called inside read section (the thread would wait for itself)
+                 0 - On success
+*/
+
+int ypool_synchronize(ypool_STC *pool){
+    yebr_record_STC *record;
+    uint64_t epoch, target;
+    int ret;
+
+    ret = ypool_check(pool);
+
+    if (ret != 0)
+        return ret;
+
+    if (!(pool->flags & YPOOL_FLAG_EPOCH))
+        return -ENOTSUP;
+
+    record = pthread_getspecific(pool->ebr_key);
+
+    if (record != NULL && record->nesting != 0)
+        return -EBUSY;
+
+    target = __atomic_load_n(&pool->ebr_epoch, __ATOMIC_ACQUIRE) + 2;
+
+    while ((epoch = __atomic_load_n(&pool->ebr_epoch, __ATOMIC_ACQUIRE)) < target)
+    {
+        if (!yebr_advance(pool, epoch))
+            sched_yield();
+    }
+
+    if (record != NULL)
+        yebr_reclaim(pool, record);
+
+    yebr_reclaim_orphans(pool, record);
+
+    return 0;
+}
+
+/**
+    \brief 
+        Used to format initiated pool to singly linked list
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+
+    \return 
+        -EFAULT - Pool pointer is NULL
+        -EINVAL - Pool has no pointer to the beginning
+              0 - On success
+*/
+
+static int yformat(ypool_STC *pool){
+    yblock_STC        * block;
+    AD_POINTER          block_PTR;
+    uint32_t            curr_block_num;
+    int                 ret;
+    size_t              blocks_in_pool;
+
+    /* 1. Check the pool for validity */
+    ret = ypool_check(pool);
+
+    if(ret != 0)
+        return ret;
+    /* 2. reserved */
+    //fixme: prevent format while memory is allocated to user
+
+    /* 3. Lock pool */ 
+    pthread_mutex_lock(&pool->mutex);
+    /* 4. Set block_PTR to the beginning of the pool */
+    block_PTR = pool->start_PTR;
+
+    blocks_in_pool = pool->pool_size/pool->block_size;
+
+    if (pool->flags & YPOOL_FLAG_LOCKFREE){
+        /* link blocks by index & point tagged head to the 1st block */
+        for (curr_block_num=0; curr_block_num < blocks_in_pool-1; curr_block_num++)
+        {
+            block = (yblock_STC*) block_PTR;
+            block->next_block = (AD_POINTER)(uintptr_t)(curr_block_num + 2); /* index of next block + 1 */
+            block_PTR += yblock_stride(pool);
+        }
+
+        block = (yblock_STC*) block_PTR;
+        block->next_block = YBLOCK_LIST_END;
+
+        __atomic_store_n(pool->lf_head_PTR, 1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&pool->mutex);
+
+        return 0;
+    }
+
+    /* */
+    for (curr_block_num=0; curr_block_num < blocks_in_pool-1; curr_block_num++)
+    {
+        /* decode current block */
+        block = (yblock_STC*) block_PTR;
+        /* set pointer to next block */
+        block->next_block = block_PTR + yblock_stride(pool);
+
+        block_PTR += yblock_stride(pool);
+    }
+
+    /* set list end for last block (NULL is for allocated blocks) */
+    block = (yblock_STC*) block_PTR;
+    block->next_block = YBLOCK_LIST_END;
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    return 0;
+}
+
+/**
+    \brief Allocate pool arena (malloc or mmap depending on pool flags)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] size Arena size
+    \return Arena or NULL if there is no memory
+*/
+
+static AD_POINTER yarena_alloc(ypool_STC *pool, size_t size){
+    AD_POINTER arena;
+
+    pool->backing = 0;
+    pool->arena_size = size;
+
+    /* small malloc arena shares map grains with other allocations */
+    if (pool->flags & YPOOL_FLAGS_MMAP)
+        arena = yarena_map(pool, size, &pool->arena_size, &pool->backing);
+    else
+        arena = malloc(size);
+
+    if (arena != NULL && ymap_set(arena, size, pool) != 0){
+        pool->start_PTR = arena;
+        yarena_free(pool);
+        return NULL;
+    }
+
+    return arena;
+}
+
+/**
+    \brief
+        Map pool arena (or slab): MAP_HUGETLB -> transparent huge pages -> regular pages
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] size Arena size
+    \param[out] *map_size Mapped length
+    \param[out] *backing YPOOL_BACKING_* which was actually got
+
+    \return Arena or NULL if there is no memory
+*/
+
+static AD_POINTER yarena_map(ypool_STC *pool, size_t size, size_t *map_size, uint32_t *backing){
+    AD_POINTER    arena = MAP_FAILED;
+    size_t        page_size;
+    size_t        huge_size;
+    int           map_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    bool          prefault = (pool->flags & YPOOL_FLAG_POPULATE) != 0;
+
+    *backing = 0;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    huge_size = (size + YPOOL_HUGEPAGE_SIZE - 1) / YPOOL_HUGEPAGE_SIZE * YPOOL_HUGEPAGE_SIZE;
+
+    /* NUMA sub-pool arena is pre-faulted after it is bound to the node */
+    if (prefault && !(pool->flags & YPOOL_FLAG_NUMA_NODE))
+        map_flags |= MAP_POPULATE;
+
+    if (pool->flags & YPOOL_FLAG_HUGEPAGES){
+#ifdef MAP_HUGETLB
+        arena = mmap(NULL, huge_size, PROT_READ | PROT_WRITE, map_flags | MAP_HUGETLB, -1, 0);
+
+        if (arena != MAP_FAILED){
+            *map_size = huge_size;
+            *backing |= YPOOL_BACKING_HUGETLB;
+        }
+#endif
+        /* no reserved huge pages - ask for THP (must be advised before first touch) */
+        if (arena == MAP_FAILED){
+            arena = ymap_aligned(huge_size, YPOOL_HUGEPAGE_SIZE);
+
+            if (arena != MAP_FAILED){
+                *map_size = huge_size;
+#ifdef MADV_HUGEPAGE
+                if (madvise(arena, huge_size, MADV_HUGEPAGE) == 0)
+                    *backing |= YPOOL_BACKING_THP;
+#endif
+                if (prefault && !(pool->flags & YPOOL_FLAG_NUMA_NODE))
+                    yarena_prefault(arena, huge_size);
+            }
+        }
+    }
+
+    if (arena == MAP_FAILED){
+        *map_size = (size + page_size - 1) / page_size * page_size;
+        arena = mmap(NULL, *map_size, PROT_READ | PROT_WRITE, map_flags, -1, 0);
+    }
+
+    if (arena == MAP_FAILED)
+        return NULL;
+
+    *backing |= YPOOL_BACKING_MMAP;
+
+    if (pool->flags & YPOOL_FLAG_NUMA_NODE){
+        if (ynuma_bind(arena, *map_size, pool->numa_node) == 0)
+            *backing |= YPOOL_BACKING_NUMA;
+
+        if (prefault)
+            yarena_prefault(arena, *map_size);
+    }
+
+    if (prefault)
+        *backing |= YPOOL_BACKING_POPULATED;
+
+    if ((pool->flags & YPOOL_FLAG_MLOCK) && mlock(arena, *map_size) == 0)
+        *backing |= YPOOL_BACKING_LOCKED;
+
+    return arena;
+}
+
+/**
+    \brief Map anonymous memory aligned to `align` (cut unaligned head & tail of bigger mapping)
+    \param[in] size Mapping size (multiple of align)
+    \param[in] align Alignment (power of 2, multiple of page size)
+    \return Mapping or MAP_FAILED
+*/
+
+static AD_POINTER ymap_aligned(size_t size, size_t align){
+    AD_POINTER    raw;
+    AD_POINTER    aligned;
+
+    raw = mmap(NULL, size + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (raw == MAP_FAILED)
+        return MAP_FAILED;
+
+    aligned = (AD_POINTER)(((uintptr_t)raw + align - 1) & ~(uintptr_t)(align - 1));
+
+    if (aligned != raw)
+        munmap(raw, aligned - raw);
+
+    munmap(aligned + size, (raw + size + align) - (aligned + size));
+
+    return aligned;
+}
+
+/**
+    \brief Fault in whole arena (MADV_POPULATE_WRITE or touch every page)
+    \param[in] arena Mapped arena
+    \param[in] size Arena size
+*/
+
+static void yarena_prefault(AD_POINTER arena, size_t size){
+    size_t page_size;
+    size_t offset;
+
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(arena, size, MADV_POPULATE_WRITE) == 0)
+        return;
+#endif
+
+    page_size = sysconf(_SC_PAGESIZE);
+
+    for (offset = 0; offset < size; offset += page_size)
+        ((volatile uint8_t*)arena)[offset] = 0; /* fresh anonymous memory is zero anyway */
+}
+
+/**
+    \brief Release pool arena (munmap or free depending on backing)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+*/
+
+static void yarena_free(ypool_STC *pool){
+    ymap_set(pool->start_PTR, pool->pool_size / pool->block_size * yblock_stride(pool), NULL);
+
+    if (pool->backing & YPOOL_BACKING_SHARED)
+        munmap(pool->shm, pool->arena_size);
+    else if (pool->backing & YPOOL_BACKING_MMAP)
+        munmap(pool->start_PTR, pool->arena_size);
+    else
+        free(pool->start_PTR);
+
+    pool->start_PTR = NULL;
+}
+
+/**
+    \brief Release slabs of YPOOL_FLAG_GROWABLE pool & every version of slab index
+    \param[in] pool Pointer to the pool to which the operation will be applied
+*/
+
+static void yslabs_free(ypool_STC *pool){
+    yslab_index_STC *index;
+    yslab_index_STC *prev;
+    size_t i;
+
+    index = pool->slab_index;
+
+    /* the newest index lists all slabs */
+    for (i = 0; index != NULL && i < index->count; i++)
+    {
+        ymap_set(index->slabs[i].start_PTR, index->slabs[i].end_PTR - index->slabs[i].start_PTR, NULL);
+        munmap(index->slabs[i].start_PTR, index->slabs[i].map_size);
+    }
+
+    for (; index != NULL; index = prev)
+    {
+        prev = index->prev;
+        free(index);
+    }
+
+    pool->slab_index = NULL;
+}
+
+/**
+    \brief Create thread keys of the pool (YPOOL_FLAG_TRACE, YPOOL_FLAG_EPOCH, YPOOL_FLAG_TCACHE)
+    \details
+        Rings & epoch records belong to the logical pool, sub-pools of
+        YPOOL_FLAG_NUMA pool are not traced & have their own caches.
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \return 0 or -EAGAIN (keys created before the failed one are deleted)
+*/
+
+static int ykeys_create(ypool_STC *pool){
+    if ((pool->flags & YPOOL_FLAG_TRACE) && pthread_key_create(&pool->trace_key, ytrace_release) != 0)
+        return -EAGAIN;
+
+    if ((pool->flags & YPOOL_FLAG_EPOCH) && pthread_key_create(&pool->ebr_key, yebr_release) != 0){
+        if (pool->flags & YPOOL_FLAG_TRACE)
+            pthread_key_delete(pool->trace_key);
+        return -EAGAIN;
+    }
+
+    /* thread caches are flushed back to the pool by key destructor on thread exit */
+    if ((pool->flags & YPOOL_FLAG_TCACHE) && !(pool->flags & YPOOL_FLAG_NUMA) && pthread_key_create(&pool->tcache_key, ytcache_destroy) != 0){
+        if (pool->flags & YPOOL_FLAG_TRACE)
+            pthread_key_delete(pool->trace_key);
+        if (pool->flags & YPOOL_FLAG_EPOCH)
+            pthread_key_delete(pool->ebr_key);
+        return -EAGAIN;
+    }
+
+    if (pool->flags & YPOOL_FLAG_TRACE){
+        pool->trace_rings = NULL;
+        pool->trace_ticks = ytrace_clock();
+        pool->trace_ns = ytrace_ns();
+    }
+
+    if (pool->flags & YPOOL_FLAG_EPOCH){
+        pool->ebr_records = NULL;
+        pool->ebr_epoch = 0;
+    }
+
+    return 0;
+}
+
+/**
+    \brief Delete thread keys of the pool, trace rings & epoch records of all threads are freed
+    \param[in] pool Pointer to the pool to which the operation will be applied
+*/
+
+static void ykeys_delete(ypool_STC *pool){
+    ytrace_ring_STC *ring;
+    yebr_record_STC *record;
+
+    /* logical YPOOL_FLAG_NUMA pool has no cache, its sub-pools have */
+    if ((pool->flags & YPOOL_FLAG_TCACHE) && !(pool->flags & YPOOL_FLAG_NUMA))
+        pthread_key_delete(pool->tcache_key);
+
+    if (pool->flags & YPOOL_FLAG_TRACE){
+        pthread_key_delete(pool->trace_key);
+
+        while ((ring = pool->trace_rings) != NULL){
+            pool->trace_rings = ring->next;
+            free(ring);
+        }
+    }
+
+    if (pool->flags & YPOOL_FLAG_EPOCH){
+        pthread_key_delete(pool->ebr_key);
+
+        while ((record = pool->ebr_records) != NULL){
+            pool->ebr_records = record->next;
+            free(record);
+        }
+    }
+}
+
+/**
+    \brief Set owner of map grains covering the range (NULL - unregister range)
+    \param[in] start Range start
+    \param[in] size Range size
+    \param[in] pool Owning pool or NULL
+    \return 0, -EINVAL (range is above YPOOL_MAP_BITS) or -ENOMEM (range is left unregistered)
+*/
+
+static int ymap_set(AD_POINTER start, size_t size, ypool_STC *pool){
+    ypool_STC **entry;
+    ypool_STC *owner;
+    uintptr_t first, last, grain;
+    bool head, tail;
+
+    if (size == 0)
+        return 0;
+
+    first = (uintptr_t)start >> YPOOL_MAP_SHIFT;
+    last = ((uintptr_t)start + size - 1) >> YPOOL_MAP_SHIFT;
+
+    if ((last >> (YPOOL_MAP_BITS - YPOOL_MAP_SHIFT)) != 0)
+        return (pool != NULL) ? -EINVAL : 0;
+
+    /* grains at unaligned ends may be shared with neighbour allocations, their owner is found by range */
+    head = ((uintptr_t)start & (YPOOL_MAP_GRAIN - 1)) != 0;
+    tail = (((uintptr_t)start + size) & (YPOOL_MAP_GRAIN - 1)) != 0;
+
+    if ((head || tail) && yrange_set(start, size, pool) != 0)
+        return -ENOMEM;
+
+    for (grain = first; grain <= last; grain++)
+    {
+        owner = pool;
+
+        /* released shared grain keeps its mark, lookup finds no range then */
+        if ((grain == first && head) || (grain == last && tail)){
+            if (pool == NULL)
+                continue;
+            owner = YMAP_SHARED;
+        }
+
+        entry = ymap_entry(grain, pool != NULL);
+
+        if (entry != NULL){
+            __atomic_store_n(entry, owner, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        if (pool == NULL)
+            continue;
+
+        while (grain-- > first)
+            if (!((grain == first && head) || (grain == last && tail)))
+                __atomic_store_n(ymap_entry(grain, false), NULL, __ATOMIC_RELEASE);
+
+        if (head || tail)
+            yrange_set(start, size, NULL);
+        return -ENOMEM;
+    }
+
+    return 0;
+}
+
+/**
+    \brief Set owner of arena range with an unaligned end (NULL - remove range)
+    \param[in] start Range start
+    \param[in] size Range size
+    \param[in] pool Owning pool or NULL
+    \return 0 or -ENOMEM (range is not added)
+*/
+
+static int yrange_set(AD_POINTER start, size_t size, ypool_STC *pool){
+    ymap_range_STC *ranges;
+    size_t lo = 0;
+    size_t hi;
+    size_t mid;
+    int ret = 0;
+
+    pthread_rwlock_wrlock(&ymap_ranges_lock);
+
+    /* the first range which starts at start or above */
+    hi = ymap_ranges_count;
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if (ymap_ranges[mid].start_PTR < start)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < ymap_ranges_count && ymap_ranges[lo].start_PTR == start){
+        if (pool != NULL){
+            ymap_ranges[lo].end_PTR = start + size;
+            ymap_ranges[lo].pool = pool;
+        }else{
+            memmove(&ymap_ranges[lo], &ymap_ranges[lo + 1], (ymap_ranges_count - lo - 1) * sizeof(ymap_range_STC));
+            ymap_ranges_count--;
+        }
+    }else if (pool != NULL){
+        if (ymap_ranges_count == ymap_ranges_capacity){
+            ranges = realloc(ymap_ranges, (ymap_ranges_capacity ? ymap_ranges_capacity * 2 : 16) * sizeof(ymap_range_STC));
+
+            if (ranges != NULL){
+                ymap_ranges = ranges;
+                ymap_ranges_capacity = ymap_ranges_capacity ? ymap_ranges_capacity * 2 : 16;
+            }else{
+                ret = -ENOMEM;
+            }
+        }
+
+        if (ret == 0){
+            memmove(&ymap_ranges[lo + 1], &ymap_ranges[lo], (ymap_ranges_count - lo) * sizeof(ymap_range_STC));
+            ymap_ranges[lo].start_PTR = start;
+            ymap_ranges[lo].end_PTR = start + size;
+            ymap_ranges[lo].pool = pool;
+            ymap_ranges_count++;
+        }
+    }
+
+    pthread_rwlock_unlock(&ymap_ranges_lock);
+
+    return ret;
+}
+
+/**
+    \brief Find arena range which holds the address (grain marked YMAP_SHARED)
+    \param[in] address Address to look up
+    \return Owning pool or NULL
+*/
+
+static ypool_STC *yrange_find(AD_POINTER address){
+    ypool_STC *pool = NULL;
+    size_t lo = 0;
+    size_t hi;
+    size_t mid;
+
+    pthread_rwlock_rdlock(&ymap_ranges_lock);
+
+    /* the first range which starts above the address */
+    hi = ymap_ranges_count;
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if (ymap_ranges[mid].start_PTR <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo > 0 && address < ymap_ranges[lo - 1].end_PTR)
+        pool = ymap_ranges[lo - 1].pool;
+
+    pthread_rwlock_unlock(&ymap_ranges_lock);
+
+    return pool;
+}
+
+/**
+    \brief Get map entry of the grain
+    \param[in] grain Address >> YPOOL_MAP_SHIFT (below 2^(YPOOL_MAP_BITS - YPOOL_MAP_SHIFT))
+    \param[in] create Allocate missing nodes
+    \return Entry or NULL (node is missing, or there is no memory for it)
+*/
+
+static ypool_STC **ymap_entry(uintptr_t grain, bool create){
+    void **slot;
+    void *node, *fresh;
+    int level;
+
+    slot = &ymap_root[grain >> (2 * YPOOL_MAP_LEVEL_BITS)];
+
+    for (level = 1; level >= 0; level--)
+    {
+        node = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+
+        if (node == NULL){
+            if (!create)
+                return NULL;
+
+            fresh = calloc(YPOOL_MAP_FANOUT, sizeof(void*));
+
+            if (fresh == NULL)
+                return NULL;
+
+            /* lost the race: node holds the winner */
+            if (__atomic_compare_exchange_n(slot, &node, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                node = fresh;
+            else
+                free(fresh);
+        }
+
+        slot = (void**)node + ((grain >> (level * YPOOL_MAP_LEVEL_BITS)) & (YPOOL_MAP_FANOUT - 1));
+    }
+
+    return (ypool_STC**)slot;
+}
+
+/**
+    \brief
+        Create or attach shared mapping of YPOOL_FLAG_SHARED pool
+
+    \details
+        Named pool (pool->shm_name, or pool->file_path for YPOOL_FLAG_PERSISTENT)
+        is created by the first ypool_init() & attached by the next ones. Anonymous
+        pool is created as memfd (pool->shm_fd is set) & attached by setting
+        pool->shm_fd of other process handle to that fd (inherited by fork or
+        passed over unix socket). Mapping address differs between processes, so
+        only block indexes are stored in the mapping.
+
+        Every attached handle holds read lock of the users byte of the file (OFD
+        lock, owned by the handle's open file description). Handle which gets
+        write lock of it is the only user: if the last user before it didn't
+        detach with ypool_close(), pool state may be torn & attach fails. Users
+        are checked under write lock of the gate byte by both attach & detach,
+        so concurrent handles never see a live pool unlocked or miss the last
+        detach.
+
+    \param[in/out] pool Pointer to the pool to which the operation will be applied
+    \param[in] blocks_in_pool Blocks in pool arena
+
+    \return
+        -EINVAL    - Attached pool has other geometry or version
+        -EAGAIN    - Attached pool is not formatted by its creator yet
+        -EUCLEAN   - Last user of attached pool crashed (pool was not closed with ypool_close())
+        -ENOMEM    - Unable to size or map shared memory
+        -errno     - Unable to open shared memory object or file (shm_open/open/memfd_create errno)
+                 0 - Successfuly created or attached pool
+*/
+
+static int yshm_init(ypool_STC *pool, size_t blocks_in_pool){
+    ypool_shm_STC *shm;
+    struct stat st;
+    size_t map_size;
+    bool created = false;
+    char fd_path[32];
+    int fd;
+    int ret = 0;
+
+    map_size = YPOOL_SHM_HEADER_SIZE + blocks_in_pool * yblock_stride(pool);
+
+    if (pool->flags & YPOOL_FLAG_PERSISTENT){
+        fd = open(pool->file_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        created = (fd >= 0);
+
+        if (fd < 0 && errno == EEXIST)
+            fd = open(pool->file_path, O_RDWR | O_CLOEXEC);
+    }else if (pool->shm_name != NULL){
+        fd = shm_open(pool->shm_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        created = (fd >= 0);
+
+        if (fd < 0 && errno == EEXIST)
+            fd = shm_open(pool->shm_name, O_RDWR, 0);
+    }else if (pool->shm_fd > 0){
+        /* own open file description, so the lock of this handle is independent */
+        snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", pool->shm_fd);
+        fd = open(fd_path, O_RDWR);
+    }else{
+        fd = memfd_create("ypool", 0);
+        created = (fd >= 0);
+    }
+
+    if (fd < 0)
+        return -errno;
+
+    if (created && ftruncate(fd, map_size) != 0){
+        ret = -ENOMEM;
+        goto error;
+    }
+
+    if (!created){
+        if (fstat(fd, &st) != 0)
+            ret = -errno;
+        else if (st.st_size == 0)
+            ret = -EAGAIN; /* creator has not sized it yet */
+        else if ((size_t)st.st_size != map_size)
+            ret = -EINVAL;
+
+        if (ret != 0)
+            goto error;
+    }
+
+    shm = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (shm == MAP_FAILED){
+        ret = -ENOMEM;
+        goto error;
+    }
+
+    if (!created){
+        if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != YPOOL_SHM_MAGIC){
+            ret = -EAGAIN;
+        }else if (shm->version != YPOOL_SHM_VERSION || shm->block_size != pool->block_size
+            || shm->pool_size != pool->pool_size || ((shm->flags ^ pool->flags) & YPOOL_FLAGS_SHARED)){
+            ret = -EINVAL;
+        }
+    }
+
+    if (ret == 0)
+        ret = yshm_lock(fd, YSHM_LOCK_GATE, F_WRLCK, true);
+
+    if (ret == 0){
+        /* the only user: previous users are gone, check they detached cleanly */
+        if (yshm_lock(fd, YSHM_LOCK_USERS, F_WRLCK, false) == 0){
+            if (!created && !shm->clean)
+                ret = -EUCLEAN;
+            else
+                shm->clean = 0; /* dirty while attached */
+        }
+
+        /* downgrade is atomic, others hold read locks only outside the gate */
+        if (ret == 0)
+            ret = yshm_lock(fd, YSHM_LOCK_USERS, F_RDLCK, false);
+
+        yshm_lock(fd, YSHM_LOCK_GATE, F_UNLCK, false);
+    }
+
+    if (ret == 0 && ymap_set((AD_POINTER)shm + YPOOL_SHM_HEADER_SIZE, blocks_in_pool * yblock_stride(pool), pool) != 0)
+        ret = -ENOMEM;
+
+    if (ret != 0){
+        munmap(shm, map_size);
+        goto error;
+    }
+
+    pool->shm = shm;
+    pool->shm_fd = fd;
+    pool->lf_head_PTR = &shm->lf_head;
+    pool->bump_index_PTR = &shm->bump_index;
+    pool->backing = YPOOL_BACKING_MMAP | YPOOL_BACKING_SHARED;
+    pool->arena_size = map_size;
+    pool->next_free_block_PTR = NULL;
+    pool->start_PTR = (AD_POINTER)shm + YPOOL_SHM_HEADER_SIZE;
+
+    /* warm restart: free list & allocated blocks are in the mapping already */
+    if (!created)
+        return 0;
+
+    shm->version = YPOOL_SHM_VERSION;
+    shm->flags = pool->flags;
+    shm->block_size = pool->block_size;
+    shm->pool_size = pool->pool_size;
+
+    /* fresh mapping is zeroed: empty free list, never used blocks from index 0 */
+    if (!(pool->flags & YPOOL_FLAG_LAZY)){
+        shm->bump_index = blocks_in_pool;
+        yformat(pool);
+    }
+
+    /* publish formatted pool to attaching processes */
+    __atomic_store_n(&shm->magic, YPOOL_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    return 0;
+
+    error:
+    close(fd);
+    if (created && (pool->flags & YPOOL_FLAG_PERSISTENT))
+        unlink(pool->file_path);
+    else if (created && pool->shm_name != NULL)
+        shm_unlink(pool->shm_name);
+    return ret;
+}
+
+/**
+    \brief Lock one byte of mapping file with OFD lock (lock type changes atomically, failed change keeps the old lock)
+    \param[in] fd Mapping file descriptor
+    \param[in] byte YSHM_LOCK_*
+    \param[in] type F_RDLCK, F_WRLCK or F_UNLCK
+    \param[in] wait Wait for conflicting locks of other handles
+    \return 0 or -errno (-EAGAIN - conflicting lock is held)
+*/
+
+static int yshm_lock(int fd, off_t byte, short type, bool wait){
+    struct flock lock;
+
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = byte;
+    lock.l_len = 1;
+
+    while (fcntl(fd, wait ? F_OFD_SETLKW : F_OFD_SETLK, &lock) != 0)
+    {
+        if (errno != EINTR)
+            return (errno == EACCES) ? -EAGAIN : -errno;
+    }
+
+    return 0;
+}
+
+/**
+    \brief 
+        Checks belonging of a user block to the pool
+
+    \details
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+
+    \return 
+        false - Not belongs to the pool
+        true  - Belongs to the pool
+*/
+
+static bool yblock_belongs_to_pool(ypool_STC *pool, AD_POINTER user_block)
+{
+    AD_POINTER      lowest_user_pointer;
+    AD_POINTER      highest_user_pointer;
+    size_t          blocks_in_pool;
+    uint64_t        offset;
+
+    if(ypool_check(pool) != 0)
+        return false;
+
+    blocks_in_pool = pool->pool_size/pool->block_size;
+
+    lowest_user_pointer = pool->start_PTR + yblock_header(pool);
+    highest_user_pointer = lowest_user_pointer + (yblock_stride(pool) * (blocks_in_pool-1));
+
+    if (DEBUG) printf("#ybbtp pool->start_PTR=0x%x\n",pool->start_PTR);
+    if (DEBUG) printf("#ybbtp highest_user_pointer=0x%x\n",highest_user_pointer);
+    if (DEBUG) printf("#ybbtp user_block=0x%x\n",user_block);
+    if (DEBUG) printf("#ybbtp lowest_user_pointer=0x%x\n",lowest_user_pointer);
+
+    /* user block is between pool edges (& is the start of a block) */
+    if (lowest_user_pointer <= user_block && user_block <= highest_user_pointer){
+        if (!(pool->flags & YPOOL_FLAG_HARDENED))
+            return true;
+
+        offset = user_block - lowest_user_pointer;
+
+        /* offset is multiple of stride if offset * magic wraps below magic */
+        if (pool->stride_magic != 0)
+            return offset * pool->stride_magic <= pool->stride_magic - 1;
+
+        return offset % yblock_stride(pool) == 0;
+    }
+
+    if (pool->flags & YPOOL_FLAG_GROWABLE)
+        return yslab_find(pool, user_block) != NULL;
+
+    return false;
+}
+
+/**
+    \brief Find slab (YPOOL_FLAG_GROWABLE) which contains user block: binary search in address sorted slab index
+
+    \details Safe without the mutex: index is replaced as a whole & old indexes are kept
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] user_block User block to look for
+
+    \return Slab or NULL if user block is not in any slab
+*/
+
+static yslab_STC *yslab_find(ypool_STC *pool, AD_POINTER user_block){
+    yslab_index_STC * index;
+    yslab_STC       * slab;
+    size_t            low;
+    size_t            high;
+    size_t            mid;
+
+    index = __atomic_load_n(&pool->slab_index, __ATOMIC_ACQUIRE);
+
+    if (index == NULL)
+        return NULL;
+
+    /* find last slab starting before user block */
+    low = 0;
+    high = index->count;
+    while (low < high)
+    {
+        mid = (low + high) / 2;
+        if (index->slabs[mid].start_PTR <= user_block)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == 0)
+        return NULL;
+
+    slab = &index->slabs[low - 1];
+
+    /* true if user block is between slab edges */
+    if (slab->start_PTR + yblock_header(pool) <= user_block && user_block <= slab->end_PTR - yblock_stride(pool) + yblock_header(pool))
+        return slab;
+
+    return NULL;
+}
+
+/**
+    \brief
+        Map new slab & chain its blocks to the free list (YPOOL_FLAG_GROWABLE, mutex must be held)
+
+    \details
+        Slab is growth_factor times bigger than the previous one, total pool size
+        is limited by max_pool_size. Readers of the slab index get a new copy, the
+        replaced one stays valid.
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+
+    \return
+        -ENOMEM - max_pool_size is reached or there is no memory in system
+              0 - On success
+*/
+
+static int ygrow(ypool_STC *pool){
+    yslab_index_STC * index;
+    yslab_index_STC * new_index;
+    AD_POINTER        slab_PTR;
+    size_t            slab_blocks;
+    size_t            max_blocks;
+    size_t            map_size;
+    size_t            i;
+    size_t            pos;
+    uint32_t          backing;
+
+    slab_blocks = pool->slab_blocks * (pool->growth_factor > 1 ? pool->growth_factor : 1);
+
+    if (pool->max_pool_size != 0){
+        max_blocks = pool->max_pool_size / pool->block_size;
+
+        if (pool->total_blocks >= max_blocks)
+            return -ENOMEM;
+
+        if (slab_blocks > max_blocks - pool->total_blocks)
+            slab_blocks = max_blocks - pool->total_blocks;
+    }
+
+    slab_PTR = yarena_map(pool, slab_blocks * yblock_stride(pool), &map_size, &backing);
+
+    if (slab_PTR == NULL)
+        return -ENOMEM;
+
+    index = pool->slab_index;
+    new_index = malloc(sizeof(yslab_index_STC) + ((index ? index->count : 0) + 1) * sizeof(yslab_STC));
+
+    if (new_index == NULL || ymap_set(slab_PTR, slab_blocks * yblock_stride(pool), pool) != 0){
+        free(new_index);
+        munmap(slab_PTR, map_size);
+        return -ENOMEM;
+    }
+
+    /* copy index with the new slab inserted by address */
+    new_index->prev = index;
+    new_index->count = 0;
+    pos = 0;
+    for (i = 0; index != NULL && i < index->count; i++)
+    {
+        if (index->slabs[i].start_PTR < slab_PTR)
+            pos = i + 1;
+        new_index->slabs[new_index->count++] = index->slabs[i];
+    }
+    memmove(&new_index->slabs[pos + 1], &new_index->slabs[pos], (new_index->count - pos) * sizeof(yslab_STC));
+    new_index->slabs[pos].start_PTR = slab_PTR;
+    new_index->slabs[pos].end_PTR = slab_PTR + slab_blocks * yblock_stride(pool);
+    new_index->slabs[pos].map_size = map_size;
+    new_index->count++;
+
+    /* format slab & put it in front of the free list */
+    for (i = 0; i < slab_blocks - 1; i++)
+        ((yblock_STC*)(slab_PTR + i * yblock_stride(pool)))->next_block = slab_PTR + (i + 1) * yblock_stride(pool);
+    ((yblock_STC*)(slab_PTR + i * yblock_stride(pool)))->next_block = (pool->next_free_block_PTR != NULL) ? pool->next_free_block_PTR : YBLOCK_LIST_END;
+    pool->next_free_block_PTR = slab_PTR;
+
+    pool->total_blocks += slab_blocks;
+    pool->slab_blocks = slab_blocks;
+    __atomic_store_n(&pool->slab_index, new_index, __ATOMIC_RELEASE);
+
+    if (DEBUG) printf("ygrow slab=0x%x blocks=%zu total=%zu\n", slab_PTR, slab_blocks, pool->total_blocks);
+    return 0;
+}
+
+/**
+
+    \brief 
+        Validate pool
+
+    \details
+        1. Check that pool PTR is not NULL
+        2. Check that start_PTR is not NULL
+        3. reserved
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+
+    \return 
+        -EFAULT - Pool pointer is NULL
+        -EINVAL - Pool has no pointer to the beginning
+              0 - Pool correct
+
+*/
+
+static int ypool_check(ypool_STC *pool){
+    if (pool == NULL)
+        return -EFAULT;
+
+    if (pool->start_PTR == NULL)
+        return -EINVAL;
+
+    // what else needs to be checked? (& how much to stay fast)
+
+    return 0;
+}
+
+/**
+    \brief Get system block size using user block size
     \param[in] user_block_size User block size
     \return System block size (user accessed memory + pointer memory)
 */
 
-static size_t sys_block_size(size_t user_block_size){
-    return user_block_size + sizeof(AD_POINTER);
+static size_t sys_block_size(size_t user_block_size){
+    return user_block_size + sizeof(AD_POINTER);
+}
+
+/**
+    \brief Get distance between neighbour system blocks of the pool
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \return System block size for pool layout (YPOOL_FLAG_COMPACT has no next block pointer, YPOOL_FLAG_CANARY has guard word after user memory)
+*/
+
+static size_t yblock_stride(ypool_STC *pool){
+    size_t guard = (pool->flags & YPOOL_FLAG_CANARY) ? sizeof(uint64_t) : 0;
+
+    if (pool->flags & YPOOL_FLAG_COMPACT)
+        return pool->block_size + guard;
+
+    return sys_block_size(pool->block_size) + guard;
+}
+
+/**
+    \brief Get offset of user memory inside system block
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \return Size of per-block header for pool layout
+*/
+
+static size_t yblock_header(ypool_STC *pool){
+    if (pool->flags & YPOOL_FLAG_COMPACT)
+        return 0;
+
+    return sizeof(AD_POINTER);
+}
+
+/**
+    \brief Get index of system block in pool arena
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] sys_block System block of the arena
+    \return Block index
+*/
+
+static size_t yblock_index(ypool_STC *pool, AD_POINTER sys_block){
+    uint64_t offset = sys_block - pool->start_PTR;
+
+    /* multiply by reciprocal instead of division (exact for 32 bit offsets) */
+    if (pool->stride_magic != 0)
+        return (size_t)(((unsigned __int128)pool->stride_magic * offset) >> 64);
+
+    return offset / yblock_stride(pool);
+}
+
+/**
+    \brief Get guard word of system block (YPOOL_FLAG_CANARY)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] sys_block System block of the arena
+    \return Expected guard word value
+*/
+
+static uint64_t ycanary_of(ypool_STC *pool, AD_POINTER sys_block){
+    return pool->canary ^ (uint64_t)(uintptr_t)sys_block;
+}
+
+/**
+    \brief Mark popped system block as allocated
+    \details
+        Sets next_block = NULL, and/or sets block bit in alloc_map for YPOOL_FLAG_COMPACT
+        (link is user data there) & YPOOL_FLAG_HARDENED. Writes guard word (YPOOL_FLAG_CANARY).
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] sys_block System block which belongs to the pool
+*/
+
+static void ymark_allocated(ypool_STC *pool, AD_POINTER sys_block){
+    uint64_t canary;
+    size_t index;
+
+    if (pool->flags & YPOOL_FLAG_CANARY){
+        canary = ycanary_of(pool, sys_block);
+        memcpy(sys_block + yblock_header(pool) + pool->block_size, &canary, sizeof(canary)); /* may be unaligned */
+    }
+
+    if (pool->flags & YPOOL_FLAGS_BITMAP){
+        index = yblock_index(pool, sys_block);
+
+        if (pool->flags & YPOOL_FLAG_LOWFIRST)
+            ylow_set(pool, index); /* under the mutex */
+        else if (pool->flags & (YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_TCACHE))
+            __atomic_fetch_or(&pool->alloc_map[index / 64], 1ull << (index % 64), __ATOMIC_RELAXED);
+        else
+            pool->alloc_map[index / 64] |= 1ull << (index % 64); /* under the mutex */
+
+        if (pool->flags & YPOOL_FLAG_COMPACT)
+            return;
+    }
+
+    if (pool->flags & (YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_TCACHE))
+        __atomic_store_n((AD_POINTER*)sys_block, NULL, __ATOMIC_RELAXED);
+    else
+        ((yblock_STC*)sys_block)->next_block = NULL; /* under the mutex, may be unaligned */
+}
+
+/**
+    \brief Move system block from allocated to free state
+    \details
+        Only one of concurrent claims of the same block succeeds. Pools without
+        YPOOL_FLAG_LOCKFREE/YPOOL_FLAG_TCACHE claim blocks under the mutex only
+        (links of such pools may be unaligned). YPOOL_FLAG_HARDENED pool takes
+        allocation state from alloc_map only (header can be damaged by user).
+        Block with damaged guard word stays claimed & is never reused.
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] sys_block System block which belongs to the pool
+    \return
+        -EALREADY  - Block is free already
+        -EOVERFLOW - Guard word after block is overwritten (YPOOL_FLAG_CANARY)
+                 0 - Block claimed (caller must return it to a free list)
+*/
+
+static int yclaim_free(ypool_STC *pool, AD_POINTER sys_block){
+    AD_POINTER    expected_link = NULL;
+    uint64_t      bit;
+    uint64_t      canary;
+    size_t        index;
+
+    /* never used block (YPOOL_FLAG_LAZY) is free, its header is garbage (slabs of YPOOL_FLAG_GROWABLE are formatted) */
+    if (sys_block >= pool->start_PTR + __atomic_load_n(pool->bump_index_PTR, __ATOMIC_RELAXED) * yblock_stride(pool)
+        && (!(pool->flags & YPOOL_FLAG_GROWABLE) || sys_block < pool->start_PTR + pool->pool_size/pool->block_size * yblock_stride(pool)))
+        return -EALREADY;
+
+    if (pool->flags & YPOOL_FLAGS_BITMAP){
+        index = yblock_index(pool, sys_block);
+        bit = 1ull << (index % 64);
+
+        if (pool->flags & (YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_TCACHE)){
+            if ((__atomic_fetch_and(&pool->alloc_map[index / 64], ~bit, __ATOMIC_ACQUIRE) & bit) == 0)
+                return -EALREADY;
+        }else{
+            /* under the mutex */
+            if ((pool->alloc_map[index / 64] & bit) == 0)
+                return -EALREADY;
+
+            if (pool->flags & YPOOL_FLAG_LOWFIRST)
+                ylow_clear(pool, index);
+            else
+                pool->alloc_map[index / 64] &= ~bit;
+        }
+
+        /* keep free block header not NULL */
+        if (!(pool->flags & YPOOL_FLAG_COMPACT)){
+            if (pool->flags & (YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_TCACHE))
+                __atomic_store_n((AD_POINTER*)sys_block, YBLOCK_FREE_MARK, __ATOMIC_RELAXED);
+            else
+                ((yblock_STC*)sys_block)->next_block = YBLOCK_FREE_MARK;
+        }
+    }else if (!(pool->flags & (YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_TCACHE))){
+        if (((yblock_STC*)sys_block)->next_block != NULL)
+            return -EALREADY;
+
+        ((yblock_STC*)sys_block)->next_block = YBLOCK_FREE_MARK;
+    }else if (!__atomic_compare_exchange_n((AD_POINTER*)sys_block, &expected_link, YBLOCK_FREE_MARK, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+        return -EALREADY;
+    }
+
+    if (pool->flags & YPOOL_FLAG_CANARY){
+        memcpy(&canary, sys_block + yblock_header(pool) + pool->block_size, sizeof(canary));
+
+        if (canary != ycanary_of(pool, sys_block)){
+            /* cleared bit would hand the block out again (YPOOL_FLAG_LOWFIRST) */
+            if (pool->flags & YPOOL_FLAG_LOWFIRST)
+                ylow_set(pool, index);
+
+            return -EOVERFLOW;
+        }
+    }
+
+    if (pool->flags & YPOOL_FLAG_POISON)
+        memset(sys_block + yblock_header(pool), YPOOL_POISON_BYTE, pool->block_size);
+
+    /* before block is linked to a free list */
+    if (pool->dirty_map != NULL){
+        index = yblock_index(pool, sys_block);
+        __atomic_fetch_or(&pool->dirty_map[index / 64], 1ull << (index % 64), __ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
+
+/**
+    \brief Pop first free block from the lock-free (YPOOL_FLAG_LOCKFREE) free list
+
+    \details
+        Treiber stack pop. Block under the head can be popped & reused by other thread
+        while we read its link, but then the head tag is changed and CAS fails.
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[out] *sys_block Pointer to popped system block (marked as allocated)
+
+    \return
+        -ENOMEM - Pool has no free memory
+              0 - On success
+*/
+
+static int ylf_pop(ypool_STC *pool, AD_POINTER *sys_block){
+    uint64_t      head;
+    uint64_t      new_head;
+    uintptr_t     link;
+    AD_POINTER    block_PTR;
+    size_t        bump_index;
+
+    head = __atomic_load_n(pool->lf_head_PTR, __ATOMIC_ACQUIRE);
+
+    do
+    {
+        if ((head & YLF_INDEX_MASK) == 0){
+            /* take never used block (YPOOL_FLAG_LAZY) */
+            if (ybump(pool, 1, &bump_index) == 0)
+                return -ENOMEM; /* No memory in pool */
+
+            block_PTR = pool->start_PTR + bump_index * yblock_stride(pool);
+            break;
+        }
+
+        block_PTR = pool->start_PTR + ((head & YLF_INDEX_MASK) - 1) * yblock_stride(pool);
+        link = (uintptr_t)__atomic_load_n((AD_POINTER*)block_PTR, __ATOMIC_RELAXED);
+
+        new_head = (head & ~YLF_INDEX_MASK) + YLF_TAG_ONE;
+        if (link != (uintptr_t)YBLOCK_LIST_END)
+            new_head |= link & YLF_INDEX_MASK;
+    } while (!__atomic_compare_exchange_n(pool->lf_head_PTR, &head, new_head, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    /* mark block as allocated (set next_block = NULL) */
+    ymark_allocated(pool, block_PTR);
+
+    *sys_block = block_PTR;
+    return 0;
+}
+
+/**
+    \brief Splice private chain of system blocks (already linked from first to last) to the lock-free (YPOOL_FLAG_LOCKFREE) free list
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] first First system block of the chain (becomes the head)
+    \param[in] last Last system block of the chain
+*/
+
+static void ylf_splice(ypool_STC *pool, AD_POINTER first, AD_POINTER last){
+    uint64_t      head;
+    uint64_t      new_head;
+    uint64_t      first_index;
+
+    first_index = (first - pool->start_PTR) / yblock_stride(pool);
+
+    head = __atomic_load_n(pool->lf_head_PTR, __ATOMIC_RELAXED);
+
+    do
+    {
+        /* link last block to the current head */
+        if ((head & YLF_INDEX_MASK) == 0)
+            __atomic_store_n((AD_POINTER*)last, YBLOCK_LIST_END, __ATOMIC_RELAXED);
+        else
+            __atomic_store_n((AD_POINTER*)last, (AD_POINTER)(uintptr_t)(head & YLF_INDEX_MASK), __ATOMIC_RELAXED);
+
+        new_head = (head & ~YLF_INDEX_MASK) + YLF_TAG_ONE + first_index + 1;
+        /* seq_cst: ordered before following waiters check of ywake_waiters() */
+    } while (!__atomic_compare_exchange_n(pool->lf_head_PTR, &head, new_head, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+}
+
+/**
+    \brief Pop up to `count` blocks from the lock-free (YPOOL_FLAG_LOCKFREE) free list with single CAS
+
+    \details
+        Free list is changed at the head only, so while head tag is the same
+        the whole walked chain is the same too.
+
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] count Max blocks to pop
+    \param[out] sys_blocks Popped system blocks (links are not changed)
+
+    \return Number of popped blocks
+*/
+
+static size_t ylf_pop_chain(ypool_STC *pool, size_t count, AD_POINTER sys_blocks[]){
+    uint64_t      head;
+    uint64_t      new_head;
+    uint64_t      index;
+    uintptr_t     link;
+    size_t        popped;
+    size_t        blocks_in_pool;
+
+    blocks_in_pool = pool->pool_size/pool->block_size;
+
+    head = __atomic_load_n(pool->lf_head_PTR, __ATOMIC_ACQUIRE);
+
+    do
+    {
+        popped = 0;
+        index = head & YLF_INDEX_MASK;
+
+        /* links of a changed list can be garbage - keep walk inside the pool, CAS will fail anyway */
+        while (popped < count && index != 0 && index <= blocks_in_pool)
+        {
+            sys_blocks[popped] = pool->start_PTR + (index - 1) * yblock_stride(pool);
+            link = (uintptr_t)__atomic_load_n((AD_POINTER*)sys_blocks[popped], __ATOMIC_RELAXED);
+            index = (link == (uintptr_t)YBLOCK_LIST_END) ? 0 : (link & YLF_INDEX_MASK);
+            popped++;
+        }
+
+        if (popped == 0)
+            return 0;
+
+        new_head = (head & ~YLF_INDEX_MASK) + YLF_TAG_ONE + index;
+    } while (!__atomic_compare_exchange_n(pool->lf_head_PTR, &head, new_head, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    return popped;
+}
+
+/**
+    \brief Pop one block from the shared free list (mutex mode) or lock-free list & mark it allocated
+    \details Pool mutex must be held unless pool is YPOOL_FLAG_LOCKFREE
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[out] *sys_block Popped system block
+    \return
+        -ENOMEM - Pool has no free memory
+              0 - On success
+*/
+
+static int ypop_block(ypool_STC *pool, AD_POINTER *sys_block){
+    AD_POINTER    block_PTR;
+    AD_POINTER    next_free_block_PTR;
+    size_t        bump_index;
+
+    if (pool->flags & YPOOL_FLAG_LOCKFREE)
+        return ylf_pop(pool, sys_block);
+
+    /* lowest free block (YPOOL_FLAG_LOWFIRST) */
+    if (pool->flags & YPOOL_FLAG_LOWFIRST){
+        bump_index = ylow_find(pool);
+
+        if (bump_index == SIZE_MAX)
+            return -ENOMEM; /* No memory in pool */
+
+        block_PTR = pool->start_PTR + bump_index * yblock_stride(pool);
+        ymark_allocated(pool, block_PTR);
+        *sys_block = block_PTR;
+        return 0;
+    }
+
+    /* prevent end of pool */
+    if (pool->next_free_block_PTR == NULL)
+    {
+        /* take never used block (YPOOL_FLAG_LAZY) */
+        if (ybump(pool, 1, &bump_index) != 0){
+            block_PTR = pool->start_PTR + bump_index * yblock_stride(pool);
+            ymark_allocated(pool, block_PTR);
+            *sys_block = block_PTR;
+            return 0;
+        }
+
+        /* map new slab to the free list (YPOOL_FLAG_GROWABLE) */
+        if (!(pool->flags & YPOOL_FLAG_GROWABLE) || ygrow(pool) != 0)
+            return -ENOMEM; /* No memory in pool */
+    }
+
+    block_PTR = pool->next_free_block_PTR;
+
+    /* save pointer from allocating block (user can damage pointer in data, but we have a copy) */
+    next_free_block_PTR = ((yblock_STC*)block_PTR)->next_block;
+    if (next_free_block_PTR == YBLOCK_LIST_END)
+        next_free_block_PTR = NULL;
+
+    /* mark curr block as allocated (set next_block = NULL) */
+    ymark_allocated(pool, block_PTR);
+
+    /* move pointer to new block */
+    pool->next_free_block_PTR = next_free_block_PTR;
+
+    *sys_block = block_PTR;
+    return 0;
+}
+
+/**
+    \brief Lock pool mutex, count contended acquisitions & their wait time (STATS == 1)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+*/
+
+static void ylock(ypool_STC *pool){
+#if STATS == 1
+    ystats_shard_STC *shard;
+    struct timespec start, end;
+
+    if (pool->stats == NULL){
+        pthread_mutex_lock(&pool->mutex);
+        return;
+    }
+
+    /* uncontended lock is not timed */
+    if (pthread_mutex_trylock(&pool->mutex) == 0)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_lock(&pool->mutex);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    shard = ystats_shard(pool);
+    __atomic_fetch_add(&shard->mutex_waits, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shard->mutex_wait_ns, (end.tv_sec - start.tv_sec) * 1000000000ull + end.tv_nsec - start.tv_nsec, __ATOMIC_RELAXED);
+#else
+    pthread_mutex_lock(&pool->mutex);
+#endif
+}
+
+/**
+    \brief Get counter shard of the calling thread (threads get shards round robin on first use)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \return Counter shard
+*/
+
+static ystats_shard_STC *ystats_shard(ypool_STC *pool){
+    static uint32_t next_shard;
+    static __thread uint32_t shard = UINT32_MAX;
+
+    if (shard == UINT32_MAX)
+        shard = __atomic_fetch_add(&next_shard, 1, __ATOMIC_RELAXED) % YSTATS_SHARDS;
+
+    return &pool->stats[shard];
+}
+
+/**
+    \brief Count allocation result (STATS == 1)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] ret Allocation return code (0 - success)
+    \param[in] count Allocated blocks (or failed calls)
+*/
+
+static void ystats_alloc(ypool_STC *pool, int ret, size_t count){
+#if STATS == 1
+    ystats_shard_STC *shard;
+    int64_t used, peak;
+
+    if (pool == NULL || pool->stats == NULL)
+        return;
+
+    shard = ystats_shard(pool);
+
+    if (ret == -ENOMEM){
+        __atomic_fetch_add(&shard->enomem, count, __ATOMIC_RELAXED);
+        return;
+    }
+
+    if (ret != 0)
+        return;
+
+    __atomic_fetch_add(&shard->allocs, count, __ATOMIC_RELAXED);
+
+    /* pool-wide count: shard sums miss peaks made of several shards */
+    used = __atomic_add_fetch(&pool->stats_used, count, __ATOMIC_RELAXED);
+    peak = __atomic_load_n(&pool->stats_peak, __ATOMIC_RELAXED);
+
+    while (used > peak && !__atomic_compare_exchange_n(&pool->stats_peak, &peak, used, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+#endif
+}
+
+/**
+    \brief Count free result (STATS == 1)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] ret Free return code (0 - success)
+    \param[in] count Freed blocks (or failed blocks)
+*/
+
+static void ystats_free(ypool_STC *pool, int ret, size_t count){
+#if STATS == 1
+    ystats_shard_STC *shard;
+
+    if (pool == NULL || pool->stats == NULL || count == 0)
+        return;
+
+    shard = ystats_shard(pool);
+
+    if (ret == 0){
+        __atomic_fetch_add(&shard->frees, count, __ATOMIC_RELAXED);
+        __atomic_fetch_sub(&pool->stats_used, count, __ATOMIC_RELAXED);
+    }else if (ret == -EXDEV)
+        __atomic_fetch_add(&shard->exdev, count, __ATOMIC_RELAXED);
+    else if (ret == -EALREADY)
+        __atomic_fetch_add(&shard->ealready, count, __ATOMIC_RELAXED);
+    else if (ret == -EOVERFLOW)
+        __atomic_fetch_add(&shard->eoverflow, count, __ATOMIC_RELAXED);
+#endif
+}
+
+/**
+    \brief Take back -ENOMEM counted by the allocation of the calling thread (STATS == 1)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+*/
+
+static void ystats_uncount_enomem(ypool_STC *pool){
+#if STATS == 1
+    uint32_t i;
+
+    /* exhausted NUMA pool counted -ENOMEM in every node */
+    if ((pool->flags & YPOOL_FLAG_NUMA) && pool->numa_pools != NULL){
+        for (i = 0; i < pool->numa_nodes; i++)
+            ystats_uncount_enomem(&pool->numa_pools[i]);
+        return;
+    }
+
+    if (pool->stats != NULL)
+        __atomic_fetch_sub(&ystats_shard(pool)->enomem, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+/**
+    \brief
+        Create sub-pool per NUMA node for YPOOL_FLAG_NUMA pool
+
+    \details
+        Blocks are split evenly between nodes. Every sub-pool gets pool flags
+        without YPOOL_FLAG_NUMA & its mmap arena is bound to the node before it
+        is touched by pre-faulting or yformat(). Single node (or no NUMA support
+        in the kernel) gives one sub-pool with plain mmap arena.
+
+    \param[in/out] pool Pointer to the pool to which the operation will be applied
+    \param[in] blocks_in_pool Blocks in logical pool
+
+    \return
+        Same as ypool_init() of sub-pool
+*/
+
+static int ynuma_init(ypool_STC *pool, size_t blocks_in_pool){
+    ypool_STC *node_pool;
+    uint32_t nodes, node, i;
+    int ret;
+
+    nodes = ynuma_nodes();
+
+    /* every sub-pool has a block at least */
+    if (blocks_in_pool != 0 && nodes > blocks_in_pool)
+        nodes = blocks_in_pool;
+
+    pool->numa_pools = calloc(nodes, sizeof(ypool_STC));
+
+    if (pool->numa_pools == NULL)
+        return -ENOMEM;
+
+    pool->backing = YPOOL_BACKING_MMAP | YPOOL_BACKING_HUGETLB | YPOOL_BACKING_THP | YPOOL_BACKING_POPULATED | YPOOL_BACKING_LOCKED | YPOOL_BACKING_NUMA;
+
+    for (node = 0; node < nodes; node++)
+    {
+        node_pool = &pool->numa_pools[node];
+        node_pool->block_size = pool->block_size;
+        node_pool->pool_size = (blocks_in_pool / nodes + (node < blocks_in_pool % nodes)) * pool->block_size;
+        node_pool->flags = (pool->flags & ~(YPOOL_FLAG_NUMA | YPOOL_FLAG_TRACE | YPOOL_FLAG_EPOCH)) | YPOOL_FLAG_MMAP | YPOOL_FLAG_NUMA_NODE;
+        node_pool->numa_node = node;
+
+        ret = ypool_init(node_pool);
+
+        if (ret != 0){
+            for (i = 0; i < node; i++)
+                ypool_close(&pool->numa_pools[i]);
+
+            free(pool->numa_pools);
+            pool->numa_pools = NULL;
+            pool->backing = 0;
+            return ret;
+        }
+
+        /* backing every node got */
+        pool->backing &= node_pool->backing;
+    }
+
+    /* address lookup gives the logical pool (entries exist, so it doesn't fail) */
+    for (node = 0; node < nodes; node++)
+        ymap_set(pool->numa_pools[node].start_PTR, pool->numa_pools[node].pool_size / pool->block_size * yblock_stride(&pool->numa_pools[node]), pool);
+
+    pthread_mutex_init(&pool->mutex, NULL);
+
+    pool->numa_nodes = nodes;
+    pool->total_blocks = blocks_in_pool;
+    pool->start_PTR = pool->numa_pools[0].start_PTR; /* marks pool as initialized */
+
+    return 0;
+}
+
+/**
+    \brief Get count of NUMA nodes (highest online node id + 1)
+    \return Nodes count, 1 if system has no NUMA information
+*/
+
+static uint32_t ynuma_nodes(void){
+    FILE *file;
+    unsigned int node;
+    uint32_t nodes = 1;
+
+    file = fopen("/sys/devices/system/node/online", "r");
+
+    if (file == NULL)
+        return 1;
+
+    /* ranges list, e.g. "0-1,3" */
+    while (fscanf(file, "%u", &node) == 1){
+        if (node >= nodes)
+            nodes = node + 1;
+
+        if (fgetc(file) == EOF)
+            break;
+    }
+
+    fclose(file);
+
+    return (nodes < YNUMA_MAX_NODES) ? nodes : YNUMA_MAX_NODES;
+}
+
+/**
+    \brief Get sub-pool index of the calling thread's node
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \return Index in pool->numa_pools
+*/
+
+static uint32_t ynuma_current(ypool_STC *pool){
+    unsigned int cpu, node;
+
+    if (pool->numa_nodes == 1 || getcpu(&cpu, &node) != 0)
+        return 0;
+
+    return node % pool->numa_nodes;
+}
+
+/**
+    \brief Bind memory range to NUMA node (must be called before first touch)
+    \param[in] arena Page aligned mapping
+    \param[in] size Mapping size
+    \param[in] node Node id
+    \return 0 on success, -errno of mbind
+*/
+
+static int ynuma_bind(AD_POINTER arena, size_t size, uint32_t node){
+    unsigned long mask = 1ul << node;
+
+    /* raw syscall: no libnuma dependency */
+    if (syscall(SYS_mbind, arena, size, YMPOL_BIND, &mask, sizeof(mask) * CHAR_BIT + 1, 0) != 0)
+        return -errno;
+
+    return 0;
+}
+
+/**
+    \brief Find sub-pool whose arena holds the block
+    \param[in] pool Pointer to YPOOL_FLAG_NUMA pool
+    \param[in] user_block Block to look up
+    \return Sub-pool or NULL if block is out of all arenas
+*/
+
+static ypool_STC *ynuma_owner(ypool_STC *pool, AD_POINTER user_block){
+    ypool_STC *node_pool;
+    uint32_t node;
+
+    if (pool->numa_pools == NULL)
+        return NULL;
+
+    for (node = 0; node < pool->numa_nodes; node++)
+    {
+        node_pool = &pool->numa_pools[node];
+
+        if (user_block >= node_pool->start_PTR && user_block < node_pool->start_PTR + node_pool->arena_size)
+            return node_pool;
+    }
+
+    return NULL;
+}
+
+/**
+    \brief
+        Allocate blocks from caller's node sub-pool, then from other nodes
+
+    \details
+        -ENOMEM of exhausted node is counted in its statistics, blocks come from
+        the next node ids (no node distance table).
+
+    \param[in] pool Pointer to YPOOL_FLAG_NUMA pool
+    \param[in] count Blocks to allocate (1 - single block fast path)
+    \param[out] user_blocks Allocated blocks
+
+    \return
+        Same as yalloc_blocks()
+*/
+
+static int ynuma_alloc(ypool_STC *pool, size_t count, AD_POINTER user_blocks[]){
+    ypool_STC *node_pool;
+    uint32_t node, i;
+    size_t allocated = 0;
+    int ret;
+
+    if (pool->numa_pools == NULL)
+        return -EINVAL;
+
+    if (count > INT_MAX)
+        return -EINVAL;
+
+    if (count == 0)
+        return 0;
+
+    node = ynuma_current(pool);
+
+    for (i = 0; i < pool->numa_nodes && allocated < count; i++)
+    {
+        node_pool = &pool->numa_pools[(node + i) % pool->numa_nodes];
+
+        if (count == 1)
+            ret = (yalloc_block(node_pool, &user_blocks[0]) == 0) ? 1 : 0;
+        else
+            ret = yalloc_blocks(node_pool, count - allocated, user_blocks + allocated);
+
+        if (ret > 0)
+            allocated += ret;
+    }
+
+    return (allocated != 0) ? (int)allocated : -ENOMEM;
+}
+
+/**
+    \brief
+        Return blocks to sub-pools of their nodes
+
+    \details
+        Ownership of the whole batch is validated first, then every run of
+        neighbour blocks from the same node is freed by one yfree_blocks() call.
+
+    \param[in] pool Pointer to YPOOL_FLAG_NUMA pool
+    \param[in] count Number of blocks in user_blocks
+    \param[in] user_blocks Blocks which needed to free
+
+    \return
+        Same as yfree_blocks()
+*/
+
+static int ynuma_free_blocks(ypool_STC *pool, size_t count, AD_POINTER user_blocks[]){
+    ypool_STC *node_pool;
+    size_t freed = 0;
+    size_t first, i;
+    int ret;
+
+    if (pool->numa_pools == NULL || count > INT_MAX)
+        return -EINVAL;
+
+    for (i = 0; i < count; i++)
+    {
+        if (ynuma_owner(pool, user_blocks[i]) == NULL)
+            return -EXDEV;
+    }
+
+    for (first = 0; first < count; first = i)
+    {
+        node_pool = ynuma_owner(pool, user_blocks[first]);
+
+        for (i = first + 1; i < count && ynuma_owner(pool, user_blocks[i]) == node_pool; i++)
+            ;
+
+        ret = yfree_blocks(node_pool, i - first, user_blocks + first);
+
+        if (ret > 0)
+            freed += ret;
+    }
+
+    return (int)freed;
+}
+
+/**
+    \brief Get used blocks by statistics (allocs - frees over shards)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \return Used blocks, 0 without statistics
+*/
+
+static uint64_t ystats_used(ypool_STC *pool){
+    uint64_t allocs = 0, frees = 0;
+    size_t i;
+
+    if (pool->stats == NULL)
+        return 0;
+
+    for (i = 0; i < YSTATS_SHARDS; i++)
+    {
+        frees += __atomic_load_n(&pool->stats[i].frees, __ATOMIC_RELAXED);
+        allocs += __atomic_load_n(&pool->stats[i].allocs, __ATOMIC_RELAXED);
+    }
+
+    return (allocs > frees) ? allocs - frees : 0;
+}
+
+/**
+    \brief Count blocks dropped by ypool_reset()/ypool_release() as freed
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] used Dropped blocks
+*/
+
+static void ystats_drop(ypool_STC *pool, uint64_t used){
+#if STATS == 1
+    if (pool->stats == NULL || used == 0)
+        return;
+
+    __atomic_fetch_add(&ystats_shard(pool)->frees, used, __ATOMIC_RELAXED);
+#endif
+}
+
+/**
+    \brief Drop free list & move bump cursor back (blocks from bump_index are never used again)
+    \details Pool mutex must be held
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] bump_index New bump cursor
+*/
+
+static void yrewind(ypool_STC *pool, size_t bump_index){
+    uint64_t head;
+
+    if (pool->flags & YPOOL_FLAG_LOCKFREE){
+        /* new tag: pops which read old head fail their CAS */
+        head = __atomic_load_n(pool->lf_head_PTR, __ATOMIC_RELAXED);
+        __atomic_store_n(pool->lf_head_PTR, (head & ~YLF_INDEX_MASK) + YLF_TAG_ONE, __ATOMIC_RELEASE);
+    }else{
+        pool->next_free_block_PTR = NULL;
+    }
+
+    __atomic_store_n(pool->bump_index_PTR, bump_index, __ATOMIC_RELEASE);
+
+    /* thread caches hold blocks of previous epoch */
+    __atomic_add_fetch(&pool->epoch, 1, __ATOMIC_RELEASE);
+}
+
+/**
+    \brief Get whole pages inside run of blocks
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] page Page size (power of 2)
+    \param[in/out] first First block of the run, first block touching the pages on return
+    \param[in/out] end Block after the run, block after the last one touching the pages on return
+    \param[out] from First page
+    \param[out] to End of the last page
+    \return true if the run holds at least one whole page
+*/
+
+static bool ytrim_pages(ypool_STC *pool, size_t page, size_t *first, size_t *end, AD_POINTER *from, AD_POINTER *to){
+    uintptr_t start = (uintptr_t)pool->start_PTR;
+    uintptr_t arena_end = start + pool->pool_size/pool->block_size * yblock_stride(pool);
+    uintptr_t lo = (start + *first * yblock_stride(pool) + page - 1) & ~(uintptr_t)(page - 1);
+    uintptr_t hi = start + *end * yblock_stride(pool);
+
+    /* pages never reach past the arena */
+    hi = ((hi < arena_end) ? hi : arena_end) & ~(uintptr_t)(page - 1);
+
+    if (hi <= lo)
+        return false;
+
+    *first = (lo - start) / yblock_stride(pool);
+    *end = (hi - start + yblock_stride(pool) - 1) / yblock_stride(pool);
+    *from = (AD_POINTER)lo;
+    *to = (AD_POINTER)hi;
+
+    return true;
+}
+
+/**
+    \brief Release pages of free block runs of YPOOL_FLAG_LOWFIRST pool
+    \details
+        Runs are searched under the mutex by YPOOL_SCAN_WORDS bitmap words.
+        Blocks of a found run are marked allocated, so madvise() runs without
+        lock & concurrent allocations take other blocks.
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] page Page size
+    \param[out] released Released bytes
+    \return 0 or -errno of madvise()
+*/
+
+static int ytrim_runs(ypool_STC *pool, size_t page, size_t *released){
+    size_t        blocks_in_pool = pool->pool_size/pool->block_size;
+    size_t        index = 0;
+    size_t        limit;
+    size_t        first;
+    size_t        end;
+    size_t        i;
+    uint64_t      word;
+    AD_POINTER    from;
+    AD_POINTER    to;
+    bool          found;
+    int           ret = 0;
+
+    while (index < blocks_in_pool && ret == 0)
+    {
+        limit = (index + 64 * YPOOL_SCAN_WORDS < blocks_in_pool) ? index + 64 * YPOOL_SCAN_WORDS : blocks_in_pool;
+        found = false;
+
+        ylock(pool);
+
+        while (!found && index < limit)
+        {
+            /* next free block */
+            word = ~pool->alloc_map[index / 64] & (UINT64_MAX << (index % 64));
+
+            if (word == 0){
+                index = (index / 64 + 1) * 64;
+                continue;
+            }
+
+            first = index / 64 * 64 + __builtin_ctzll(word);
+
+            if (first >= limit){
+                index = limit;
+                break;
+            }
+
+            /* next allocated block or the pool end (there are no padding bits if blocks_in_pool % 64 == 0) */
+            end = first;
+            while (end < blocks_in_pool && (word = pool->alloc_map[end / 64] & (UINT64_MAX << (end % 64))) == 0)
+                end = (end / 64 + 1) * 64;
+            end = (end < blocks_in_pool) ? end / 64 * 64 + __builtin_ctzll(word) : blocks_in_pool;
+
+            index = end;
+            found = ytrim_pages(pool, page, &first, &end, &from, &to);
+        }
+
+        /* reserve run */
+        for (i = first; found && i < end; i++)
+            ylow_set(pool, i);
+
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (!found)
+            continue;
+
+        if (madvise(from, to - from, YPOOL_TRIM_ADVICE) == 0){
+            *released += to - from;
+            ydirty_trimmed(pool, from, to);
+        }else{
+            ret = -errno;
+        }
+
+        ylock(pool);
+
+        for (i = first; i < end; i++)
+            ylow_clear(pool, i);
+
+        /* run was hidden from parked yalloc_block_wait() callers */
+        ywaiters_feed(pool);
+
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return ret;
+}
+
+/**
+    \brief Move bump cursor back over free blocks at the top of the used part of the arena
+    \details
+        Free list links live in free blocks, so only pages behind the bump cursor
+        can be released. Free blocks right below the cursor are unlinked & become
+        never used blocks again, ytrim_bump() releases their pages then. Free
+        blocks below an allocated one & blocks of slabs (YPOOL_FLAG_GROWABLE)
+        stay linked. Thread cache of the caller is flushed before, caches of
+        other threads keep their blocks. Runs under the mutex, cost is
+        O(free blocks).
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \return 0 or -ENOMEM (there is no memory for the scan bitmap)
+*/
+
+static int ytrim_tail(ypool_STC *pool){
+    ytcache_STC * cache;
+    AD_POINTER    block;
+    AD_POINTER    next;
+    AD_POINTER    tail_PTR;
+    AD_POINTER    bump_PTR;
+    AD_POINTER    prev;
+    uint64_t    * map;
+    size_t        bump;
+    size_t        tail;
+    size_t        index;
+
+    if ((pool->flags & YPOOL_FLAG_TCACHE) && (cache = pthread_getspecific(pool->tcache_key)) != NULL
+        && cache->epoch == __atomic_load_n(&pool->epoch, __ATOMIC_ACQUIRE)){
+        ypush_chain(pool, cache->count, cache->blocks);
+        cache->count = 0;
+    }
+
+    ylock(pool);
+
+    bump = *pool->bump_index_PTR;
+
+    if (pool->next_free_block_PTR == NULL || bump == 0){
+        pthread_mutex_unlock(&pool->mutex);
+        return 0;
+    }
+
+    map = calloc((bump + 63) / 64, sizeof(uint64_t));
+
+    if (map == NULL){
+        pthread_mutex_unlock(&pool->mutex);
+        return -ENOMEM;
+    }
+
+    bump_PTR = pool->start_PTR + bump * yblock_stride(pool);
+
+    /* free blocks of the used part */
+    for (block = pool->next_free_block_PTR; block != YBLOCK_LIST_END; block = ((yblock_STC*)block)->next_block)
+    {
+        if (block >= pool->start_PTR && block < bump_PTR){
+            index = yblock_index(pool, block);
+            map[index / 64] |= 1ull << (index % 64);
+        }
+    }
+
+    for (tail = bump; tail > 0 && (map[(tail - 1) / 64] & (1ull << ((tail - 1) % 64))); tail--)
+        ;
+
+    free(map);
+
+    if (tail == bump){
+        pthread_mutex_unlock(&pool->mutex);
+        return 0;
+    }
+
+    tail_PTR = pool->start_PTR + tail * yblock_stride(pool);
+
+    /* unlink free tail, the rest keeps its order */
+    prev = NULL;
+    for (block = pool->next_free_block_PTR; block != YBLOCK_LIST_END; block = next)
+    {
+        next = ((yblock_STC*)block)->next_block;
+
+        if (block >= tail_PTR && block < bump_PTR)
+            continue;
+
+        if (prev == NULL)
+            pool->next_free_block_PTR = block;
+        else
+            ((yblock_STC*)prev)->next_block = block;
+        prev = block;
+    }
+
+    if (prev == NULL)
+        pool->next_free_block_PTR = NULL;
+    else
+        ((yblock_STC*)prev)->next_block = YBLOCK_LIST_END;
+
+    __atomic_store_n(pool->bump_index_PTR, tail, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (DEBUG) printf("ytrim_tail bump %zu -> %zu\n", bump, tail);
+    return 0;
+}
+
+/**
+    \brief Release pages of never used blocks (from the bump cursor to the arena end)
+    \details Bump cursor of mutex mode pool doesn't move while the mutex is held, pages are released by YPOOL_TRIM_PAGES under it
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] page Page size
+    \param[out] released Released bytes
+    \return 0 or -errno of madvise()
+*/
+
+static int ytrim_bump(ypool_STC *pool, size_t page, size_t *released){
+    uintptr_t     end;
+    uintptr_t     from;
+    uintptr_t     to;
+    uintptr_t     cursor = 0;
+    int           ret = 0;
+
+    end = ((uintptr_t)pool->start_PTR + pool->pool_size/pool->block_size * yblock_stride(pool)) & ~(uintptr_t)(page - 1);
+
+    while (ret == 0)
+    {
+        ylock(pool);
+
+        from = ((uintptr_t)pool->start_PTR + *pool->bump_index_PTR * yblock_stride(pool) + page - 1) & ~(uintptr_t)(page - 1);
+
+        if (from < cursor)
+            from = cursor;
+
+        if (from >= end){
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+
+        to = (end - from > page * YPOOL_TRIM_PAGES) ? from + page * YPOOL_TRIM_PAGES : end;
+
+        if (madvise((AD_POINTER)from, to - from, YPOOL_TRIM_ADVICE) == 0){
+            *released += to - from;
+            ydirty_trimmed(pool, (AD_POINTER)from, (AD_POINTER)to);
+        }else{
+            ret = -errno;
+        }
+
+        pthread_mutex_unlock(&pool->mutex);
+
+        cursor = to;
+    }
+
+    return ret;
+}
+
+/**
+    \brief Count freed blocks & trim pool after pool->trim_threshold freed bytes
+    \details
+        Called without pool mutex. Trim is a pass over the pool, so free starts
+        it once per YPOOL_TRIM_INTERVAL_MS at most: the first free over the
+        threshold after the interval wins, pending bytes of the frees in
+        between wait for it.
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] freed Blocks freed by the caller
+*/
+
+static void ytrim_auto(ypool_STC *pool, size_t freed){
+    struct timespec now;
+    uint64_t        now_ns;
+    uint64_t        next;
+
+    if (pool->trim_threshold == 0 || freed == 0)
+        return;
+
+    if (__atomic_add_fetch(&pool->trim_pending, freed * yblock_stride(pool), __ATOMIC_RELAXED) < pool->trim_threshold)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    now_ns = now.tv_sec * 1000000000ull + now.tv_nsec;
+    next = __atomic_load_n(&pool->trim_next, __ATOMIC_RELAXED);
+
+    if (now_ns < next || !__atomic_compare_exchange_n(&pool->trim_next, &next, now_ns + YPOOL_TRIM_INTERVAL_MS * 1000000ull, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return;
+
+    __atomic_store_n(&pool->trim_pending, 0, __ATOMIC_RELAXED);
+    ypool_trim(pool, NULL);
+}
+
+/**
+    \brief Set or clear dirty bits of blocks [first, end) (YPOOL_FLAG_ZEROTRACK)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] first First block index
+    \param[in] end Index after the last block
+    \param[in] dirty true - payload may be not zero, false - payload is zero
+*/
+
+static void ydirty_mark(ypool_STC *pool, size_t first, size_t end, bool dirty){
+    uint64_t mask;
+    size_t word;
+
+    for (word = first / 64; word * 64 < end; word++)
+    {
+        mask = UINT64_MAX;
+
+        if (word == first / 64)
+            mask &= UINT64_MAX << (first % 64);
+
+        if (end - word * 64 < 64)
+            mask &= ~(UINT64_MAX << (end % 64));
+
+        if (dirty)
+            __atomic_fetch_or(&pool->dirty_map[word], mask, __ATOMIC_RELAXED);
+        else
+            __atomic_fetch_and(&pool->dirty_map[word], ~mask, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+    \brief Mark blocks [first, end) dropped by ypool_reset()/ypool_release() as dirty
+    \details
+        Pool mutex must be held. Freed blocks are dirty already, so bitmap
+        pools add allocated blocks only (bitmap bits above the bump cursor may
+        be stale, which makes extra blocks dirty only). Header pools mark the
+        whole range.
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] first First dropped block index
+    \param[in] end Index after the last dropped block (bump cursor)
+*/
+
+static void ydirty_drop(ypool_STC *pool, size_t first, size_t end){
+    uint64_t mask;
+    size_t word;
+
+    if (!(pool->flags & YPOOL_FLAGS_BITMAP)){
+        ydirty_mark(pool, first, end, true);
+        return;
+    }
+
+    for (word = first / 64; word * 64 < end; word++)
+    {
+        mask = pool->alloc_map[word];
+
+        if (word == first / 64)
+            mask &= UINT64_MAX << (first % 64);
+
+        if (end - word * 64 < 64)
+            mask &= ~(UINT64_MAX << (end % 64));
+
+        __atomic_fetch_or(&pool->dirty_map[word], mask, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+    \brief Mark blocks inside pages released by ypool_trim() as zero
+    \details Blocks are not used by others (under the mutex or reserved), pages are zero filled on next touch with MADV_DONTNEED only
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] from First released page
+    \param[in] to End of the last released page
+*/
+
+static void ydirty_trimmed(ypool_STC *pool, AD_POINTER from, AD_POINTER to){
+    size_t first;
+    size_t end;
+
+    if (pool->dirty_map == NULL || YPOOL_TRIM_ADVICE != MADV_DONTNEED)
+        return;
+
+    /* whole blocks only */
+    first = (from - pool->start_PTR + yblock_stride(pool) - 1) / yblock_stride(pool);
+    end = (to - pool->start_PTR) / yblock_stride(pool);
+
+    if (end > pool->pool_size/pool->block_size)
+        end = pool->pool_size/pool->block_size;
+
+    if (first < end)
+        ydirty_mark(pool, first, end, false);
+}
+
+/**
+    \brief Fill block with zeros
+    \details Blocks of YPOOL_ZERO_NT_SIZE & bigger are written with non-temporal stores (SSE2), so clearing doesn't evict cache
+    \param[in] block User block
+    \param[in] size Block size
+*/
+
+static void yzero(AD_POINTER block, size_t size){
+#ifdef __SSE2__
+    AD_POINTER aligned;
+    AD_POINTER end;
+
+    if (size >= YPOOL_ZERO_NT_SIZE){
+        aligned = (AD_POINTER)(((uintptr_t)block + 15) & ~(uintptr_t)15);
+        end = (AD_POINTER)(((uintptr_t)block + size) & ~(uintptr_t)15);
+
+        memset(block, 0, aligned - block);
+
+        for (; aligned < end; aligned += 16)
+            _mm_stream_si128((__m128i*)aligned, _mm_setzero_si128());
+
+        memset(end, 0, block + size - end);
+
+        /* streaming stores are weakly ordered */
+        _mm_sfence();
+        return;
+    }
+#endif
+
+    memset(block, 0, size);
+}
+
+/**
+    \brief Collect allocated blocks of one scan chunk
+    \details
+        Scan stops at the bump cursor (bitmap bits of blocks dropped by
+        ypool_reset()/ypool_release() are stale there), after count blocks or
+        after one chunk. Mutex mode pool is locked for the chunk.
+    \param[in] pool Pointer to the pool (not YPOOL_FLAG_NUMA, not YPOOL_FLAG_GROWABLE)
+    \param[in/out] index Next block index to scan
+    \param[in] count Capacity of user_blocks
+    \param[out] user_blocks Allocated user blocks
+    \return Number of blocks put to user_blocks
+*/
+
+static size_t yscan(ypool_STC *pool, size_t *index, size_t count, AD_POINTER user_blocks[]){
+    bool          locked = !(pool->flags & (YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_TCACHE));
+    size_t        found = 0;
+    size_t        end;
+    size_t        limit;
+    size_t        i = *index;
+    size_t        bit;
+    uint64_t      word;
+    AD_POINTER    block_PTR;
+    AD_POINTER    link;
+
+    if (locked)
+        ylock(pool);
+
+    end = __atomic_load_n(pool->bump_index_PTR, __ATOMIC_ACQUIRE);
+
+    if (pool->flags & YPOOL_FLAGS_BITMAP){
+        limit = (i / 64 + YPOOL_SCAN_WORDS) * 64;
+
+        if (limit > end)
+            limit = end;
+
+        while (i < limit && found < count)
+        {
+            if (locked)
+                word = pool->alloc_map[i / 64];
+            else
+                word = __atomic_load_n(&pool->alloc_map[i / 64], __ATOMIC_ACQUIRE);
+
+            word &= UINT64_MAX << (i % 64); /* blocks before i are scanned */
+
+            if (limit - i / 64 * 64 < 64)
+                word &= (1ull << (limit % 64)) - 1; /* blocks from limit */
+
+            while (word != 0 && found < count)
+            {
+                bit = __builtin_ctzll(word);
+                word &= word - 1;
+                i = i / 64 * 64 + bit;
+                user_blocks[found++] = pool->start_PTR + i * yblock_stride(pool) + yblock_header(pool);
+            }
+
+            /* rest of the word is empty or the batch is full */
+            i = (found < count) ? (i / 64 + 1) * 64 : i + 1;
+        }
+    }else{
+        limit = i + 64 * YPOOL_SCAN_WORDS;
+
+        if (limit > end)
+            limit = end;
+
+        block_PTR = pool->start_PTR + i * yblock_stride(pool);
+
+        for (; i < limit && found < count; i++, block_PTR += yblock_stride(pool))
+        {
+            /* NULL link marks allocated block */
+            if (locked)
+                memcpy(&link, block_PTR, sizeof(link)); /* may be unaligned */
+            else
+                link = __atomic_load_n((AD_POINTER*)block_PTR, __ATOMIC_ACQUIRE);
+
+            if (link == NULL)
+                user_blocks[found++] = block_PTR + yblock_header(pool);
+        }
+    }
+
+    if (locked)
+        pthread_mutex_unlock(&pool->mutex);
+
+    *index = (i < end) ? i : end;
+
+    return found;
+}
+
+/**
+    \brief Allocate summary levels of YPOOL_FLAG_LOWFIRST bitmap & format them
+    \details Levels are added until the top one is a single word
+    \param[in/out] pool Pointer to the pool with allocated alloc_map
+    \param[in] blocks_in_pool Blocks in the arena
+    \return
+        -EINVAL - Pool has more blocks than YPOOL_LOW_LEVELS levels cover
+        -ENOMEM - There are no free memory for summary levels
+              0 - On success
+*/
+
+static int ylow_init(ypool_STC *pool, size_t blocks_in_pool){
+    size_t words[YPOOL_LOW_LEVELS];
+    size_t total = 0;
+    size_t child = (blocks_in_pool + 63) / 64;
+    uint32_t level;
+
+    for (pool->full_levels = 0; child > 1; pool->full_levels++)
+    {
+        if (pool->full_levels == YPOOL_LOW_LEVELS)
+            return -EINVAL;
+
+        child = (child + 63) / 64;
+        words[pool->full_levels] = child;
+        total += child;
+    }
+
+    memset(pool->full_map, 0, sizeof(pool->full_map));
+
+    if (total != 0){
+        pool->full_map[0] = calloc(total, sizeof(uint64_t));
+
+        if (pool->full_map[0] == NULL)
+            return -ENOMEM;
+
+        for (level = 1; level < pool->full_levels; level++)
+            pool->full_map[level] = pool->full_map[level - 1] + words[level - 1];
+    }
+
+    ylow_format(pool);
+
+    return 0;
+}
+
+/**
+    \brief Mark all blocks of YPOOL_FLAG_LOWFIRST pool as free
+    \details
+        Bits past the end of every level are set (full), so the search never
+        leaves the pool & a full top word means the pool is exhausted.
+        Pool mutex must be held.
+    \param[in] pool Pointer to the pool to which the operation will be applied
+*/
+
+static void ylow_format(ypool_STC *pool){
+    uint64_t *map = pool->alloc_map;
+    size_t bits = pool->pool_size/pool->block_size;
+    size_t words;
+    uint32_t level;
+
+    for (level = 0; ; level++)
+    {
+        words = (bits + 63) / 64;
+        memset(map, 0, words * sizeof(uint64_t));
+
+        if (bits % 64 != 0)
+            map[words - 1] = UINT64_MAX << (bits % 64);
+
+        if (level == pool->full_levels)
+            break;
+
+        map = pool->full_map[level];
+        bits = words;
+    }
+}
+
+/**
+    \brief Find the lowest free block of YPOOL_FLAG_LOWFIRST pool
+    \details Descends from the top summary word to alloc_map taking the lowest not full word. Pool mutex must be held.
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \return Block index or SIZE_MAX if the pool is exhausted
+*/
+
+static size_t ylow_find(ypool_STC *pool){
+    size_t index = 0;
+    uint32_t level;
+    uint64_t top;
+
+    top = (pool->full_levels != 0) ? pool->full_map[pool->full_levels - 1][0] : pool->alloc_map[0];
+
+    if (top == UINT64_MAX)
+        return SIZE_MAX;
+
+    for (level = pool->full_levels; level > 0; level--)
+        index = index * 64 + __builtin_ctzll(~pool->full_map[level - 1][index]);
+
+    return index * 64 + __builtin_ctzll(~pool->alloc_map[index]);
+}
+
+/**
+    \brief Set allocation bit of YPOOL_FLAG_LOWFIRST pool block, word which gets full sets its summary bit
+    \details Pool mutex must be held
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] index Block index
+*/
+
+static void ylow_set(ypool_STC *pool, size_t index){
+    uint64_t *word = &pool->alloc_map[index / 64];
+    uint32_t level;
+
+    *word |= 1ull << (index % 64);
+
+    for (level = 0; *word == UINT64_MAX && level < pool->full_levels; level++)
+    {
+        index /= 64;
+        word = &pool->full_map[level][index / 64];
+        *word |= 1ull << (index % 64);
+    }
+}
+
+/**
+    \brief Clear allocation bit of YPOOL_FLAG_LOWFIRST pool block, word which was full clears its summary bit
+    \details Pool mutex must be held
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] index Block index
+*/
+
+static void ylow_clear(ypool_STC *pool, size_t index){
+    uint64_t *word = &pool->alloc_map[index / 64];
+    uint64_t old = *word;
+    uint32_t level;
+
+    *word = old & ~(1ull << (index % 64));
+
+    for (level = 0; old == UINT64_MAX && level < pool->full_levels; level++)
+    {
+        index /= 64;
+        word = &pool->full_map[level][index / 64];
+        old = *word;
+        *word = old & ~(1ull << (index % 64));
+    }
+}
+
+/**
+    \brief Hand free blocks over to parked yalloc_block_wait() callers in FIFO order
+    \details Pool mutex must be held
+    \param[in] pool Pointer to the pool to which the operation will be applied
+*/
+
+static void ywaiters_feed(ypool_STC *pool){
+    AD_POINTER sys_block;
+
+    while (pool->wait_head != NULL && ypop_block(pool, &sys_block) == 0)
+        ywaiter_wake(pool, sys_block + yblock_header(pool));
+}
+
+/**
+    \brief Feed parked yalloc_block_wait() callers after block was returned outside the mutex (costs one load if nobody waits)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+*/
+
+static void ywake_waiters(ypool_STC *pool){
+    if (__atomic_load_n(&pool->waiters, __ATOMIC_SEQ_CST) == 0)
+        return;
+
+    ylock(pool);
+    ywaiters_feed(pool);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/**
+    \brief Give allocated block to the first parked yalloc_block_wait() caller & wake it
+    \details Pool mutex must be held, wait queue must not be empty
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] user_block Allocated user block
+*/
+
+static void ywaiter_wake(ypool_STC *pool, AD_POINTER user_block){
+    ywaiter_STC *waiter = pool->wait_head;
+
+    pool->wait_head = waiter->next;
+    if (pool->wait_head == NULL)
+        pool->wait_tail = NULL;
+
+    waiter->block = user_block;
+    pthread_cond_signal(&waiter->cond);
+}
+
+/**
+    \brief Pop up to `count` blocks from the shared free list under single lock (or single CAS)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] count Max blocks to pop
+    \param[out] sys_blocks Popped system blocks (links are not changed)
+    \return Number of popped blocks
+*/
+
+static size_t ypop_chain(ypool_STC *pool, size_t count, AD_POINTER sys_blocks[]){
+    size_t popped = 0;
+    size_t index;
+
+    if (pool->flags & YPOOL_FLAG_LOCKFREE){
+        popped = ylf_pop_chain(pool, count, sys_blocks);
+        return popped + ybump_chain(pool, count - popped, sys_blocks + popped);
+    }
+
+    ylock(pool);
+    for (;;)
+    {
+        /* lowest free blocks, bits are set before the lock is dropped (YPOOL_FLAG_LOWFIRST) */
+        while ((pool->flags & YPOOL_FLAG_LOWFIRST) && popped < count && (index = ylow_find(pool)) != SIZE_MAX)
+        {
+            ylow_set(pool, index);
+            sys_blocks[popped++] = pool->start_PTR + index * yblock_stride(pool);
+        }
+
+        while (popped < count && pool->next_free_block_PTR != NULL)
+        {
+            sys_blocks[popped] = pool->next_free_block_PTR;
+            pool->next_free_block_PTR = ((yblock_STC*)sys_blocks[popped])->next_block;
+            if (pool->next_free_block_PTR == YBLOCK_LIST_END)
+                pool->next_free_block_PTR = NULL;
+            popped++;
+        }
+
+        /* top up with never used blocks (YPOOL_FLAG_LAZY) */
+        popped += ybump_chain(pool, count - popped, sys_blocks + popped);
+
+        /* map new slab to the free list (YPOOL_FLAG_GROWABLE) */
+        if (popped == count || !(pool->flags & YPOOL_FLAG_GROWABLE) || ygrow(pool) != 0)
+            break;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return popped;
+}
+
+/**
+    \brief Take up to `count` never used blocks from the bump cursor (YPOOL_FLAG_LAZY) to array
+    \details Pool mutex must be held unless pool is YPOOL_FLAG_LOCKFREE
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] count Max blocks to take
+    \param[out] sys_blocks Taken system blocks
+    \return Number of taken blocks
+*/
+
+static size_t ybump_chain(ypool_STC *pool, size_t count, AD_POINTER sys_blocks[]){
+    size_t taken;
+    size_t first_index;
+    size_t i;
+
+    if (count == 0)
+        return 0;
+
+    taken = ybump(pool, count, &first_index);
+
+    for (i = 0; i < taken; i++)
+        sys_blocks[i] = pool->start_PTR + (first_index + i) * yblock_stride(pool);
+
+    return taken;
+}
+
+/**
+    \brief Take up to `count` never used blocks from the bump cursor (YPOOL_FLAG_LAZY)
+    \details Pool mutex must be held unless pool is YPOOL_FLAG_LOCKFREE
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[out] *first_index Index of the first taken block (taken blocks are contiguous)
+    \return Number of taken blocks
+*/
+
+static size_t ybump(ypool_STC *pool, size_t count, size_t *first_index){
+    size_t    bump;
+    size_t    taken;
+    size_t    blocks_in_pool;
+
+    blocks_in_pool = pool->pool_size/pool->block_size;
+
+    if (pool->flags & YPOOL_FLAG_LOCKFREE){
+        bump = __atomic_load_n(pool->bump_index_PTR, __ATOMIC_RELAXED);
+
+        do
+        {
+            if (bump >= blocks_in_pool)
+                return 0;
+
+            taken = (count < blocks_in_pool - bump) ? count : blocks_in_pool - bump;
+        } while (!__atomic_compare_exchange_n(pool->bump_index_PTR, &bump, bump + taken, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    }else{
+        bump = *pool->bump_index_PTR;
+
+        if (bump >= blocks_in_pool)
+            return 0;
+
+        taken = (count < blocks_in_pool - bump) ? count : blocks_in_pool - bump;
+        __atomic_store_n(pool->bump_index_PTR, bump + taken, __ATOMIC_RELAXED); /* read without lock by yclaim_free() */
+    }
+
+    *first_index = bump;
+    return taken;
+}
+
+/**
+    \brief Link system block to the next one in a private chain (link encoding depends on pool mode)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] sys_block System block to link
+    \param[in] next_sys_block Next system block of the chain
+*/
+
+static void ychain_link(ypool_STC *pool, AD_POINTER sys_block, AD_POINTER next_sys_block){
+    if (pool->flags & YPOOL_FLAG_LOCKFREE)
+        __atomic_store_n((AD_POINTER*)sys_block, (AD_POINTER)(uintptr_t)((next_sys_block - pool->start_PTR) / yblock_stride(pool) + 1), __ATOMIC_RELAXED);
+    else
+        ((yblock_STC*)sys_block)->next_block = next_sys_block;
+}
+
+/**
+    \brief Splice private chain of system blocks (already linked from first to last) to the shared free list under single lock (or single CAS)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] first First system block of the chain (becomes the head)
+    \param[in] last Last system block of the chain
+*/
+
+static void ysplice_chain(ypool_STC *pool, AD_POINTER first, AD_POINTER last){
+    if (pool->flags & YPOOL_FLAG_LOCKFREE){
+        ylf_splice(pool, first, last);
+        ywake_waiters(pool);
+        return;
+    }
+
+    ylock(pool);
+    ((yblock_STC*)last)->next_block = (pool->next_free_block_PTR != NULL) ? pool->next_free_block_PTR : YBLOCK_LIST_END;
+    pool->next_free_block_PTR = first;
+    ywaiters_feed(pool);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/**
+    \brief Push `count` system blocks to the shared free list under single lock (or single CAS)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] count Blocks count
+    \param[in] sys_blocks System blocks which belong to the pool (sys_blocks[0] becomes the head)
+*/
+
+static void ypush_chain(ypool_STC *pool, size_t count, AD_POINTER sys_blocks[]){
+    size_t i;
+
+    if (count == 0)
+        return;
+
+    /* chain is private - link it before taking the lock */
+    for (i = 0; i < count - 1; i++)
+        ychain_link(pool, sys_blocks[i], sys_blocks[i+1]);
+
+    ysplice_chain(pool, sys_blocks[0], sys_blocks[count-1]);
+}
+
+/**
+    \brief Get calling thread cache of the pool (YPOOL_FLAG_TCACHE), create it on first use
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \return Thread cache or NULL if there is no memory for it
+*/
+
+static ytcache_STC *ytcache_get(ypool_STC *pool){
+    ytcache_STC * cache;
+
+    cache = pthread_getspecific(pool->tcache_key);
+    if (cache != NULL){
+        /* cached blocks were dropped by ypool_reset()/ypool_release() */
+        if (cache->epoch != __atomic_load_n(&pool->epoch, __ATOMIC_ACQUIRE)){
+            cache->epoch = __atomic_load_n(&pool->epoch, __ATOMIC_ACQUIRE);
+            cache->count = 0;
+        }
+        return cache;
+    }
+
+    cache = malloc(sizeof(ytcache_STC));
+    if (cache == NULL)
+        return NULL;
+
+    cache->pool = pool;
+    cache->epoch = __atomic_load_n(&pool->epoch, __ATOMIC_ACQUIRE);
+    cache->count = 0;
+
+    if (pthread_setspecific(pool->tcache_key, cache) != 0){
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+/**
+    \brief
+        Allocate block from thread cache, refill cache from the shared free list in bulk if empty
+
+    \param[in] cache Calling thread cache
+    \param[out] *user_block Pointer to allocated memory
+
+    \return
+        -ENOMEM    - Pool has no free memory
+                 0 - Successfuly allocated user_block
+*/
+
+static int ytcache_alloc(ytcache_STC *cache, AD_POINTER *user_block){
+    AD_POINTER block_PTR;
+    size_t i;
+
+    if (cache->count == 0){
+        cache->count = ypop_chain(cache->pool, YTCACHE_BATCH, cache->blocks);
+
+        if (cache->count == 0)
+            return -ENOMEM; /* No memory in pool */
+
+        /* cached blocks are free: keep next_block not NULL */
+        for (i = 0; i < cache->count; i++)
+            __atomic_store_n((AD_POINTER*)cache->blocks[i], YBLOCK_FREE_MARK, __ATOMIC_RELAXED);
+    }
+
+    block_PTR = cache->blocks[--cache->count];
+
+    /* mark block as allocated (set next_block = NULL) */
+    ymark_allocated(cache->pool, block_PTR);
+
+    *user_block = block_PTR + yblock_header(cache->pool);
+    return 0;
+}
+
+/**
+    \brief
+        Return block to thread cache, flush the coldest blocks to the shared free list in bulk at high-water mark
+
+    \param[in] cache Calling thread cache
+    \param[in] user_block Block which needed to free
+
+    \return
+        -EXDEV     - user_block is not belong the pool
+        -EALREADY  - user_block is marked as free
+        -EOVERFLOW - Guard word after user_block is overwritten (YPOOL_FLAG_CANARY)
+                 0 - Successfuly freed user_block
+*/
+
+static int ytcache_free(ytcache_STC *cache, AD_POINTER user_block){
+    AD_POINTER block_PTR;
+    int ret;
+
+    if (!yblock_belongs_to_pool(cache->pool, user_block))
+        return -EXDEV;
+
+    block_PTR = user_block - yblock_header(cache->pool);
+
+    /* claim block (allocated -> free), block may be freed by other thread concurrently */
+    ret = yclaim_free(cache->pool, block_PTR);
+
+    if (ret != 0)
+        return ret;
+
+    if (cache->count == YTCACHE_SIZE){
+        ypush_chain(cache->pool, YTCACHE_BATCH, cache->blocks);
+        memmove(cache->blocks, cache->blocks + YTCACHE_BATCH, (YTCACHE_SIZE - YTCACHE_BATCH) * sizeof(AD_POINTER));
+        cache->count -= YTCACHE_BATCH;
+    }
+
+    cache->blocks[cache->count++] = block_PTR;
+    return 0;
+}
+
+/**
+    \brief Thread exit destructor: return all cached blocks to the shared free list
+    \param[in] cache Exiting thread cache
+*/
+
+static void ytcache_destroy(void *cache){
+    ytcache_STC * tcache = cache;
+
+    if (tcache->epoch == __atomic_load_n(&tcache->pool->epoch, __ATOMIC_ACQUIRE))
+        ypush_chain(tcache->pool, tcache->count, tcache->blocks);
+    free(tcache);
+}
+
+/**
+    \brief Record event to calling thread's ring (YPOOL_FLAG_TRACE)
+    \details Single writer per ring: slot is written first, then head is published
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] op YTRACE_ALLOC, YTRACE_FREE
+    \param[in] ret Call result
+    \param[in] user_block Allocated or freed block (NULL - allocation failed)
+    \param[in] caller Return address of the public call
+*/
+
+static void ytrace(ypool_STC *pool, uint16_t op, int ret, AD_POINTER user_block, AD_POINTER caller){
+    ytrace_ring_STC  * ring;
+    ytrace_event_STC * event;
+    uint64_t           head;
+
+    if (pool == NULL || !(pool->flags & YPOOL_FLAG_TRACE) || pool->start_PTR == NULL)
+        return;
+
+    ring = pthread_getspecific(pool->trace_key);
+
+    if (ring == NULL && (ring = ytrace_ring(pool)) == NULL)
+        return;
+
+    head = ring->head;
+    event = &ring->events[head % YPOOL_TRACE_EVENTS];
+
+    event->ticks = ytrace_clock();
+    event->block = (uint64_t)(uintptr_t)user_block;
+    event->caller = (uint64_t)(uintptr_t)caller;
+    event->thread = ring->thread;
+    event->op = op;
+    event->ret = (int16_t)ret;
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+    \brief Attach ring to calling thread: ring of exited thread, or a new one
+    \details Rings are never freed, so ypool_trace_dump() walks the list without lock
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \return Ring or NULL if there is no memory
+*/
+
+static ytrace_ring_STC *ytrace_ring(ypool_STC *pool){
+    ytrace_ring_STC * ring;
+    uint32_t          owned;
+
+    for (ring = __atomic_load_n(&pool->trace_rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+    {
+        owned = 0;
+        if (__atomic_compare_exchange_n(&ring->owned, &owned, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+
+    if (ring == NULL){
+        ring = malloc(sizeof(ytrace_ring_STC));
+
+        if (ring == NULL)
+            return NULL;
+
+        ring->owned = 1;
+        ring->head = 0;
+        ring->next = __atomic_load_n(&pool->trace_rings, __ATOMIC_RELAXED);
+
+        while (!__atomic_compare_exchange_n(&pool->trace_rings, &ring->next, ring, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+
+    ring->thread = (uint32_t)syscall(SYS_gettid);
+
+    if (pthread_setspecific(pool->trace_key, ring) != 0){
+        ytrace_release(ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+/**
+    \brief Thread exit: ring keeps its events & is reused by the next new thread
+    \param[in] ring Ring of the exited thread
+*/
+
+static void ytrace_release(void *ring){
+    __atomic_store_n(&((ytrace_ring_STC*)ring)->owned, 0, __ATOMIC_RELEASE);
+}
+
+/**
+    \brief Read trace clock (TSC on x86, ns of CLOCK_MONOTONIC otherwise)
+    \return Clock ticks
+*/
+
+static uint64_t ytrace_clock(void){
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return ytrace_ns();
+#endif
+}
+
+/**
+    \brief Read CLOCK_MONOTONIC
+    \return Time in ns
+*/
+
+static uint64_t ytrace_ns(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/**
+    \brief Write whole buffer (retry short writes & EINTR)
+    \param[in] fd File descriptor
+    \param[in] data Buffer
+    \param[in] size Buffer size
+    \return 0 or -errno of write()
+*/
+
+static int ywrite_all(int fd, const void *data, size_t size){
+    ssize_t written;
+
+    while (size != 0)
+    {
+        written = write(fd, data, size);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+
+        if (written <= 0)
+            return (written < 0) ? -errno : -EIO;
+
+        data = (const uint8_t*)data + written;
+        size -= written;
+    }
+
+    return 0;
+}
+
+/**
+    \brief Attach epoch record to calling thread: record of exited thread (with its bags), or a new one
+    \details Records are never freed, so yebr_advance() walks the list without lock
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \return Record or NULL if there is no memory
+*/
+
+static yebr_record_STC *yebr_record(ypool_STC *pool){
+    yebr_record_STC * record;
+    uint32_t          owned;
+
+    for (record = __atomic_load_n(&pool->ebr_records, __ATOMIC_ACQUIRE); record != NULL; record = record->next)
+    {
+        owned = 0;
+        if (__atomic_compare_exchange_n(&record->owned, &owned, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+
+    if (record == NULL){
+        record = calloc(1, sizeof(yebr_record_STC));
+
+        if (record == NULL)
+            return NULL;
+
+        record->owned = 1;
+        record->next = __atomic_load_n(&pool->ebr_records, __ATOMIC_RELAXED);
+
+        while (!__atomic_compare_exchange_n(&pool->ebr_records, &record->next, record, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+
+    record->nesting = 0;
+
+    if (pthread_setspecific(pool->ebr_key, record) != 0){
+        yebr_release(record);
+        return NULL;
+    }
+
+    return record;
+}
+
+/**
+    \brief Thread exit: record keeps its bags for yebr_reclaim_orphans() or the next new thread
+    \param[in] record Record of the exited thread
+*/
+
+static void yebr_release(void *record){
+    __atomic_store_n(&((yebr_record_STC*)record)->active, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&((yebr_record_STC*)record)->owned, 0, __ATOMIC_RELEASE);
+}
+
+/**
+    \brief Move global epoch on if every thread inside read section has seen it
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] epoch Global epoch seen by the caller
+    \return true if global epoch is past epoch
+*/
+
+static bool yebr_advance(ypool_STC *pool, uint64_t epoch){
+    yebr_record_STC *record;
+    uint64_t active;
+
+    /* pairs with the fence of ypool_enter(): section is seen, or its loads see the unlinks */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for (record = __atomic_load_n(&pool->ebr_records, __ATOMIC_ACQUIRE); record != NULL; record = record->next)
+    {
+        active = __atomic_load_n(&record->active, __ATOMIC_ACQUIRE);
+
+        if ((active & 1) && (active >> 1) != epoch)
+            return false;
+    }
+
+    /* failed exchange: other thread has moved it */
+    __atomic_compare_exchange_n(&pool->ebr_epoch, &epoch, epoch + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+
+    return true;
+}
+
+/**
+    \brief Free bags of the record which no reader can see (global epoch is 2 epochs ahead)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] record Record owned by the caller
+*/
+
+static void yebr_reclaim(ypool_STC *pool, yebr_record_STC *record){
+    uint64_t epoch;
+    int i;
+
+    epoch = __atomic_load_n(&pool->ebr_epoch, __ATOMIC_ACQUIRE);
+
+    for (i = 0; i < 3; i++)
+        if (record->bags[i].epoch + 2 <= epoch)
+            yebr_flush(pool, &record->bags[i]);
+}
+
+/**
+    \brief Free safe bags of exited threads' records (record is owned for the time)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] self Record of the caller (skipped, may be NULL)
+*/
+
+static void yebr_reclaim_orphans(ypool_STC *pool, yebr_record_STC *self){
+    yebr_record_STC * record;
+    uint32_t          owned;
+
+    for (record = __atomic_load_n(&pool->ebr_records, __ATOMIC_ACQUIRE); record != NULL; record = record->next)
+    {
+        owned = 0;
+        if (record == self || !__atomic_compare_exchange_n(&record->owned, &owned, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+
+        yebr_reclaim(pool, record);
+        __atomic_store_n(&record->owned, 0, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+    \brief Return bag to the free list at once (bag of older pool reset is dropped)
+    \param[in] pool Pointer to the pool to which the operation will be applied
+    \param[in] bag Bag no reader can see
+*/
+
+static void yebr_flush(ypool_STC *pool, yebr_bag_STC *bag){
+    if (bag->count != 0 && bag->resets == __atomic_load_n(&pool->resets, __ATOMIC_RELAXED))
+        yfree_blocks(pool, bag->count, bag->blocks);
+
+    bag->count = 0;
 }
 
 /* Debug funcs */
@@ -338,9 +4949,12 @@ int ypool_print(ypool_STC *pool){
     for (uint32_t curr_block=0; curr_block < blocks_in_pool; curr_block++)
     {
         printf("========[block: 0x%016x]=========\n", block_PTR);
-        _yblock_print(block_PTR, pool->block_size);
+        if (pool->flags & YPOOL_FLAG_COMPACT)
+            _sysblock_print_raw(block_PTR, pool->block_size);
+        else
+            _yblock_print(block_PTR, pool->block_size);
         printf("============================================\n");
-        block_PTR += sys_block_size(pool->block_size);
+        block_PTR += yblock_stride(pool);
     }
     pthread_mutex_unlock(&pool->mutex);
     return 0;
@@ -388,9 +5002,9 @@ int ypool_print_raw(ypool_STC *pool){
     for (uint32_t curr_block=0; curr_block < blocks_in_pool; curr_block++)
     {
         printf("========[block: 0x%016x]=========\n", block_PTR);
-        _sysblock_print_raw(block_PTR, sys_block_size(pool->block_size));
+        _sysblock_print_raw(block_PTR, yblock_stride(pool));
         printf("============================================\n");
-        block_PTR += sys_block_size(pool->block_size);
+        block_PTR += yblock_stride(pool);
     }
     pthread_mutex_unlock(&pool->mutex);
     return 0;
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include "yheap.h"
+#include <memory.h>
+#include <stddef.h>
+
+/**
+    \file
+    \brief Size-class front end over block pools
+
+    \details
+        Every size class is served by its own ypool_STC. Request size is mapped to
+        its class by constant lookup table, block is mapped back to its class by
+        the address to pool map of the allocator (ypool_lookup()).
+*/
+
+static const size_t yheap_class_size[YHEAP_CLASS_COUNT] = {
+      16,   32,   48,   64,   80,   96,  112,  128,
+     160,  192,  224,  256,  320,  384,  448,  512,
+     640,  768,  896, 1024,
+};
+
+/* class index by (size + YHEAP_MIN_SIZE - 1) >> YHEAP_SIZE_SHIFT */
+static const uint8_t yheap_class_lut[(YHEAP_MAX_SIZE >> YHEAP_SIZE_SHIFT) + 1] = {
+     0,  0,  1,  2,  3,  4,  5,  6,  7,  8,  8,  9,  9, 10, 10, 11,
+    11, 12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15,
+    15, 16, 16, 16, 16, 16, 16, 16, 16, 17, 17, 17, 17, 17, 17, 17,
+    17, 18, 18, 18, 18, 18, 18, 18, 18, 19, 19, 19, 19, 19, 19, 19,
+    19,
+};
+
+static yheap_STC       yheap_default;
+static int             yheap_default_ret;
+static pthread_once_t  yheap_default_once = PTHREAD_ONCE_INIT;
+
+/**
+    \brief
+        Used to create pools of all size classes
+
+    \details
+        heap->class_pool_size & heap->flags must be set before call.
+        Class pools are initialized with heap->flags, so YPOOL_FLAG_LAZY heap
+        is initialized in constant time.
+
+    \param[in/out] heap Pointer to the heap to which the operation will be applied
+
+    \return
+        -EFAULT    - Heap pointer is NULL
+        -EALREADY  - Heap is initialized already
+        -EINVAL    - Class pool size is less than YHEAP_MAX_SIZE or flags are not supported (YPOOL_FLAG_GROWABLE, YPOOL_FLAG_NUMA)
+        -EAGAIN    - Unable to create thread cache key (YPOOL_FLAG_TCACHE)
+        -ENOMEM    - There are no free memory in system to allocate class pools
+                 0 - Successfuly initialized heap
+*/
+
+int yheap_init(yheap_STC *heap){
+    int i;
+    int ret;
+
+    if (heap == NULL)
+        return -EFAULT;
+
+    if (heap->initialized)
+        return -EALREADY;
+
+    /* block to class lookup needs fixed class arenas */
+    if (heap->class_pool_size < YHEAP_MAX_SIZE || (heap->flags & (YPOOL_FLAG_GROWABLE | YPOOL_FLAG_NUMA)))
+        return -EINVAL;
+
+    for (i = 0; i < YHEAP_CLASS_COUNT; i++)
+    {
+        memset(&heap->classes[i], 0, sizeof(heap->classes[i]));
+        heap->classes[i].pool.block_size = yheap_class_size[i];
+        heap->classes[i].pool.pool_size = heap->class_pool_size;
+        heap->classes[i].pool.flags = heap->flags;
+
+        ret = ypool_init(&heap->classes[i].pool);
+
+        if (ret != 0){
+            while (i-- > 0)
+                ypool_close(&heap->classes[i].pool);
+            return ret;
+        }
+    }
+
+    heap->initialized = true;
+
+    return 0;
+}
+
+/**
+    \brief
+        Used to allocate block of at least size bytes from the smallest fitting size class
+
+    \param[in] heap Pointer to the heap to which the operation will be applied
+    \param[in] size Requested size in bytes
+    \param[out] *block Pointer to allocated memory
+
+    \return
+        -EFAULT    - Heap pointer is NULL or heap is not initialized
+        -EINVAL    - Requested size is 0
+        -E2BIG     - Requested size is greater than YHEAP_MAX_SIZE
+        -ENOMEM    - There are no free blocks in size class
+                 0 - Successfuly allocated block
+*/
+
+int yheap_alloc(yheap_STC *heap, size_t size, AD_POINTER *block){
+    yheap_class_STC *cls;
+    uint64_t used, peak;
+    int ret;
+
+    if (heap == NULL || !heap->initialized)
+        return -EFAULT;
+
+    if (size == 0)
+        return -EINVAL;
+
+    if (size > YHEAP_MAX_SIZE)
+        return -E2BIG;
+
+    cls = &heap->classes[yheap_class_lut[(size + YHEAP_MIN_SIZE - 1) >> YHEAP_SIZE_SHIFT]];
+
+    ret = yalloc_block(&cls->pool, block);
+
+    if (ret != 0){
+        __atomic_fetch_add(&cls->failures, 1, __ATOMIC_RELAXED);
+        return ret;
+    }
+
+    used = __atomic_add_fetch(&cls->allocs, 1, __ATOMIC_RELAXED) - __atomic_load_n(&cls->frees, __ATOMIC_RELAXED);
+    peak = __atomic_load_n(&cls->peak, __ATOMIC_RELAXED);
+
+    while (used > peak && !__atomic_compare_exchange_n(&cls->peak, &peak, used, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+
+    return 0;
+}
+
+/**
+    \brief
+        Used to free block allocated by yheap_alloc()
+
+    \param[in] heap Pointer to the heap to which the operation will be applied
+    \param[in] block Pointer to memory for free
+
+    \return
+        -EFAULT    - Heap pointer is NULL or heap is not initialized
+        -EXDEV     - Block doesn't belong to the heap
+        -EALREADY  - Block is already free
+                 0 - Successfuly freed block
+*/
+
+int yheap_free(yheap_STC *heap, AD_POINTER block){
+    yheap_class_STC *cls;
+    ypool_STC *pool;
+    int ret;
+
+    if (heap == NULL || !heap->initialized)
+        return -EFAULT;
+
+    if (ypool_lookup(block, &pool) != 0 || (cls = yheap_class_of(heap, pool)) == NULL)
+        return -EXDEV;
+
+    ret = yfree_block(&cls->pool, block);
+
+    if (ret == 0)
+        __atomic_fetch_add(&cls->frees, 1, __ATOMIC_RELAXED);
+
+    return ret;
+}
+
+/**
+    \brief
+        Used to read fill statistics of all size classes
+
+    \details
+        Counters are read without locking, so snapshot of busy heap is approximate.
+
+    \param[in] heap Pointer to the heap to which the operation will be applied
+    \param[out] stats Statistics per size class (smallest class first)
+
+    \return
+        -EFAULT    - Heap or stats pointer is NULL or heap is not initialized
+        YHEAP_CLASS_COUNT - Count of filled stats entries
+*/
+
+int yheap_get_stats(yheap_STC *heap, yheap_class_stats_STC stats[YHEAP_CLASS_COUNT]){
+    yheap_class_STC *cls;
+    int i;
+
+    if (heap == NULL || stats == NULL || !heap->initialized)
+        return -EFAULT;
+
+    for (i = 0; i < YHEAP_CLASS_COUNT; i++)
+    {
+        cls = &heap->classes[i];
+        stats[i].block_size = cls->pool.block_size;
+        stats[i].capacity = cls->pool.total_blocks;
+        stats[i].frees = __atomic_load_n(&cls->frees, __ATOMIC_RELAXED);
+        stats[i].allocs = __atomic_load_n(&cls->allocs, __ATOMIC_RELAXED);
+        stats[i].failures = __atomic_load_n(&cls->failures, __ATOMIC_RELAXED);
+        stats[i].peak = __atomic_load_n(&cls->peak, __ATOMIC_RELAXED);
+        stats[i].used = stats[i].allocs > stats[i].frees ? stats[i].allocs - stats[i].frees : 0;
+    }
+
+    return YHEAP_CLASS_COUNT;
+}
+
+/**
+    \brief
+        Used to allocate block of at least size bytes from the default heap
+
+    \details
+        Default heap is created on first call with YHEAP_DEFAULT_POOL_SIZE class pools.
+
+    \param[in] size Requested size in bytes
+    \param[out] *block Pointer to allocated memory
+
+    \return
+        Same as yheap_alloc(), or error of default heap initialization
+*/
+
+int yalloc(size_t size, AD_POINTER *block){
+    pthread_once(&yheap_default_once, yheap_default_init);
+
+    if (yheap_default_ret != 0)
+        return yheap_default_ret;
+
+    return yheap_alloc(&yheap_default, size, block);
+}
+
+/**
+    \brief
+        Used to free block of any pool without passing the pool
+
+    \details
+        Owning pool is found in constant time by ypool_lookup(). Blocks of the
+        default heap (yalloc()) are counted in its class statistics, blocks of
+        other heaps are freed to their class pool without it (use yheap_free()).
+
+    \param[in] block Pointer to memory for free
+
+    \return
+        -EXDEV     - Block doesn't belong to any pool
+        Same as yfree_block() otherwise
+*/
+
+int yfree(AD_POINTER block){
+    ypool_STC *pool;
+
+    if (ypool_lookup(block, &pool) != 0)
+        return -EXDEV;
+
+    if (yheap_class_of(&yheap_default, pool) != NULL)
+        return yheap_free(&yheap_default, block);
+
+    return yfree_block(pool, block);
+}
+
+/* size class which owns the pool (NULL - pool is not a class pool of the heap) */
+static yheap_class_STC *yheap_class_of(yheap_STC *heap, ypool_STC *pool){
+    size_t offset;
+
+    if ((uintptr_t)pool < (uintptr_t)heap->classes || (uintptr_t)pool >= (uintptr_t)(heap->classes + YHEAP_CLASS_COUNT))
+        return NULL;
+
+    offset = ((uintptr_t)pool - (uintptr_t)heap->classes) % sizeof(yheap_class_STC);
+
+    return (offset == offsetof(yheap_class_STC, pool)) ? (yheap_class_STC*)((uintptr_t)pool - offset) : NULL;
+}
+
+static void yheap_default_init(void){
+    yheap_default.class_pool_size = YHEAP_DEFAULT_POOL_SIZE;
+    yheap_default.flags = YHEAP_DEFAULT_FLAGS;
+
+    yheap_default_ret = yheap_init(&yheap_default);
+}
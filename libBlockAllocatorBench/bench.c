@@ -0,0 +1,591 @@
+#include <stdio.h>
+#include <memory.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <dlfcn.h>
+
+#include "bench.h"
+
+/**
+    \file
+    \brief Block allocator benchmark: throughput & latency percentiles against malloc style baselines
+
+    \details
+        Every (allocator, workload, threads) case runs twice: throughput pass
+        without per-operation timing, then latency pass where every alloc &
+        free is timed. Results are printed as CSV or JSON. Locality pass
+        compares how dense live blocks of ypool allocation policies stay
+        after long random churn.
+*/
+
+static const char *workload_names[BENCH_WORKLOADS_COUNT] = {"lifo", "fifo", "random", "producer_consumer"};
+
+/* single producer single consumer queue of blocks (producer/consumer workload) */
+typedef struct _bench_queue
+{
+    void          * slots[BENCH_RING];
+    uint64_t        head __attribute__((aligned(64)));   /* written by consumer */
+    uint64_t        tail __attribute__((aligned(64)));   /* written by producer */
+}bench_queue_STC;
+
+typedef struct _bench_thread
+{
+    bench_allocator_STC * allocator;
+    bench_workload_ENUM   workload;
+    size_t                ops;
+    bool                  timed;
+    bool                  producer;
+    bench_queue_STC     * queue;
+    pthread_barrier_t   * start;
+    uint64_t              seed;
+    uint64_t            * alloc_ns;
+    uint64_t            * free_ns;
+    size_t                alloc_samples;
+    size_t                free_samples;
+    uint64_t              failed;
+}bench_thread_STC;
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t xorshift(uint64_t *state){
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static int cmp_u64(const void *a, const void *b){
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int cmp_ptr(const void *a, const void *b){
+    uintptr_t x = *(const uintptr_t *)a, y = *(const uintptr_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void *bench_alloc(bench_thread_STC *thread){
+    bench_allocator_STC *allocator = thread->allocator;
+    void *block = NULL;
+    uint64_t start = 0;
+
+    if (thread->timed)
+        start = now_ns();
+
+    if (allocator->malloc_fn != NULL)
+        block = allocator->malloc_fn(allocator->block_size);
+    else if (yalloc_block(&allocator->pool, &block) != 0)
+        block = NULL;
+
+    if (thread->timed)
+        thread->alloc_ns[thread->alloc_samples++] = now_ns() - start;
+
+    if (block == NULL)
+        thread->failed++;
+    else
+        *(volatile uint8_t *)block = 0xA5; /* touch block as a user would */
+
+    return block;
+}
+
+static void bench_free(bench_thread_STC *thread, void *block){
+    bench_allocator_STC *allocator = thread->allocator;
+    uint64_t start = 0;
+
+    if (block == NULL)
+        return;
+
+    if (thread->timed)
+        start = now_ns();
+
+    if (allocator->malloc_fn != NULL)
+        allocator->free_fn(block);
+    else
+        yfree_block(&allocator->pool, block);
+
+    if (thread->timed)
+        thread->free_ns[thread->free_samples++] = now_ns() - start;
+}
+
+/* allocate a window of blocks & free it in reverse order */
+static void bench_lifo(bench_thread_STC *thread){
+    void *slots[BENCH_WINDOW];
+    size_t done, n, i;
+
+    for (done = 0; done < thread->ops; done += n)
+    {
+        n = (thread->ops - done < BENCH_WINDOW) ? thread->ops - done : BENCH_WINDOW;
+
+        for (i = 0; i < n; i++)
+            slots[i] = bench_alloc(thread);
+
+        while (i-- > 0)
+            bench_free(thread, slots[i]);
+    }
+}
+
+/* free the oldest block of the window before every new allocation */
+static void bench_fifo(bench_thread_STC *thread){
+    void *slots[BENCH_WINDOW] = {NULL};
+    size_t i;
+
+    for (i = 0; i < thread->ops; i++)
+    {
+        bench_free(thread, slots[i % BENCH_WINDOW]);
+        slots[i % BENCH_WINDOW] = bench_alloc(thread);
+    }
+
+    for (i = 0; i < BENCH_WINDOW; i++)
+        bench_free(thread, slots[i]);
+}
+
+/* random slot of the window is freed if it is busy, filled otherwise */
+static void bench_random(bench_thread_STC *thread){
+    void *slots[BENCH_WINDOW] = {NULL};
+    size_t allocated = 0;
+    size_t slot;
+
+    while (allocated < thread->ops)
+    {
+        slot = xorshift(&thread->seed) % BENCH_WINDOW;
+
+        if (slots[slot] != NULL){
+            bench_free(thread, slots[slot]);
+            slots[slot] = NULL;
+        }else{
+            slots[slot] = bench_alloc(thread);
+            allocated++;
+        }
+    }
+
+    for (slot = 0; slot < BENCH_WINDOW; slot++)
+        bench_free(thread, slots[slot]);
+}
+
+/* producer allocates & queues blocks, consumer frees them (cross-thread free) */
+static void bench_producer_consumer(bench_thread_STC *thread){
+    bench_queue_STC *queue = thread->queue;
+    void *block;
+    uint64_t i;
+
+    for (i = 0; i < thread->ops; i++)
+    {
+        if (thread->producer){
+            while ((block = bench_alloc(thread)) == NULL)
+                sched_yield(); /* pool is drained by queue, wait for consumer */
+
+            while (i - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == BENCH_RING)
+                sched_yield();
+
+            queue->slots[i % BENCH_RING] = block;
+            __atomic_store_n(&queue->tail, i + 1, __ATOMIC_RELEASE);
+        }else{
+            while (__atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) == i)
+                sched_yield();
+
+            block = queue->slots[i % BENCH_RING];
+            __atomic_store_n(&queue->head, i + 1, __ATOMIC_RELEASE);
+            bench_free(thread, block);
+        }
+    }
+}
+
+static void *bench_thread(void *vargp){
+    bench_thread_STC *thread = vargp;
+
+    pthread_barrier_wait(thread->start);
+
+    switch (thread->workload)
+    {
+        case BENCH_LIFO:              bench_lifo(thread); break;
+        case BENCH_FIFO:              bench_fifo(thread); break;
+        case BENCH_RANDOM:            bench_random(thread); break;
+        case BENCH_PRODUCER_CONSUMER: bench_producer_consumer(thread); break;
+        default: break;
+    }
+
+    return NULL;
+}
+
+/**
+    \brief Prepare allocator for one benchmark case (ypool allocators get a new pool)
+    \param[in/out] allocator Allocator with name, pool_flags or malloc_fn/free_fn set
+    \param[in] block_size Block size
+    \param[in] blocks Max blocks alive at once
+    \return ypool_init() return code
+*/
+
+int bench_allocator_init(bench_allocator_STC *allocator, size_t block_size, size_t blocks){
+    allocator->block_size = block_size;
+
+    if (allocator->malloc_fn != NULL)
+        return 0;
+
+    /* pools can't be destroyed yet, previous case pool is left behind */
+    memset(&allocator->pool, 0, sizeof(allocator->pool));
+    allocator->pool.block_size = block_size;
+    allocator->pool.pool_size = block_size * blocks;
+    allocator->pool.flags = allocator->pool_flags;
+
+    return ypool_init(&allocator->pool);
+}
+
+/* one pass: returns wall time of the pass, collects samples of timed pass to result */
+static uint64_t bench_pass(bench_allocator_STC *allocator, bench_workload_ENUM workload, int threads, size_t ops, bool timed, bench_result_STC *result){
+    bench_thread_STC *args;
+    bench_queue_STC *queues;
+    pthread_t *ids;
+    pthread_barrier_t start;
+    uint64_t *alloc_ns, *free_ns;
+    size_t alloc_count = 0, free_count = 0;
+    size_t samples = ops + BENCH_WINDOW;
+    uint64_t begin, end;
+    int i;
+
+    args = calloc(threads, sizeof(*args));
+    ids = calloc(threads, sizeof(*ids));
+    queues = aligned_alloc(64, sizeof(*queues) * (threads / 2 + 1));
+    memset(queues, 0, sizeof(*queues) * (threads / 2 + 1));
+    pthread_barrier_init(&start, NULL, threads + 1);
+
+    for (i = 0; i < threads; i++)
+    {
+        args[i].allocator = allocator;
+        args[i].workload = workload;
+        args[i].ops = ops;
+        args[i].timed = timed;
+        args[i].producer = (i % 2 == 0);
+        args[i].queue = &queues[i / 2];
+        args[i].start = &start;
+        args[i].seed = 0x9E3779B97F4A7C15ull * (i + 1);
+
+        if (timed){
+            args[i].alloc_ns = malloc(samples * sizeof(uint64_t));
+            args[i].free_ns = malloc(samples * sizeof(uint64_t));
+        }
+
+        pthread_create(&ids[i], NULL, bench_thread, &args[i]);
+    }
+
+    /* workers are parked at the barrier, they may finish before main thread is scheduled again */
+    begin = now_ns();
+    pthread_barrier_wait(&start);
+
+    for (i = 0; i < threads; i++)
+        pthread_join(ids[i], NULL);
+
+    end = now_ns();
+
+    result->failed = 0;
+    for (i = 0; i < threads; i++)
+        result->failed += args[i].failed;
+
+    if (timed){
+        alloc_ns = malloc(samples * threads * sizeof(uint64_t));
+        free_ns = malloc(samples * threads * sizeof(uint64_t));
+
+        for (i = 0; i < threads; i++)
+        {
+            memcpy(alloc_ns + alloc_count, args[i].alloc_ns, args[i].alloc_samples * sizeof(uint64_t));
+            memcpy(free_ns + free_count, args[i].free_ns, args[i].free_samples * sizeof(uint64_t));
+            alloc_count += args[i].alloc_samples;
+            free_count += args[i].free_samples;
+            free(args[i].alloc_ns);
+            free(args[i].free_ns);
+        }
+
+        qsort(alloc_ns, alloc_count, sizeof(uint64_t), cmp_u64);
+        qsort(free_ns, free_count, sizeof(uint64_t), cmp_u64);
+
+        result->alloc_ns[0] = alloc_count ? alloc_ns[alloc_count * 500 / 1000] : 0;
+        result->alloc_ns[1] = alloc_count ? alloc_ns[alloc_count * 990 / 1000] : 0;
+        result->alloc_ns[2] = alloc_count ? alloc_ns[alloc_count * 999 / 1000] : 0;
+        result->free_ns[0] = free_count ? free_ns[free_count * 500 / 1000] : 0;
+        result->free_ns[1] = free_count ? free_ns[free_count * 990 / 1000] : 0;
+        result->free_ns[2] = free_count ? free_ns[free_count * 999 / 1000] : 0;
+
+        free(alloc_ns);
+        free(free_ns);
+    }
+
+    pthread_barrier_destroy(&start);
+    free(queues);
+    free(ids);
+    free(args);
+
+    return end - begin;
+}
+
+/**
+    \brief Run one benchmark case: throughput pass, then latency pass
+    \param[in] allocator Initialized allocator
+    \param[in] workload Workload
+    \param[in] threads Threads count (even for producer/consumer)
+    \param[in] ops Alloc/free pairs per thread in throughput pass
+    \param[out] result Case result
+    \return 0
+*/
+
+int bench_run(bench_allocator_STC *allocator, bench_workload_ENUM workload, int threads, size_t ops, bench_result_STC *result){
+    uint64_t wall_ns;
+    uint64_t pairs;
+    uint64_t failed;
+
+    wall_ns = bench_pass(allocator, workload, threads, ops, false, result);
+    failed = result->failed;
+
+    /* producer & consumer together move one block per op */
+    pairs = (workload == BENCH_PRODUCER_CONSUMER) ? ops * (threads / 2) : ops * threads;
+    result->mops = (wall_ns != 0) ? (double)pairs * 1000.0 / wall_ns : 0;
+
+    bench_pass(allocator, workload, threads, ops / BENCH_LATENCY_DIV, true, result);
+    result->failed += failed;
+
+    return 0;
+}
+
+/**
+    \brief Locality pass of ypool allocator (single thread)
+    \details
+        Arena is filled, random half is freed, then random live blocks are
+        freed & allocated again BENCH_LOCALITY_CHURN times per arena block.
+        Live blocks are measured (span, touched pages) & walked in address
+        order reading every byte, as iteration over live objects would.
+    \param[in/out] allocator ypool allocator (gets a new pool)
+    \param[in] block_size Block size
+    \param[out] result Pass result
+    \return
+        -ENOMEM - Unable to allocate pass state
+        other   - ypool_init() return code
+*/
+
+int bench_locality(bench_allocator_STC *allocator, size_t block_size, bench_locality_STC *result){
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    uint64_t start;
+    uint64_t sum = 0;
+    size_t live = BENCH_LOCALITY_BLOCKS / 2;
+    size_t i, j, walk;
+    void **blocks;
+    void *block;
+    int ret;
+
+    ret = bench_allocator_init(allocator, block_size, BENCH_LOCALITY_BLOCKS);
+
+    if (ret != 0)
+        return ret;
+
+    blocks = malloc(sizeof(void *) * BENCH_LOCALITY_BLOCKS);
+
+    if (blocks == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < BENCH_LOCALITY_BLOCKS; i++)
+        yalloc_block(&allocator->pool, &blocks[i]);
+
+    /* shuffle & free the second half */
+    for (i = BENCH_LOCALITY_BLOCKS - 1; i > 0; i--)
+    {
+        j = xorshift(&seed) % (i + 1);
+        block = blocks[i];
+        blocks[i] = blocks[j];
+        blocks[j] = block;
+    }
+    for (i = live; i < BENCH_LOCALITY_BLOCKS; i++)
+        yfree_block(&allocator->pool, blocks[i]);
+
+    start = now_ns();
+    for (i = 0; i < (size_t)BENCH_LOCALITY_BLOCKS * BENCH_LOCALITY_CHURN; i++)
+    {
+        j = xorshift(&seed) % live;
+        yfree_block(&allocator->pool, blocks[j]);
+        yalloc_block(&allocator->pool, &blocks[j]);
+    }
+    result->churn_mops = (double)BENCH_LOCALITY_BLOCKS * BENCH_LOCALITY_CHURN * 1000.0 / (now_ns() - start);
+
+    qsort(blocks, live, sizeof(void *), cmp_ptr);
+
+    result->live_blocks = live;
+    result->span_kb = ((uintptr_t)blocks[live - 1] - (uintptr_t)blocks[0] + block_size) / 1024;
+    result->pages = 1;
+    for (i = 1; i < live; i++)
+        result->pages += ((uintptr_t)blocks[i] / BENCH_PAGE_SIZE != (uintptr_t)blocks[i - 1] / BENCH_PAGE_SIZE);
+
+    start = now_ns();
+    for (walk = 0; walk < BENCH_LOCALITY_WALKS; walk++)
+    {
+        for (i = 0; i < live; i++)
+        {
+            for (j = 0; j < block_size; j++)
+                sum += ((volatile uint8_t *)blocks[i])[j];
+        }
+    }
+    result->walk_ns = (double)(now_ns() - start) / ((double)live * BENCH_LOCALITY_WALKS);
+
+    for (i = 0; i < live; i++)
+        yfree_block(&allocator->pool, blocks[i]);
+
+    free(blocks);
+
+    return (sum == 1) ? 1 : 0; /* keeps walk */
+}
+
+/**
+    \brief Print locality pass result
+    \param[in] format "csv" or "json"
+    \param[in] first First locality result (CSV header), JSON rows always follow throughput cases
+*/
+
+void bench_print_locality(const char *format, bench_allocator_STC *allocator, bench_locality_STC *result, bool first){
+    if (strcmp(format, "json") == 0){
+        printf(",\n  {\"allocator\": \"%s\", \"workload\": \"locality\", \"block_size\": %zu, \"churn_mops\": %.3f, "
+               "\"live_blocks\": %zu, \"span_kb\": %zu, \"pages\": %zu, \"walk_ns\": %.3f}",
+            allocator->name, allocator->block_size, result->churn_mops, result->live_blocks, result->span_kb, result->pages, result->walk_ns);
+        return;
+    }
+
+    if (first)
+        printf("\nallocator,workload,block_size,churn_mops,live_blocks,span_kb,pages,walk_ns\n");
+
+    printf("%s,locality,%zu,%.3f,%zu,%zu,%zu,%.3f\n",
+        allocator->name, allocator->block_size, result->churn_mops, result->live_blocks, result->span_kb, result->pages, result->walk_ns);
+}
+
+/**
+    \brief Print result of one case
+    \param[in] format "csv" or "json"
+    \param[in] first First printed result (CSV header, no JSON separator)
+*/
+
+void bench_print(const char *format, bench_allocator_STC *allocator, bench_workload_ENUM workload, int threads, size_t ops, bench_result_STC *result, bool first){
+    if (strcmp(format, "json") == 0){
+        printf("%s  {\"allocator\": \"%s\", \"workload\": \"%s\", \"threads\": %d, \"ops\": %zu, \"block_size\": %zu, \"mops\": %.3f, "
+               "\"alloc_ns\": {\"p50\": %llu, \"p99\": %llu, \"p999\": %llu}, "
+               "\"free_ns\": {\"p50\": %llu, \"p99\": %llu, \"p999\": %llu}, \"failed\": %llu}",
+            first ? "" : ",\n", allocator->name, workload_names[workload], threads, ops, allocator->block_size, result->mops,
+            (unsigned long long)result->alloc_ns[0], (unsigned long long)result->alloc_ns[1], (unsigned long long)result->alloc_ns[2],
+            (unsigned long long)result->free_ns[0], (unsigned long long)result->free_ns[1], (unsigned long long)result->free_ns[2],
+            (unsigned long long)result->failed);
+        return;
+    }
+
+    if (first)
+        printf("allocator,workload,threads,ops,block_size,mops,alloc_p50_ns,alloc_p99_ns,alloc_p999_ns,free_p50_ns,free_p99_ns,free_p999_ns,failed\n");
+
+    printf("%s,%s,%d,%zu,%zu,%.3f,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+        allocator->name, workload_names[workload], threads, ops, allocator->block_size, result->mops,
+        (unsigned long long)result->alloc_ns[0], (unsigned long long)result->alloc_ns[1], (unsigned long long)result->alloc_ns[2],
+        (unsigned long long)result->free_ns[0], (unsigned long long)result->free_ns[1], (unsigned long long)result->free_ns[2],
+        (unsigned long long)result->failed);
+}
+
+static void usage(const char *app){
+    fprintf(stderr, "usage: %s [-n ops_per_thread] [-t max_threads] [-b block_size] [-f csv|json]\n", app);
+}
+
+int main(int argc, char *argv[]){
+    bench_allocator_STC allocators[] = {
+        {.name = "ypool",          .pool_flags = 0},
+        {.name = "ypool_lockfree", .pool_flags = YPOOL_FLAG_LOCKFREE},
+        {.name = "ypool_tcache",   .pool_flags = YPOOL_FLAG_TCACHE},
+        {.name = "ypool_tcache_trace", .pool_flags = YPOOL_FLAG_TCACHE | YPOOL_FLAG_TRACE},
+        {.name = "ypool_hardened", .pool_flags = YPOOL_FLAG_HARDENED},
+        {.name = "ypool_hardened_canary", .pool_flags = YPOOL_FLAG_CANARY},
+        {.name = "ypool_lowfirst", .pool_flags = YPOOL_FLAG_LOWFIRST},
+        {.name = "malloc",         .malloc_fn = malloc, .free_fn = free},
+        {.name = "jemalloc"},
+    };
+    int allocators_count = sizeof(allocators) / sizeof(allocators[0]);
+    bench_result_STC result;
+    bench_locality_STC locality;
+    const char *format = "csv";
+    size_t ops = BENCH_OPS;
+    size_t block_size = BLOCK_SIZE;
+    int max_threads = BENCH_MAX_THREADS;
+    bool first = true;
+    void *jemalloc;
+    int opt, a, w, threads;
+
+    while ((opt = getopt(argc, argv, "n:t:b:f:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': ops = strtoul(optarg, NULL, 0); break;
+            case 't': max_threads = atoi(optarg); break;
+            case 'b': block_size = strtoul(optarg, NULL, 0); break;
+            case 'f': format = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    if (ops < BENCH_LATENCY_DIV || max_threads < 1 || block_size < sizeof(AD_POINTER)
+        || (strcmp(format, "csv") != 0 && strcmp(format, "json") != 0)){
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* jemalloc baseline only if it is installed (or run malloc baseline under LD_PRELOAD) */
+    jemalloc = dlopen(BENCH_JEMALLOC_LIB, RTLD_NOW | RTLD_LOCAL);
+    if (jemalloc != NULL){
+        allocators[allocators_count - 1].malloc_fn = dlsym(jemalloc, "malloc");
+        allocators[allocators_count - 1].free_fn = dlsym(jemalloc, "free");
+    }
+    if (jemalloc == NULL || allocators[allocators_count - 1].malloc_fn == NULL || allocators[allocators_count - 1].free_fn == NULL){
+        fprintf(stderr, "[bench] %s is not found, jemalloc baseline is skipped\n", BENCH_JEMALLOC_LIB);
+        allocators_count--;
+    }
+
+    if (strcmp(format, "json") == 0)
+        printf("[\n");
+
+    for (a = 0; a < allocators_count; a++)
+    {
+        for (w = 0; w < BENCH_WORKLOADS_COUNT; w++)
+        {
+            for (threads = 1; threads <= max_threads; threads *= 2)
+            {
+                /* producer/consumer needs pairs of threads */
+                if (w == BENCH_PRODUCER_CONSUMER && threads < 2)
+                    continue;
+
+                /* worst case alive blocks: windows or full queues, plus thread caches */
+                if (bench_allocator_init(&allocators[a], block_size, threads * (BENCH_WINDOW + BENCH_RING + 2 * YTCACHE_SIZE)) != 0){
+                    fprintf(stderr, "[bench] unable to init %s pool\n", allocators[a].name);
+                    return 1;
+                }
+
+                bench_run(&allocators[a], w, threads, ops, &result);
+                bench_print(format, &allocators[a], w, threads, ops, &result, first);
+                fflush(stdout);
+                first = false;
+            }
+        }
+    }
+
+    /* allocation policies of ypool (LIFO free list vs lowest-first) */
+    for (a = 0; a < allocators_count; a++)
+    {
+        if (allocators[a].malloc_fn != NULL)
+            continue;
+
+        if (bench_locality(&allocators[a], block_size, &locality) < 0){
+            fprintf(stderr, "[bench] unable to run locality pass of %s\n", allocators[a].name);
+            return 1;
+        }
+
+        bench_print_locality(format, &allocators[a], &locality, a == 0);
+        fflush(stdout);
+    }
+
+    if (strcmp(format, "json") == 0)
+        printf("\n]\n");
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef BENCH_H
+#define BENCH_H
+#include "../libBlockAllocator/bin/allocator.h"
+#include "../libBlockAllocator/bin/autoconf.h"
+
+/* defaults (override with command line options) */
+#define BENCH_OPS             200000  /* -n: alloc/free pairs per thread in throughput pass */
+#define BENCH_LATENCY_DIV          4  /* latency pass runs BENCH_OPS / BENCH_LATENCY_DIV pairs per thread */
+#define BENCH_MAX_THREADS          8  /* -t: thread counts are 1, 2, 4 ... up to it */
+
+/* workloads geometry */
+#define BENCH_WINDOW              64  /* live blocks per thread (LIFO/FIFO/random) */
+#define BENCH_RING              1024  /* producer/consumer queue capacity (power of 2) */
+
+#define BENCH_JEMALLOC_LIB    "libjemalloc.so.2"
+
+/* locality pass: half of the arena stays alive under random free/alloc churn */
+#define BENCH_LOCALITY_BLOCKS  (1u << 20) /* arena blocks */
+#define BENCH_LOCALITY_CHURN          4  /* free/alloc pairs per arena block */
+#define BENCH_LOCALITY_WALKS         10  /* address ordered walks over live blocks */
+#define BENCH_PAGE_SIZE            4096
+
+typedef enum _bench_workload
+{
+    BENCH_LIFO,
+    BENCH_FIFO,
+    BENCH_RANDOM,
+    BENCH_PRODUCER_CONSUMER,
+    BENCH_WORKLOADS_COUNT
+}bench_workload_ENUM;
+
+typedef struct _bench_allocator
+{
+    const char    * name;
+    uint32_t        pool_flags;             /* ypool allocators */
+    void         *(*malloc_fn)(size_t);     /* malloc style allocators (NULL - ypool) */
+    void          (*free_fn)(void *);
+    ypool_STC       pool;
+    size_t          block_size;
+}bench_allocator_STC;
+
+typedef struct _bench_result
+{
+    double          mops;                   /* alloc/free pairs per second, millions */
+    uint64_t        alloc_ns[3];            /* p50, p99, p99.9 */
+    uint64_t        free_ns[3];
+    uint64_t        failed;                 /* allocations which got no block */
+}bench_result_STC;
+
+typedef struct _bench_locality
+{
+    double          churn_mops;             /* free/alloc pairs per second, millions */
+    size_t          live_blocks;
+    size_t          span_kb;                /* lowest to highest live block */
+    size_t          pages;                  /* pages with live blocks */
+    double          walk_ns;                /* per live block */
+}bench_locality_STC;
+
+/* funcs */
+int bench_allocator_init(bench_allocator_STC *allocator, size_t block_size, size_t blocks);
+int bench_run(bench_allocator_STC *allocator, bench_workload_ENUM workload, int threads, size_t ops, bench_result_STC *result);
+int bench_locality(bench_allocator_STC *allocator, size_t block_size, bench_locality_STC *result);
+void bench_print_locality(const char *format, bench_allocator_STC *allocator, bench_locality_STC *result, bool first);
+void bench_print(const char *format, bench_allocator_STC *allocator, bench_workload_ENUM workload, int threads, size_t ops, bench_result_STC *result, bool first);
+
+#endif //BENCH_H
@@ -1,7 +1,13 @@
+#define _GNU_SOURCE /* getcpu() */
 #include <stdio.h>
 #include <memory.h>
 #include <assert.h>
 #include <unistd.h>
+#include <sched.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include "test.h"
 
@@ -14,20 +20,100 @@ int main(int argc, char const *argv[])
 
     assert(TEST_SET_SIZE >= BLOCK_SIZE);
 
-    assert(test_yalloc_single_thread() == 0);
+    assert(test_yalloc_single_thread(0) == 0);
+    assert(test_yalloc_single_thread(YPOOL_FLAG_LOCKFREE) == 0);
     assert(test_yalloc_multithreaded(THREADS_COUNT) == 0);
+    assert(test_yalloc_tcache() == 0);
+    assert(test_yalloc_batch(0) == 0);
+    assert(test_yalloc_batch(YPOOL_FLAG_LOCKFREE) == 0);
+    assert(test_yalloc_compact(YPOOL_FLAG_COMPACT) == 0);
+    assert(test_yalloc_compact(YPOOL_FLAG_COMPACT | YPOOL_FLAG_LOCKFREE) == 0);
+    assert(test_yalloc_compact(YPOOL_FLAG_COMPACT | YPOOL_FLAG_TCACHE) == 0);
+    assert(test_ypool_backing(YPOOL_FLAG_MMAP) == 0);
+    assert(test_ypool_backing(YPOOL_FLAG_POPULATE | YPOOL_FLAG_MLOCK) == 0);
+    assert(test_ypool_backing(YPOOL_FLAG_HUGEPAGES | YPOOL_FLAG_POPULATE) == 0);
+    assert(test_yalloc_lazy(YPOOL_FLAG_LAZY) == 0);
+    assert(test_yalloc_lazy(YPOOL_FLAG_LAZY | YPOOL_FLAG_LOCKFREE) == 0);
+    assert(test_yalloc_lazy(YPOOL_FLAG_LAZY | YPOOL_FLAG_COMPACT) == 0);
+    assert(test_yalloc_lazy(YPOOL_FLAG_LAZY | YPOOL_FLAG_TCACHE) == 0);
+    assert(test_yalloc_growable(YPOOL_FLAG_GROWABLE) == 0);
+    assert(test_yalloc_growable(YPOOL_FLAG_GROWABLE | YPOOL_FLAG_LAZY | YPOOL_FLAG_TCACHE) == 0);
+    assert(test_ypool_hardened(YPOOL_FLAG_HARDENED) == 0);
+    assert(test_ypool_hardened(YPOOL_FLAG_HARDENED | YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_LAZY) == 0);
+    assert(test_ypool_hardened(YPOOL_FLAG_CANARY | YPOOL_FLAG_POISON) == 0);
+    assert(test_ypool_hardened(YPOOL_FLAG_CANARY | YPOOL_FLAG_POISON | YPOOL_FLAG_COMPACT | YPOOL_FLAG_TCACHE) == 0);
+    assert(test_ypool_reset(0) == 0);
+    assert(test_ypool_reset(YPOOL_FLAG_LOCKFREE) == 0);
+    assert(test_ypool_reset(YPOOL_FLAG_TCACHE) == 0);
+    assert(test_ypool_reset(YPOOL_FLAG_COMPACT | YPOOL_FLAG_HARDENED | YPOOL_FLAG_LAZY) == 0);
+    assert(test_yalloc_lowfirst(YPOOL_FLAG_LOWFIRST) == 0);
+    assert(test_yalloc_lowfirst(YPOOL_FLAG_LOWFIRST | YPOOL_FLAG_COMPACT) == 0);
+    assert(test_yalloc_lowfirst(YPOOL_FLAG_LOWFIRST | YPOOL_FLAG_CANARY | YPOOL_FLAG_POISON) == 0);
+    assert(test_ypool_trim(YPOOL_FLAG_LOWFIRST | YPOOL_FLAG_MMAP) == 0);
+    assert(test_ypool_trim(YPOOL_FLAG_LOWFIRST | YPOOL_FLAG_COMPACT | YPOOL_FLAG_MMAP) == 0);
+    assert(test_ypool_trim(YPOOL_FLAG_LAZY | YPOOL_FLAG_MMAP) == 0);
+    assert(test_ypool_trim(0) == 0);
+    assert(test_ypool_trim(YPOOL_FLAG_TCACHE) == 0);
+    assert(test_ypool_trim(YPOOL_FLAG_COMPACT | YPOOL_FLAG_CANARY | YPOOL_FLAG_MMAP) == 0);
+    assert(test_yalloc_zeroed(0) == 0);
+    assert(test_yalloc_zeroed(YPOOL_FLAG_ZEROTRACK) == 0);
+    assert(test_yalloc_zeroed(YPOOL_FLAG_ZEROTRACK | YPOOL_FLAG_LAZY | YPOOL_FLAG_MMAP) == 0);
+    assert(test_yalloc_zeroed(YPOOL_FLAG_ZEROTRACK | YPOOL_FLAG_LOWFIRST | YPOOL_FLAG_MMAP) == 0);
+    assert(test_yalloc_zeroed(YPOOL_FLAG_ZEROTRACK | YPOOL_FLAG_COMPACT | YPOOL_FLAG_LAZY | YPOOL_FLAG_MMAP) == 0);
+    assert(test_yalloc_zeroed(YPOOL_FLAG_ZEROTRACK | YPOOL_FLAG_COMPACT | YPOOL_FLAG_TCACHE | YPOOL_FLAG_MMAP) == 0);
+    assert(test_yalloc_zeroed(YPOOL_FLAG_ZEROTRACK | YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_MMAP) == 0);
+    assert(test_ypool_trace(0) == 0);
+    assert(test_ypool_trace(YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_LAZY) == 0);
+    assert(test_ypool_trace(YPOOL_FLAG_TCACHE) == 0);
+    assert(test_ypool_trace(YPOOL_FLAG_NUMA) == 0);
+    assert(test_ypool_for_each(0) == 0);
+    assert(test_ypool_for_each(YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_LAZY) == 0);
+    assert(test_ypool_for_each(YPOOL_FLAG_TCACHE) == 0);
+    assert(test_ypool_for_each(YPOOL_FLAG_COMPACT) == 0);
+    assert(test_ypool_for_each(YPOOL_FLAG_LOWFIRST) == 0);
+    assert(test_ypool_for_each(YPOOL_FLAG_HARDENED | YPOOL_FLAG_TCACHE | YPOOL_FLAG_LAZY) == 0);
+    assert(test_ypool_for_each(YPOOL_FLAG_NUMA) == 0);
+    assert(test_ypool_numa(YPOOL_FLAG_NUMA) == 0);
+    assert(test_ypool_numa(YPOOL_FLAG_NUMA | YPOOL_FLAG_LAZY | YPOOL_FLAG_TCACHE) == 0);
+    assert(test_ypool_shared(YPOOL_FLAG_SHARED) == 0);
+    assert(test_ypool_shared(YPOOL_FLAG_SHARED | YPOOL_FLAG_LAZY) == 0);
+    assert(test_ypool_persistent(YPOOL_FLAG_PERSISTENT) == 0);
+    assert(test_ypool_persistent(YPOOL_FLAG_PERSISTENT | YPOOL_FLAG_LAZY) == 0);
+    assert(test_ypool_stats(0) == 0);
+    assert(test_ypool_stats(YPOOL_FLAG_LOCKFREE) == 0);
+    assert(test_ypool_stats(YPOOL_FLAG_TCACHE) == 0);
+    assert(test_yalloc_wait(0) == 0);
+    assert(test_yalloc_wait(YPOOL_FLAG_LOCKFREE) == 0);
+    assert(test_yalloc_wait(YPOOL_FLAG_TCACHE) == 0);
+    assert(test_yheap(0) == 0);
+    assert(test_yheap(YPOOL_FLAG_COMPACT | YPOOL_FLAG_LAZY | YPOOL_FLAG_TCACHE) == 0);
+    assert(test_yfree_lookup(0) == 0);
+    assert(test_yfree_lookup(YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_LAZY) == 0);
+    assert(test_yfree_lookup(YPOOL_FLAG_COMPACT | YPOOL_FLAG_TCACHE) == 0);
+    assert(test_yfree_lookup(YPOOL_FLAG_HARDENED | YPOOL_FLAG_MMAP) == 0);
+    assert(test_yfree_lookup(YPOOL_FLAG_GROWABLE) == 0);
+    assert(test_yfree_lookup(YPOOL_FLAG_NUMA) == 0);
+    assert(test_yfree_lookup(YPOOL_FLAG_SHARED) == 0);
+    assert(test_ypool_epoch(0) == 0);
+    assert(test_ypool_epoch(YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_LAZY) == 0);
+    assert(test_ypool_epoch(YPOOL_FLAG_TCACHE) == 0);
+    assert(test_ypool_epoch(YPOOL_FLAG_POISON) == 0);
+    assert(test_ypool_epoch(YPOOL_FLAG_NUMA) == 0);
+    assert(test_yalloc_thread_scaling(THREADS_COUNT) == 0);
     
     printf("[tests] Successfuly end !\n");
     return 0;
 }
 
-int test_yalloc_single_thread(){    
-    printf("[Single thread test] Start\n");
+int test_yalloc_single_thread(uint32_t flags){    
+    printf("[Single thread test] Start (flags=0x%x)\n", flags);
 
     ypool_STC pool_one = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
     AD_POINTER our_block;
     int i;
 
+    pool_one.flags = flags;
+
     
     printf("   initializing pool\n");
     assert(ypool_init(&pool_one) == 0);
@@ -182,3 +268,2121 @@ int test_yalloc_multithreaded(int threads){
     return 0;
 }
 
+typedef struct _scaling_arg
+{
+    ypool_STC * pool;
+    uint8_t     pattern;
+}scaling_arg_STC;
+
+void *scaling_thread(void *vargp)
+{
+    scaling_arg_STC * arg = vargp;
+    uint8_t expected[BLOCK_SIZE];
+    AD_POINTER our_block;
+    int ret;
+
+    memset(expected, arg->pattern, BLOCK_SIZE);
+
+    for (int i = 0; i < SCALING_ITERATIONS; i++){
+        while ((ret = yalloc_block(arg->pool, &our_block)) == -ENOMEM)
+            sched_yield();
+        assert(ret == 0);
+
+        /* nobody else may own this block until we free it */
+        memset(our_block, arg->pattern, BLOCK_SIZE);
+        assert(memcmp(our_block, expected, BLOCK_SIZE) == 0);
+
+        assert(yfree_block(arg->pool, our_block) == 0);
+    }
+
+    return NULL;
+}
+
+/* return: elapsed seconds of alloc/free storm in `threads` threads */
+double run_scaling(uint32_t flags, int threads, int blocks_per_thread)
+{
+    ypool_STC pool = {NULL, BLOCK_SIZE, BLOCK_SIZE * blocks_per_thread * threads, NULL, 0};
+    pthread_t * thread_id;
+    scaling_arg_STC * args;
+    struct timespec start, end;
+    int i;
+
+    pool.flags = flags;
+    assert(ypool_init(&pool) == 0);
+
+    thread_id = malloc(sizeof(pthread_t)*threads);
+    args = malloc(sizeof(scaling_arg_STC)*threads);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i = 0; i < threads; i++){
+        args[i].pool = &pool;
+        args[i].pattern = (uint8_t)(i + 1);
+        pthread_create(&thread_id[i], NULL, scaling_thread, &args[i]);
+    }
+    for(i = 0; i < threads; i++)
+        pthread_join(thread_id[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    free(thread_id);
+    free(args);
+
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int test_yalloc_thread_scaling(int max_threads){
+    double mutex_time, lockfree_time, tcache_time;
+    int threads;
+
+    printf("\n[Thread scaling test] Start up to %d threads, %d alloc/free per thread\n", max_threads, SCALING_ITERATIONS);
+    printf("   threads      mutex Mops/s   lock-free Mops/s   tcache Mops/s\n");
+
+    for (threads = 1; threads <= max_threads; threads = (threads * 2 > max_threads && threads != max_threads) ? max_threads : threads * 2){
+        mutex_time = run_scaling(0, threads, SCALING_BLOCKS_PER_THREAD);
+        lockfree_time = run_scaling(YPOOL_FLAG_LOCKFREE, threads, SCALING_BLOCKS_PER_THREAD);
+        tcache_time = run_scaling(YPOOL_FLAG_TCACHE, threads, YTCACHE_SIZE + SCALING_BLOCKS_PER_THREAD); /* thread cache may hold up to YTCACHE_SIZE blocks */
+        printf("   %7d %17.2f %18.2f %15.2f\n", threads,
+            (double)threads * SCALING_ITERATIONS / mutex_time / 1e6,
+            (double)threads * SCALING_ITERATIONS / lockfree_time / 1e6,
+            (double)threads * SCALING_ITERATIONS / tcache_time / 1e6);
+    }
+
+    printf("[Thread scaling test] Passed!\n");
+    return 0;
+}
+
+void *tcache_thread(void *vargp)
+{
+    ypool_STC * pool = vargp;
+    AD_POINTER our_block;
+
+    /* refill moves YTCACHE_BATCH blocks to this thread cache, free keeps them there */
+    assert(yalloc_block(pool, &our_block) == 0);
+    assert(yfree_block(pool, our_block) == 0);
+    assert(yfree_block(pool, our_block) == -EALREADY);
+
+    return NULL;
+}
+
+void *tcache_flushed_thread(void *vargp)
+{
+    ypool_STC * pool = vargp;
+    AD_POINTER blocks[YTCACHE_BATCH];
+    AD_POINTER our_block;
+    int i;
+
+    /* only blocks flushed by other thread are available */
+    for(i = 0; i < YTCACHE_BATCH; i++)
+        assert(yalloc_block(pool, &blocks[i]) == 0);
+    assert(yalloc_block(pool, &our_block) == -ENOMEM);
+
+    for(i = 0; i < YTCACHE_BATCH; i++)
+        assert(yfree_block(pool, blocks[i]) == 0);
+
+    return NULL;
+}
+
+int test_yalloc_tcache(){
+    printf("\n[Thread cache test] Start\n");
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, BLOCK_SIZE * TCACHE_TEST_BLOCKS, NULL, 0};
+    AD_POINTER blocks[TCACHE_TEST_BLOCKS];
+    AD_POINTER our_block;
+    pthread_t thread_id;
+    int i;
+
+    pool.flags = YPOOL_FLAG_TCACHE;
+
+    printf("   initializing pool\n");
+    assert(ypool_init(&pool) == 0);
+    printf("                                           Done!\n");
+
+    printf("   caching blocks in other thread\n");
+    pthread_create(&thread_id, NULL, tcache_thread, &pool);
+    pthread_join(thread_id, NULL);
+    printf("                                           Done!\n");
+
+    printf("   testing blocks returned on thread exit\n");
+    for(i = 0; i < TCACHE_TEST_BLOCKS; i++)
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+    printf("                                           Done!\n");
+
+    printf("   testing free errors\n");
+    assert(yfree_block(&pool, blocks[0] + (BLOCK_SIZE + sizeof(AD_POINTER)) * TCACHE_TEST_BLOCKS) == -EXDEV);
+    assert(yfree_block(&pool, blocks[0]) == 0);
+    assert(yfree_block(&pool, blocks[0]) == -EALREADY);
+    printf("                                           Done!\n");
+
+    printf("   testing flush at high-water mark\n");
+    for(i = 1; i < TCACHE_TEST_BLOCKS; i++)
+        assert(yfree_block(&pool, blocks[i]) == 0);
+    pthread_create(&thread_id, NULL, tcache_flushed_thread, &pool);
+    pthread_join(thread_id, NULL);
+    printf("                                           Done!\n");
+
+    printf("[Thread cache test] Passed!\n");
+    return 0;
+}
+
+int test_yalloc_batch(uint32_t flags){
+    printf("\n[Batch test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    AD_POINTER blocks[POOL_SIZE/BLOCK_SIZE + 1];
+    AD_POINTER our_block;
+    int i;
+
+    pool.flags = flags;
+
+    printf("   initializing pool\n");
+    assert(ypool_init(&pool) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing partial batch allocation\n");
+    assert(yalloc_blocks(&pool, POOL_SIZE/BLOCK_SIZE + 1, blocks) == POOL_SIZE/BLOCK_SIZE);
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++){
+        memcpy(blocks[i],test_set,BLOCK_SIZE);
+        assert(memcmp(blocks[i], test_set, BLOCK_SIZE) == 0);
+    }
+    assert(yalloc_blocks(&pool, 1, &our_block) == -ENOMEM);
+    printf("                                           Done!\n");
+
+    printf("   testing batch free with foreign block\n");
+    blocks[POOL_SIZE/BLOCK_SIZE] = blocks[0] + (BLOCK_SIZE + sizeof(AD_POINTER)) * POOL_SIZE/BLOCK_SIZE * 2;
+    assert(yfree_blocks(&pool, POOL_SIZE/BLOCK_SIZE + 1, blocks) == -EXDEV);
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM); /* nothing freed */
+    printf("                                           Done!\n");
+
+    printf("   testing batch free with duplicate block\n");
+    blocks[POOL_SIZE/BLOCK_SIZE] = blocks[0];
+    assert(yfree_blocks(&pool, POOL_SIZE/BLOCK_SIZE + 1, blocks) == POOL_SIZE/BLOCK_SIZE);
+    assert(yfree_blocks(&pool, POOL_SIZE/BLOCK_SIZE, blocks) == 0);
+    assert(yfree_block(&pool, blocks[1]) == -EALREADY);
+    printf("                                           Done!\n");
+
+    printf("   testing single & batch ops mix\n");
+    assert(yalloc_block(&pool, &our_block) == 0);
+    assert(yalloc_blocks(&pool, POOL_SIZE/BLOCK_SIZE, blocks) == POOL_SIZE/BLOCK_SIZE - 1);
+    assert(yfree_block(&pool, our_block) == 0);
+    assert(yfree_blocks(&pool, POOL_SIZE/BLOCK_SIZE - 1, blocks) == POOL_SIZE/BLOCK_SIZE - 1);
+    assert(yalloc_blocks(&pool, POOL_SIZE/BLOCK_SIZE, blocks) == POOL_SIZE/BLOCK_SIZE);
+    printf("                                           Done!\n");
+
+    printf("[Batch test] Passed!\n");
+    return 0;
+}
+
+int test_yalloc_compact(uint32_t flags){
+    printf("\n[Compact layout test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    AD_POINTER blocks[POOL_SIZE/BLOCK_SIZE];
+    AD_POINTER our_block;
+    int i;
+
+    pool.flags = flags;
+
+    printf("   initializing pool\n");
+    assert(ypool_init(&pool) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing %d blocks allocation without headers\n", POOL_SIZE/BLOCK_SIZE);
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++){
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+        assert(blocks[i] >= pool.start_PTR && blocks[i] < pool.start_PTR + POOL_SIZE); /* arena is exactly POOL_SIZE */
+        assert((blocks[i] - pool.start_PTR) % BLOCK_SIZE == 0);
+        memcpy(blocks[i],test_set,BLOCK_SIZE); /* whole block is user data */
+    }
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++)
+        assert(memcmp(blocks[i], test_set, BLOCK_SIZE) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing free errors\n");
+    assert(yfree_block(&pool, pool.start_PTR + POOL_SIZE) == -EXDEV);
+    assert(yfree_block(&pool, pool.start_PTR - BLOCK_SIZE) == -EXDEV);
+    assert(yfree_block(&pool, blocks[0]) == 0);
+    assert(yfree_block(&pool, blocks[0]) == -EALREADY);
+    printf("                                           Done!\n");
+
+    printf("   testing double free detection with user data in links\n");
+    for(i = 1; i < POOL_SIZE/BLOCK_SIZE; i++){
+        memset(blocks[i], 0x00, BLOCK_SIZE); /* looks like NULL link of header layout */
+        assert(yfree_block(&pool, blocks[i]) == 0);
+    }
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++)
+        assert(yfree_block(&pool, blocks[i]) == -EALREADY);
+    printf("                                           Done!\n");
+
+    printf("   testing batch ops\n");
+    assert(yalloc_blocks(&pool, POOL_SIZE/BLOCK_SIZE, blocks) == POOL_SIZE/BLOCK_SIZE);
+    assert(yfree_blocks(&pool, POOL_SIZE/BLOCK_SIZE, blocks) == POOL_SIZE/BLOCK_SIZE);
+    assert(yfree_blocks(&pool, POOL_SIZE/BLOCK_SIZE, blocks) == 0);
+    printf("                                           Done!\n");
+
+    printf("[Compact layout test] Passed!\n");
+    return 0;
+}
+
+int test_ypool_backing(uint32_t flags){
+    printf("\n[Backing test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, BACKING_TEST_POOL_SIZE, NULL, 0};
+    AD_POINTER our_block;
+    size_t i;
+
+    pool.flags = flags;
+
+    printf("   initializing pool\n");
+    assert(ypool_init(&pool) == 0);
+    assert(pool.backing & YPOOL_BACKING_MMAP);
+    assert(pool.arena_size >= BACKING_TEST_POOL_SIZE / BLOCK_SIZE * (BLOCK_SIZE + sizeof(AD_POINTER)));
+    assert(((uintptr_t)pool.start_PTR % sysconf(_SC_PAGESIZE)) == 0);
+    printf("   got backing:%s%s%s%s%s\n",
+        (pool.backing & YPOOL_BACKING_MMAP) ? " mmap" : "",
+        (pool.backing & YPOOL_BACKING_HUGETLB) ? " hugetlb" : "",
+        (pool.backing & YPOOL_BACKING_THP) ? " thp" : "",
+        (pool.backing & YPOOL_BACKING_POPULATED) ? " populated" : "",
+        (pool.backing & YPOOL_BACKING_LOCKED) ? " locked" : "");
+    if (flags & YPOOL_FLAG_POPULATE)
+        assert(pool.backing & YPOOL_BACKING_POPULATED);
+    printf("                                           Done!\n");
+
+    printf("   testing whole pool allocation\n");
+    for(i = 0; i < BACKING_TEST_POOL_SIZE/BLOCK_SIZE; i++){
+        assert(yalloc_block(&pool, &our_block) == 0);
+        memcpy(our_block,test_set,BLOCK_SIZE);
+    }
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+    assert(yfree_block(&pool, our_block) == 0);
+    printf("                                           Done!\n");
+
+    printf("[Backing test] Passed!\n");
+    return 0;
+}
+
+double init_time(uint32_t flags, size_t pool_size){
+    ypool_STC pool = {NULL, BLOCK_SIZE, pool_size, NULL, 0};
+    struct timespec start, end;
+
+    pool.flags = flags;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    assert(ypool_init(&pool) == 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int test_yalloc_lazy(uint32_t flags){
+    printf("\n[Lazy format test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    AD_POINTER blocks[POOL_SIZE/BLOCK_SIZE];
+    AD_POINTER our_block;
+    size_t stride;
+    int i;
+
+    pool.flags = flags;
+    stride = (flags & YPOOL_FLAG_COMPACT) ? BLOCK_SIZE : BLOCK_SIZE + sizeof(AD_POINTER);
+
+    printf("   initializing pool\n");
+    assert(ypool_init(&pool) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing free of never used (or cached) block\n");
+    assert(yalloc_block(&pool, &blocks[0]) == 0);
+    our_block = pool.start_PTR + (stride - BLOCK_SIZE); /* 1st block */
+    if (blocks[0] == our_block) /* bump cursor hands out blocks from the pool start */
+        our_block += stride * (POOL_SIZE/BLOCK_SIZE - 1);
+    assert(yfree_block(&pool, our_block) == -EALREADY);
+    printf("                                           Done!\n");
+
+    printf("   testing bump allocation order\n");
+    for(i = 1; i < POOL_SIZE/BLOCK_SIZE; i++){
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+        if (!(flags & YPOOL_FLAG_TCACHE)) /* thread cache hands out refilled blocks from the top */
+            assert(blocks[i] == blocks[i-1] + stride);
+        memcpy(blocks[i],test_set,BLOCK_SIZE);
+    }
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+    printf("                                           Done!\n");
+
+    printf("   testing freed blocks reuse\n");
+    assert(yfree_block(&pool, blocks[3]) == 0);
+    assert(yfree_block(&pool, blocks[3]) == -EALREADY);
+    assert(yalloc_block(&pool, &our_block) == 0);
+    assert(our_block == blocks[3]);
+    assert(yfree_blocks(&pool, POOL_SIZE/BLOCK_SIZE, blocks) == POOL_SIZE/BLOCK_SIZE);
+    assert(yalloc_blocks(&pool, POOL_SIZE/BLOCK_SIZE + 1, blocks) == POOL_SIZE/BLOCK_SIZE);
+    printf("                                           Done!\n");
+
+    printf("   comparing init time of %d MB pool: formatted %.3f ms, lazy %.3f ms\n", LAZY_TEST_POOL_SIZE >> 20,
+        init_time(flags & ~YPOOL_FLAG_LAZY, LAZY_TEST_POOL_SIZE) * 1e3, init_time(flags, LAZY_TEST_POOL_SIZE) * 1e3);
+
+    printf("[Lazy format test] Passed!\n");
+    return 0;
+}
+
+int test_yalloc_growable(uint32_t flags){
+    printf("\n[Growable pool test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    AD_POINTER blocks[GROW_TEST_MAX_BLOCKS];
+    AD_POINTER our_block;
+    int i;
+
+    pool.flags = flags;
+    pool.growth_factor = 2;
+    pool.max_pool_size = GROW_TEST_MAX_BLOCKS * BLOCK_SIZE;
+
+    printf("   checking unsupported flags\n");
+    pool.flags = flags | YPOOL_FLAG_COMPACT;
+    assert(ypool_init(&pool) == -EINVAL);
+    pool.flags = flags;
+    printf("                                           Done!\n");
+
+    printf("   initializing pool\n");
+    assert(ypool_init(&pool) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing growth up to %d blocks\n", GROW_TEST_MAX_BLOCKS);
+    for(i = 0; i < GROW_TEST_MAX_BLOCKS; i++){
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+        memcpy(blocks[i],test_set,BLOCK_SIZE);
+    }
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+    assert(pool.total_blocks == GROW_TEST_MAX_BLOCKS);
+    assert(pool.slab_index != NULL && pool.slab_index->count == GROW_TEST_SLABS);
+    for(i = 0; i < GROW_TEST_MAX_BLOCKS; i++)
+        assert(memcmp(blocks[i], test_set, BLOCK_SIZE) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing free of blocks from all slabs\n");
+    assert(yfree_block(&pool, (AD_POINTER)&our_block) == -EXDEV);
+    for(i = 0; i < GROW_TEST_MAX_BLOCKS; i++)
+        assert(yfree_block(&pool, blocks[i]) == 0);
+    for(i = 0; i < GROW_TEST_MAX_BLOCKS; i++)
+        assert(yfree_block(&pool, blocks[i]) == -EALREADY);
+    printf("                                           Done!\n");
+
+    printf("   testing no growth while freed blocks are available\n");
+    for(i = 0; i < GROW_TEST_MAX_BLOCKS; i++)
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+    assert(pool.slab_index->count == GROW_TEST_SLABS);
+    assert(yfree_blocks(&pool, GROW_TEST_MAX_BLOCKS, blocks) == GROW_TEST_MAX_BLOCKS);
+    printf("                                           Done!\n");
+
+    printf("[Growable pool test] Passed!\n");
+    return 0;
+}
+
+int test_ypool_hardened(uint32_t flags){
+    printf("\n[Hardened pool test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    ypool_STC bad = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    AD_POINTER blocks[POOL_SIZE/BLOCK_SIZE];
+    AD_POINTER our_block;
+    ypool_stats_STC stats, after;
+    uint8_t *bytes;
+    size_t header = (flags & YPOOL_FLAG_COMPACT) ? 0 : sizeof(AD_POINTER);
+    int i, j;
+
+    bad.flags = YPOOL_FLAG_CANARY | YPOOL_FLAG_GROWABLE;
+    assert(ypool_init(&bad) == -EINVAL);
+
+    pool.flags = flags;
+    assert(ypool_init(&pool) == 0);
+    assert(pool.flags & YPOOL_FLAG_HARDENED);
+    assert(pool.alloc_map != NULL);
+
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++){
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+        memcpy(blocks[i], test_set, BLOCK_SIZE);
+    }
+
+    printf("   testing pointer inside of block\n");
+    our_block = blocks[1] + 1;
+    assert(yfree_block(&pool, our_block) == -EXDEV);
+    our_block = blocks[1] - 1;
+    assert(yfree_block(&pool, our_block) == -EXDEV);
+    assert(yfree_blocks(&pool, 1, &our_block) == -EXDEV);
+    printf("                                           Done!\n");
+
+    printf("   testing double free with damaged header\n");
+    assert(yfree_block(&pool, blocks[0]) == 0);
+    if (header != 0)
+        *(AD_POINTER *)(blocks[0] - header) = NULL; /* looks allocated for header check */
+    assert(yfree_block(&pool, blocks[0]) == -EALREADY);
+    assert(yalloc_block(&pool, &blocks[0]) == 0);
+    printf("                                           Done!\n");
+
+    if (flags & YPOOL_FLAG_POISON){
+        printf("   testing poisoning of freed block\n");
+        assert(yfree_block(&pool, blocks[2]) == 0);
+        bytes = blocks[2];
+        /* link of compact block lives in its payload */
+        for (j = (flags & YPOOL_FLAG_COMPACT) ? sizeof(AD_POINTER) : 0; j < BLOCK_SIZE; j++)
+            assert(bytes[j] == YPOOL_POISON_BYTE);
+        assert(yalloc_block(&pool, &blocks[2]) == 0);
+        printf("                                           Done!\n");
+    }
+
+    if (flags & YPOOL_FLAG_CANARY){
+        printf("   testing guard word\n");
+        bytes = blocks[3];
+        bytes[BLOCK_SIZE] ^= 0x01; /* one byte overflow */
+        assert(yfree_block(&pool, blocks[3]) == -EOVERFLOW);
+        /* damaged block is never reused */
+        assert(yfree_block(&pool, blocks[3]) == -EALREADY);
+        assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+        if (STATS == 1)
+            assert(ypool_get_stats(&pool, &stats) == 0 && stats.eoverflow == 1);
+        blocks[3] = NULL;
+
+        /* batch free counts damaged block as overflow, not as double free */
+        bytes = blocks[4];
+        bytes[BLOCK_SIZE] ^= 0x01;
+        assert(yfree_blocks(&pool, 1, &blocks[4]) == 0);
+        if (STATS == 1){
+            assert(ypool_get_stats(&pool, &after) == 0 && after.eoverflow == 2);
+            assert(after.ealready == stats.ealready);
+        }
+        blocks[4] = NULL;
+        printf("                                           Done!\n");
+    }
+
+    printf("   freeing blocks\n");
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++){
+        if (blocks[i] == NULL)
+            continue;
+        if (!(flags & YPOOL_FLAG_POISON))
+            assert(memcmp(blocks[i], test_set, BLOCK_SIZE) == 0);
+        assert(yfree_block(&pool, blocks[i]) == 0);
+    }
+    printf("                                           Done!\n");
+
+    printf("[Hardened pool test] Passed!\n");
+    return 0;
+}
+
+int test_ypool_reset(uint32_t flags){
+    printf("\n[Reset test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    ypool_STC growable = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    AD_POINTER blocks[POOL_SIZE/BLOCK_SIZE];
+    AD_POINTER our_block;
+    ypool_mark_STC outer, inner;
+    int blocks_count = POOL_SIZE/BLOCK_SIZE;
+    int i;
+
+    growable.flags = YPOOL_FLAG_GROWABLE;
+    assert(ypool_init(&growable) == 0);
+    assert(ypool_reset(&growable) == -ENOTSUP);
+    assert(ypool_mark(&growable, &outer) == -ENOTSUP);
+
+    pool.flags = flags;
+    assert(ypool_reset(&pool) == -EINVAL);
+    assert(ypool_init(&pool) == 0);
+    assert(ypool_mark(&pool, NULL) == -EFAULT);
+
+    printf("   testing reset of exhausted pool\n");
+    /* blocks in thread cache must be dropped too */
+    assert(yalloc_block(&pool, &our_block) == 0);
+    assert(yfree_block(&pool, our_block) == 0);
+    for (i = 0; i < blocks_count; i++)
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+
+    assert(ypool_reset(&pool) == 0);
+    for (i = 0; i < blocks_count; i++){
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+        memcpy(blocks[i], test_set, BLOCK_SIZE);
+    }
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+
+    if (STATS == 1){
+        ypool_stats_STC stats;
+        assert(ypool_get_stats(&pool, &stats) == 0 && stats.used_blocks == blocks_count);
+    }
+    printf("                                           Done!\n");
+
+    printf("   testing free of block dropped by reset\n");
+    assert(ypool_reset(&pool) == 0);
+    assert(yalloc_block(&pool, &our_block) == 0);
+    assert(yfree_block(&pool, blocks[blocks_count - 1]) == -EALREADY);
+    assert(yfree_block(&pool, our_block) == 0);
+    printf("                                           Done!\n");
+
+    if (flags & YPOOL_FLAG_TCACHE){
+        assert(ypool_mark(&pool, &outer) == -ENOTSUP);
+        printf("[Reset test] Passed!\n");
+        return 0;
+    }
+
+    printf("   testing nested mark/release\n");
+    assert(ypool_reset(&pool) == 0);
+    for (i = 0; i < 2; i++)
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+    assert(ypool_mark(&pool, &outer) == 0);
+    for (; i < 5; i++)
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+    assert(ypool_mark(&pool, &inner) == 0);
+    for (; i < 9; i++)
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+
+    assert(ypool_release(&pool, &inner) == 0);
+    assert(yalloc_block(&pool, &our_block) == 0 && our_block == blocks[5]);
+    assert(ypool_release(&pool, &outer) == 0);
+    assert(ypool_release(&pool, &inner) == -ESTALE);
+    assert(yalloc_block(&pool, &our_block) == 0 && our_block == blocks[2]);
+
+    /* outer blocks stay allocated */
+    assert(yfree_block(&pool, blocks[0]) == 0);
+    assert(ypool_mark(&pool, &inner) == -EBUSY);
+
+    assert(ypool_reset(&pool) == 0);
+    assert(ypool_release(&pool, &outer) == -ESTALE);
+    printf("                                           Done!\n");
+
+    printf("[Reset test] Passed!\n");
+    return 0;
+}
+
+void *lowfirst_thread(void *vargp)
+{
+    ypool_STC * pool = vargp;
+    AD_POINTER blocks[TEST_SET_SIZE];
+    int i, n;
+
+    for (n = 0; n < SCALING_ITERATIONS / 100; n++){
+        for (i = 0; i < TEST_SET_SIZE; i++)
+            assert(yalloc_block(pool, &blocks[i]) == 0);
+        for (i = 0; i < TEST_SET_SIZE; i++)
+            assert(yfree_block(pool, blocks[i]) == 0);
+    }
+
+    return NULL;
+}
+
+int test_yalloc_lowfirst(uint32_t flags){
+    printf("\n[Lowest-first pool test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, BLOCK_SIZE * LOW_TEST_BLOCKS, NULL, 0};
+    ypool_STC bad = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    AD_POINTER *blocks = malloc(sizeof(AD_POINTER) * LOW_TEST_BLOCKS);
+    AD_POINTER batch[TEST_SET_SIZE];
+    AD_POINTER our_block;
+    pthread_t thread_id[LOW_TEST_THREADS];
+    ypool_mark_STC mark;
+    size_t i;
+    int n;
+
+    bad.flags = YPOOL_FLAG_LOWFIRST | YPOOL_FLAG_LOCKFREE;
+    assert(ypool_init(&bad) == -EINVAL);
+    bad.flags = YPOOL_FLAG_LOWFIRST | YPOOL_FLAG_TCACHE;
+    assert(ypool_init(&bad) == -EINVAL);
+    bad.flags = YPOOL_FLAG_LOWFIRST | YPOOL_FLAG_GROWABLE;
+    assert(ypool_init(&bad) == -EINVAL);
+
+    pool.flags = flags;
+    assert(ypool_init(&pool) == 0);
+    assert(ypool_mark(&pool, &mark) == -ENOTSUP);
+
+    printf("   testing blocks are handed out in address order\n");
+    for (i = 0; i < LOW_TEST_BLOCKS; i++){
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+        assert(i == 0 || blocks[i] > blocks[i - 1]);
+    }
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+    printf("                                           Done!\n");
+
+    printf("   testing the lowest hole is filled first\n");
+    assert(yfree_block(&pool, blocks[LOW_TEST_BLOCKS - 1]) == 0);
+    for (i = LOW_TEST_HOLE_END - 1; i >= LOW_TEST_HOLE_START; i--)
+        assert(yfree_block(&pool, blocks[i]) == 0);
+    assert(yfree_block(&pool, blocks[LOW_TEST_HOLE_START]) == -EALREADY);
+    assert(yfree_block(&pool, blocks[7]) == 0);
+
+    assert(yalloc_block(&pool, &our_block) == 0 && our_block == blocks[7]);
+    assert(yalloc_blocks(&pool, TEST_SET_SIZE, batch) == TEST_SET_SIZE);
+    for (n = 0; n < TEST_SET_SIZE; n++)
+        assert(batch[n] == blocks[LOW_TEST_HOLE_START + n]);
+    for (i = LOW_TEST_HOLE_START + TEST_SET_SIZE; i < LOW_TEST_HOLE_END; i++)
+        assert(yalloc_block(&pool, &our_block) == 0 && our_block == blocks[i]);
+    assert(yalloc_block(&pool, &our_block) == 0 && our_block == blocks[LOW_TEST_BLOCKS - 1]);
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+    printf("                                           Done!\n");
+
+    printf("   testing batch free & reset\n");
+    assert(yfree_blocks(&pool, TEST_SET_SIZE, &blocks[100]) == TEST_SET_SIZE);
+    assert(yalloc_block(&pool, &our_block) == 0 && our_block == blocks[100]);
+    assert(ypool_reset(&pool) == 0);
+    assert(yalloc_block(&pool, &our_block) == 0 && our_block == blocks[0]);
+    assert(yfree_block(&pool, our_block) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing threads\n");
+    for (n = 0; n < LOW_TEST_THREADS; n++)
+        pthread_create(&thread_id[n], NULL, lowfirst_thread, &pool);
+    for (n = 0; n < LOW_TEST_THREADS; n++)
+        pthread_join(thread_id[n], NULL);
+
+    /* live blocks were always at the front of the arena */
+    assert(yalloc_block(&pool, &our_block) == 0 && our_block == blocks[0]);
+    assert(yalloc_block(&pool, &our_block) == 0 && our_block == blocks[1]);
+    printf("                                           Done!\n");
+
+    free(blocks);
+
+    printf("[Lowest-first pool test] Passed!\n");
+    return 0;
+}
+
+/* return: resident pages of [from, to) */
+size_t resident_pages(AD_POINTER from, AD_POINTER to)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t lo = (uintptr_t)from & ~(page - 1);
+    size_t pages = ((uintptr_t)to - lo + page - 1) / page;
+    unsigned char *vec = malloc(pages);
+    size_t resident = 0;
+    size_t i;
+
+    assert(mincore((void *)lo, (uintptr_t)to - lo, vec) == 0);
+    for (i = 0; i < pages; i++)
+        resident += vec[i] & 1;
+
+    free(vec);
+    return resident;
+}
+
+int test_ypool_trim(uint32_t flags){
+    printf("\n[Trim test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, BLOCK_SIZE * TRIM_TEST_BLOCKS, NULL, 0};
+    ypool_STC lockfree = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    AD_POINTER *blocks = malloc(sizeof(AD_POINTER) * TRIM_TEST_BLOCKS);
+    AD_POINTER our_block;
+    AD_POINTER arena_end;
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t released;
+    size_t half = TRIM_TEST_BLOCKS / 2;
+    size_t i;
+
+    lockfree.flags = YPOOL_FLAG_LOCKFREE;
+    assert(ypool_trim(&lockfree, &released) == -EINVAL);
+    assert(ypool_init(&lockfree) == 0);
+    assert(ypool_trim(&lockfree, &released) == -ENOTSUP && released == 0);
+
+    pool.flags = flags;
+    assert(ypool_init(&pool) == 0);
+
+    /* formatted free list is unlinked whole, TRIM_TEST_BLOCKS % 64 == 0: bitmap has no padding bits past the pool end */
+    printf("   testing trim of empty pool\n");
+    assert(ypool_trim(&pool, &released) == 0);
+    assert(released > TRIM_TEST_BLOCKS * BLOCK_SIZE - 2 * page && released % page == 0);
+    assert(ypool_trim(&pool, &released) == 0);
+    printf("                                           Done!\n");
+
+    for (i = 0; i < TRIM_TEST_BLOCKS; i++){
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+        memcpy(blocks[i], test_set, BLOCK_SIZE);
+    }
+    arena_end = blocks[TRIM_TEST_BLOCKS - 1] + BLOCK_SIZE;
+
+    printf("   testing nothing to trim in full pool\n");
+    assert(ypool_trim(&pool, &released) == 0 && released == 0);
+    printf("                                           Done!\n");
+
+    if (flags & YPOOL_FLAG_LOWFIRST){
+        printf("   testing release of free runs\n");
+        /* upper half & a hole of several pages in the lower half */
+        for (i = half; i < TRIM_TEST_BLOCKS; i++)
+            assert(yfree_block(&pool, blocks[i]) == 0);
+        for (i = half / 4; i < half / 2; i++)
+            assert(yfree_block(&pool, blocks[i]) == 0);
+
+        assert(ypool_trim(&pool, &released) == 0);
+        assert(released >= (half + half / 4) * (BLOCK_SIZE + sizeof(AD_POINTER)) / 2 && released % page == 0);
+        assert(resident_pages(blocks[half] + page, arena_end - page) == 0);
+        assert(resident_pages(blocks[half / 4] + page, blocks[half / 2] - page) == 0);
+
+        /* live blocks keep their data */
+        for (i = 0; i < half / 4; i++)
+            assert(memcmp(blocks[i], test_set, BLOCK_SIZE) == 0);
+        for (i = half / 2; i < half; i++)
+            assert(memcmp(blocks[i], test_set, BLOCK_SIZE) == 0);
+
+        /* lowest-first order reuses the hole & keeps released tail cold */
+        for (i = half / 4; i < half / 2; i++)
+            assert(yalloc_block(&pool, &our_block) == 0 && our_block == blocks[i]);
+        assert(resident_pages(blocks[half] + page, arena_end - page) == 0);
+        for (i = half; i < TRIM_TEST_BLOCKS; i++)
+            assert(yalloc_block(&pool, &our_block) == 0 && our_block == blocks[i]);
+        assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+        printf("                                           Done!\n");
+
+        printf("   testing automatic trim\n");
+        pool.trim_threshold = (TRIM_TEST_BLOCKS - half) * (blocks[1] - blocks[0]); /* block stride */
+        for (i = half; i < TRIM_TEST_BLOCKS; i++)
+            memset(blocks[i], 0xA5, BLOCK_SIZE);
+        for (i = half; i < TRIM_TEST_BLOCKS; i++)
+            assert(yfree_block(&pool, blocks[i]) == 0);
+        assert(resident_pages(blocks[half] + page, arena_end - page) == 0); /* the last free reaches the threshold */
+        pool.trim_threshold = 0;
+        printf("                                           Done!\n");
+    }else{
+        printf("   testing release of free tail after burst\n");
+        /* upper half & a hole in the lower half, free list links live in free blocks */
+        for (i = half; i < TRIM_TEST_BLOCKS; i++)
+            assert(yfree_block(&pool, blocks[i]) == 0);
+        for (i = half / 4; i < half / 2; i++)
+            assert(yfree_block(&pool, blocks[i]) == 0);
+
+        assert(ypool_trim(&pool, &released) == 0);
+        assert(released >= half * BLOCK_SIZE - page && released % page == 0);
+        assert(resident_pages(blocks[half] + page, arena_end - page) == 0);
+
+        /* live blocks keep their data, hole & tail are handed out again */
+        for (i = 0; i < half / 4; i++)
+            assert(memcmp(blocks[i], test_set, BLOCK_SIZE) == 0);
+        for (i = half / 2; i < half; i++)
+            assert(memcmp(blocks[i], test_set, BLOCK_SIZE) == 0);
+        for (i = half / 4; i < half / 2; i++)
+            assert(yalloc_block(&pool, &our_block) == 0);
+        for (i = half; i < TRIM_TEST_BLOCKS; i++)
+            assert(yalloc_block(&pool, &our_block) == 0);
+        assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+        printf("                                           Done!\n");
+
+        printf("   testing release of never used blocks after reset\n");
+        assert(ypool_reset(&pool) == 0);
+        assert(ypool_trim(&pool, &released) == 0);
+        assert(released >= TRIM_TEST_BLOCKS * (BLOCK_SIZE + sizeof(AD_POINTER)) - page);
+        assert(resident_pages(blocks[0] + page, arena_end - page) == 0);
+
+        for (i = 0; i < TRIM_TEST_BLOCKS; i++)
+            assert(yalloc_block(&pool, &our_block) == 0);
+        assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+        printf("                                           Done!\n");
+    }
+
+    free(blocks);
+
+    printf("[Trim test] Passed!\n");
+    return 0;
+}
+
+/* return: true if all bytes of block are zero */
+bool block_is_zero(AD_POINTER block, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        if (((uint8_t *)block)[i] != 0)
+            return false;
+
+    return true;
+}
+
+int test_yalloc_zeroed(uint32_t flags){
+    printf("\n[Zeroed allocation test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, ZERO_TEST_BLOCK_SIZE, ZERO_TEST_BLOCK_SIZE * ZERO_TEST_BLOCKS, NULL, 0};
+    ypool_STC big = {NULL, ZERO_TEST_BIG_SIZE, ZERO_TEST_BIG_SIZE * ZERO_TEST_BIG_BLOCKS, NULL, 0};
+    ypool_STC growable = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    AD_POINTER *blocks = malloc(sizeof(AD_POINTER) * ZERO_TEST_BLOCKS);
+    AD_POINTER our_block;
+    AD_POINTER next_block;
+    size_t stride = ZERO_TEST_BLOCK_SIZE + ((flags & YPOOL_FLAG_COMPACT) ? 0 : sizeof(AD_POINTER));
+    bool tracked = (flags & YPOOL_FLAG_ZEROTRACK) && (flags & YPOOL_FLAG_MMAP);
+    size_t count;
+    size_t i;
+
+    growable.flags = YPOOL_FLAG_ZEROTRACK | YPOOL_FLAG_GROWABLE;
+    assert(ypool_init(&growable) == -EINVAL);
+
+    pool.flags = flags;
+    assert(ypool_init(&pool) == 0);
+
+    assert(yalloc_block_zeroed(&pool, &blocks[0]) == 0);
+    assert(block_is_zero(blocks[0], ZERO_TEST_BLOCK_SIZE));
+
+    /* thread cache takes blocks in batches, its order is not the arena order */
+    if (!(flags & YPOOL_FLAG_TCACHE)){
+        printf("   testing never used block\n");
+        /* known zero block is handed out as is: mark it behind allocator's back (link of compact pool is cleared) */
+        next_block = blocks[0] + stride;
+        ((uint8_t *)next_block)[ZERO_TEST_BLOCK_SIZE - 1] = 0xA5;
+
+        assert(yalloc_block_zeroed(&pool, &our_block) == 0 && our_block == next_block);
+        assert(((uint8_t *)our_block)[ZERO_TEST_BLOCK_SIZE - 1] == (tracked ? 0xA5 : 0));
+        assert(block_is_zero(our_block, ZERO_TEST_BLOCK_SIZE - 1));
+        assert(yfree_block(&pool, our_block) == 0);
+        printf("                                           Done!\n");
+    }
+
+    printf("   testing freed block\n");
+    memset(blocks[0], 0xA5, ZERO_TEST_BLOCK_SIZE);
+    assert(yfree_block(&pool, blocks[0]) == 0);
+    assert(yalloc_block_zeroed(&pool, &our_block) == 0 && our_block == blocks[0]);
+    assert(block_is_zero(our_block, ZERO_TEST_BLOCK_SIZE));
+    assert(yfree_block(&pool, our_block) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing blocks dropped by reset\n");
+    for (count = 0; yalloc_block(&pool, &blocks[count]) == 0; count++)
+        memset(blocks[count], 0xA5, ZERO_TEST_BLOCK_SIZE);
+    assert(count == ZERO_TEST_BLOCKS);
+
+    assert(ypool_reset(&pool) == 0);
+
+    for (i = 0; i < ZERO_TEST_BLOCKS; i++){
+        assert(yalloc_block_zeroed(&pool, &blocks[i]) == 0);
+        assert(block_is_zero(blocks[i], ZERO_TEST_BLOCK_SIZE));
+    }
+    assert(yalloc_block_zeroed(&pool, &our_block) == -ENOMEM);
+    printf("                                           Done!\n");
+
+    /* pages of free blocks (lowest-first) or of blocks behind the bump cursor are released */
+    if (tracked && (flags & (YPOOL_FLAG_LOWFIRST | YPOOL_FLAG_LAZY)) && !(flags & (YPOOL_FLAG_LOCKFREE | YPOOL_FLAG_TCACHE))){
+        printf("   testing trimmed blocks\n");
+        for (i = 0; i < ZERO_TEST_BLOCKS; i++){
+            memset(blocks[i], 0xA5, ZERO_TEST_BLOCK_SIZE);
+            assert(yfree_block(&pool, blocks[i]) == 0);
+        }
+
+        if (flags & YPOOL_FLAG_LAZY)
+            assert(ypool_reset(&pool) == 0);
+
+        assert(ypool_trim(&pool, NULL) == 0);
+
+        /* block in the middle of released pages is known zero again */
+        next_block = blocks[ZERO_TEST_BLOCKS / 2];
+        ((uint8_t *)next_block)[ZERO_TEST_BLOCK_SIZE - 1] = 0xA5;
+
+        for (i = 0; i < ZERO_TEST_BLOCKS; i++){
+            assert(yalloc_block_zeroed(&pool, &our_block) == 0 && our_block == blocks[i]);
+            assert(block_is_zero(our_block, ZERO_TEST_BLOCK_SIZE - 1));
+            assert(((uint8_t *)our_block)[ZERO_TEST_BLOCK_SIZE - 1] == ((our_block == next_block) ? 0xA5 : 0));
+        }
+        printf("                                           Done!\n");
+    }
+
+    if (!(flags & YPOOL_FLAG_ZEROTRACK)){
+        printf("   testing big blocks\n");
+        assert(ypool_init(&big) == 0);
+
+        for (i = 0; i < ZERO_TEST_BIG_BLOCKS; i++){
+            assert(yalloc_block(&big, &blocks[i]) == 0);
+            memset(blocks[i], 0xA5, ZERO_TEST_BIG_SIZE);
+        }
+
+        /* neighbours keep their content */
+        assert(yfree_block(&big, blocks[1]) == 0);
+        assert(yalloc_block_zeroed(&big, &our_block) == 0 && our_block == blocks[1]);
+        assert(block_is_zero(our_block, ZERO_TEST_BIG_SIZE));
+        assert(((uint8_t *)blocks[0])[ZERO_TEST_BIG_SIZE - 1] == 0xA5 && ((uint8_t *)blocks[2])[0] == 0xA5);
+        printf("                                           Done!\n");
+    }
+
+    free(blocks);
+
+    printf("[Zeroed allocation test] Passed!\n");
+    return 0;
+}
+
+/* one call site for several allocations */
+__attribute__((noinline)) int trace_alloc_site(ypool_STC *pool, AD_POINTER *block)
+{
+    return yalloc_block(pool, block);
+}
+
+typedef struct _trace_arg
+{
+    ypool_STC         * pool;
+    int                 pairs;
+    pthread_barrier_t * done;
+}trace_arg_STC;
+
+void *trace_thread(void *vargp)
+{
+    trace_arg_STC * arg = vargp;
+    AD_POINTER block;
+    int n;
+
+    for (n = 0; n < arg->pairs; n++){
+        assert(yalloc_block(arg->pool, &block) == 0);
+        assert(yfree_block(arg->pool, block) == 0);
+    }
+
+    /* all rings are owned at once */
+    if (arg->done != NULL)
+        pthread_barrier_wait(arg->done);
+
+    return NULL;
+}
+
+/* return: events of the dump, header is filled */
+ytrace_event_STC *trace_dump(ypool_STC *pool, ytrace_header_STC *header)
+{
+    FILE *file = tmpfile();
+    ytrace_event_STC *events;
+
+    assert(file != NULL);
+    assert(ypool_trace_dump(pool, fileno(file)) == 0);
+
+    rewind(file);
+    assert(fread(header, sizeof(*header), 1, file) == 1);
+    assert(header->magic == YTRACE_MAGIC && header->version == YTRACE_VERSION && header->event_size == sizeof(ytrace_event_STC));
+
+    events = malloc((header->events + 1) * sizeof(ytrace_event_STC));
+    assert(fread(events, sizeof(ytrace_event_STC), header->events, file) == header->events);
+    assert(fgetc(file) == EOF);
+
+    fclose(file);
+    return events;
+}
+
+int test_ypool_trace(uint32_t flags){
+    printf("\n[Tracing test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, TRACE_TEST_POOL_SIZE, NULL, 0};
+    ypool_STC untraced = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    pthread_t threads[TRACE_TEST_THREADS + 1];
+    trace_arg_STC args[TRACE_TEST_THREADS + 1];
+    pthread_barrier_t done;
+    ytrace_header_STC header;
+    ytrace_event_STC *events;
+    AD_POINTER blocks[2];
+    uint32_t main_thread = gettid();
+    size_t per_thread[TRACE_TEST_THREADS + 1];
+    uint32_t tids[TRACE_TEST_THREADS + 1];
+    size_t seen = 0;
+    size_t i, t;
+
+    untraced.flags = flags;
+    assert(ypool_init(&untraced) == 0);
+    assert(ypool_trace_dump(&untraced, STDOUT_FILENO) == -ENOTSUP);
+
+    pool.flags = flags | YPOOL_FLAG_TRACE;
+    assert(ypool_trace_dump(&pool, STDOUT_FILENO) == -EINVAL);
+    assert(ypool_init(&pool) == 0);
+
+    printf("   testing events of calling thread\n");
+    events = trace_dump(&pool, &header);
+    assert(header.events == 0 && header.lost == 0 && header.block_size == BLOCK_SIZE);
+    free(events);
+
+    assert(trace_alloc_site(&pool, &blocks[0]) == 0);
+    assert(trace_alloc_site(&pool, &blocks[1]) == 0);
+    assert(yfree_block(&pool, blocks[0]) == 0);
+    assert(yfree_block(&pool, blocks[0]) == -EALREADY);
+    assert(yfree_blocks(&pool, 1, &blocks[1]) == 1);
+
+    events = trace_dump(&pool, &header);
+    assert(header.events == 5 && header.lost == 0);
+    assert(header.dump_ns > header.start_ns && header.dump_ticks > header.start_ticks);
+
+    for (i = 0; i < 5; i++){
+        assert(events[i].thread == main_thread);
+        assert(i == 0 || events[i].ticks >= events[i - 1].ticks);
+    }
+    assert(events[0].op == YTRACE_ALLOC && events[0].ret == 0 && events[0].block == (uint64_t)(uintptr_t)blocks[0]);
+    assert(events[1].op == YTRACE_ALLOC && events[1].ret == 0 && events[1].block == (uint64_t)(uintptr_t)blocks[1]);
+    assert(events[2].op == YTRACE_FREE && events[2].ret == 0 && events[2].block == (uint64_t)(uintptr_t)blocks[0]);
+    assert(events[3].op == YTRACE_FREE && events[3].ret == -EALREADY);
+    assert(events[4].op == YTRACE_FREE && events[4].ret == 0 && events[4].block == (uint64_t)(uintptr_t)blocks[1]);
+
+    /* call site is the return address in the caller */
+    assert(events[0].caller != 0 && events[0].caller == events[1].caller);
+    assert(events[2].caller != events[0].caller && events[2].caller != events[3].caller);
+    free(events);
+    printf("                                           Done!\n");
+
+    printf("   testing rings of %d threads\n", TRACE_TEST_THREADS);
+    pthread_barrier_init(&done, NULL, TRACE_TEST_THREADS);
+    for (t = 0; t < TRACE_TEST_THREADS; t++){
+        args[t].pool = &pool;
+        args[t].pairs = TRACE_TEST_PAIRS;
+        args[t].done = &done;
+        pthread_create(&threads[t], NULL, trace_thread, &args[t]);
+    }
+    for (t = 0; t < TRACE_TEST_THREADS; t++)
+        pthread_join(threads[t], NULL);
+    pthread_barrier_destroy(&done);
+
+    /* ring of exited thread is reused, its newest events are kept */
+    args[t].pool = &pool;
+    args[t].pairs = 1;
+    args[t].done = NULL;
+    pthread_create(&threads[t], NULL, trace_thread, &args[t]);
+    pthread_join(threads[t], NULL);
+
+    events = trace_dump(&pool, &header);
+    assert(header.events == 5 + TRACE_TEST_THREADS * (YPOOL_TRACE_EVENTS - 1));
+    assert(header.lost == TRACE_TEST_THREADS * 2 * TRACE_TEST_PAIRS + 2 + 5 - header.events);
+
+    memset(per_thread, 0, sizeof(per_thread));
+    for (i = 0; i < header.events; i++){
+        if (events[i].thread == main_thread)
+            continue;
+
+        for (t = 0; t < seen && tids[t] != events[i].thread; t++);
+        if (t == seen)
+            tids[seen++] = events[i].thread;
+
+        assert(seen <= TRACE_TEST_THREADS + 1);
+        per_thread[t]++;
+
+        /* ring order: alloc/free pairs of the same block */
+        assert(events[i].ret == 0);
+        if (i > 0 && events[i - 1].thread == events[i].thread){
+            assert(events[i].op != events[i - 1].op && events[i].ticks >= events[i - 1].ticks);
+            assert(events[i].op == YTRACE_ALLOC || events[i].block == events[i - 1].block);
+        }
+    }
+    assert(seen == TRACE_TEST_THREADS + 1);
+    for (t = 0; t < seen; t++)
+        assert(per_thread[t] == YPOOL_TRACE_EVENTS - 1 || per_thread[t] == YPOOL_TRACE_EVENTS - 3 || per_thread[t] == 2);
+    free(events);
+    printf("                                           Done!\n");
+
+    printf("[Tracing test] Passed!\n");
+    return 0;
+}
+
+typedef struct _visit_arg
+{
+    AD_POINTER * blocks;
+    size_t       count;
+    size_t       stop_at;  /* 0 - visit all */
+}visit_arg_STC;
+
+int visit_block(AD_POINTER block, void *ctx)
+{
+    visit_arg_STC * arg = ctx;
+
+    arg->blocks[arg->count++] = block;
+
+    return (arg->count == arg->stop_at) ? 5 : 0;
+}
+
+int compare_blocks(const void *a, const void *b)
+{
+    AD_POINTER x = *(const AD_POINTER *)a;
+    AD_POINTER y = *(const AD_POINTER *)b;
+
+    return (x > y) - (x < y);
+}
+
+volatile int churn_stop = 0;
+
+void *churn_thread(void *vargp)
+{
+    ypool_STC * pool = vargp;
+    AD_POINTER blocks[ITER_TEST_CHURN_BLOCKS];
+    int i, n;
+
+    while (!churn_stop){
+        for (n = 0; n < ITER_TEST_CHURN_BLOCKS && yalloc_block(pool, &blocks[n]) == 0; n++);
+        for (i = 0; i < n; i++)
+            assert(yfree_block(pool, blocks[i]) == 0);
+    }
+
+    return NULL;
+}
+
+int test_ypool_for_each(uint32_t flags){
+    printf("\n[Live blocks iteration test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, ITER_TEST_POOL_SIZE, NULL, 0};
+    ypool_STC growable = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    size_t blocks_count = ITER_TEST_POOL_SIZE/BLOCK_SIZE;
+    AD_POINTER *blocks = malloc(sizeof(AD_POINTER) * blocks_count);
+    AD_POINTER *seen = malloc(sizeof(AD_POINTER) * blocks_count);
+    ypool_cursor_STC cursor;
+    visit_arg_STC arg = {seen, 0, 0};
+    pthread_t thread_id;
+    size_t live = 0;
+    size_t i;
+    int walk;
+    int found;
+
+    growable.flags = YPOOL_FLAG_GROWABLE;
+    assert(ypool_init(&growable) == 0);
+    assert(ypool_for_each_allocated(&growable, visit_block, &arg) == -ENOTSUP);
+
+    pool.flags = flags;
+    assert(ypool_cursor_init(&pool, &cursor) == -EINVAL);
+    assert(ypool_init(&pool) == 0);
+    assert(ypool_for_each_allocated(&pool, NULL, NULL) == -EFAULT);
+    assert(ypool_cursor_init(&pool, NULL) == -EFAULT);
+
+    printf("   testing empty pool\n");
+    assert(ypool_for_each_allocated(&pool, visit_block, &arg) == 0 && arg.count == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing every allocated block is visited once\n");
+    for (i = 0; i < blocks_count; i++)
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+
+    /* leave holes: every 3rd block & the whole second quarter */
+    for (i = 0; i < blocks_count; i++){
+        if (i % 3 == 0 || (i >= blocks_count / 4 && i < blocks_count / 2))
+            assert(yfree_block(&pool, blocks[i]) == 0);
+        else
+            blocks[live++] = blocks[i];
+    }
+
+    assert(ypool_for_each_allocated(&pool, visit_block, &arg) == 0);
+    assert(arg.count == live);
+    for (i = 1; i < arg.count; i++)
+        assert(seen[i - 1] < seen[i]); /* address order */
+
+    qsort(blocks, live, sizeof(AD_POINTER), compare_blocks);
+    assert(memcmp(blocks, seen, sizeof(AD_POINTER) * live) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing cursor batches & stop\n");
+    assert(ypool_cursor_init(&pool, &cursor) == 0);
+    assert(ypool_cursor_next(&cursor, 0, seen) == -EINVAL);
+    for (i = 0; (found = ypool_cursor_next(&cursor, ITER_TEST_CURSOR_BATCH, &seen[i])) > 0; i += found)
+        assert(found <= ITER_TEST_CURSOR_BATCH);
+    assert(found == 0 && i == live);
+    assert(memcmp(blocks, seen, sizeof(AD_POINTER) * live) == 0);
+
+    arg.count = 0;
+    arg.stop_at = 3;
+    assert(ypool_for_each_allocated(&pool, visit_block, &arg) == 5 && arg.count == 3);
+    arg.stop_at = 0;
+    printf("                                           Done!\n");
+
+    printf("   testing walks during allocation\n");
+    churn_stop = 0;
+    pthread_create(&thread_id, NULL, churn_thread, &pool);
+    for (walk = 0; walk < ITER_TEST_WALKS; walk++){
+        arg.count = 0;
+        assert(ypool_for_each_allocated(&pool, visit_block, &arg) == 0);
+        assert(arg.count >= live && arg.count <= live + ITER_TEST_CHURN_BLOCKS + (flags & YPOOL_FLAG_TCACHE ? YTCACHE_SIZE : 0));
+
+        /* blocks allocated for the whole walk are visited */
+        for (i = 0; i < live; i++)
+            assert(bsearch(&blocks[i], seen, arg.count, sizeof(AD_POINTER), compare_blocks) != NULL);
+    }
+    churn_stop = 1;
+    pthread_join(thread_id, NULL);
+    printf("                                           Done!\n");
+
+    free(blocks);
+    free(seen);
+
+    printf("[Live blocks iteration test] Passed!\n");
+    return 0;
+}
+
+int test_ypool_numa(uint32_t flags){
+    printf("\n[NUMA pool test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, NUMA_TEST_POOL_SIZE, NULL, 0};
+    ypool_STC bad = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    ypool_stats_STC stats, node_stats;
+    AD_POINTER blocks[NUMA_TEST_POOL_SIZE/BLOCK_SIZE];
+    AD_POINTER our_block;
+    cpu_set_t old_cpus, cpus;
+    unsigned int cpu, node;
+    size_t blocks_count = NUMA_TEST_POOL_SIZE/BLOCK_SIZE;
+    size_t node_blocks = 0;
+    size_t local = 0;
+    uint32_t i;
+    size_t j;
+
+    bad.flags = YPOOL_FLAG_NUMA | YPOOL_FLAG_GROWABLE;
+    assert(ypool_init(&bad) == -EINVAL);
+
+    pool.flags = flags;
+    assert(ypool_init(&pool) == 0);
+    assert(pool.numa_nodes >= 1 && pool.numa_pools != NULL);
+    assert(ypool_init(&pool) == -EALREADY);
+
+    printf("   %u node(s), arena backing 0x%x\n", pool.numa_nodes, pool.backing);
+    for (i = 0; i < pool.numa_nodes; i++){
+        assert(pool.numa_pools[i].numa_node == i);
+        assert(pool.numa_pools[i].backing & YPOOL_BACKING_MMAP);
+        node_blocks += pool.numa_pools[i].total_blocks;
+    }
+    assert(node_blocks == blocks_count && pool.total_blocks == blocks_count);
+
+    /* stay on one cpu, so caller's node is known */
+    assert(sched_getaffinity(0, sizeof(old_cpus), &old_cpus) == 0);
+    assert(getcpu(&cpu, &node) == 0);
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    assert(sched_setaffinity(0, sizeof(cpus), &cpus) == 0);
+    node %= pool.numa_nodes;
+
+    printf("   testing local node allocation\n");
+    assert(yalloc_block(&pool, &our_block) == 0);
+    assert(our_block >= pool.numa_pools[node].start_PTR && our_block < pool.numa_pools[node].start_PTR + pool.numa_pools[node].arena_size);
+    assert(yfree_block(&pool, our_block) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing spill over all nodes\n");
+    for (j = 0; j < blocks_count; j++){
+        assert(yalloc_block(&pool, &blocks[j]) == 0);
+        memcpy(blocks[j], test_set, BLOCK_SIZE);
+        if (blocks[j] >= pool.numa_pools[node].start_PTR && blocks[j] < pool.numa_pools[node].start_PTR + pool.numa_pools[node].arena_size)
+            local++;
+    }
+    assert(local == pool.numa_pools[node].total_blocks);
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+    assert(yalloc_blocks(&pool, 2, &our_block) == -ENOMEM);
+    if (STATS == 1)
+        assert(ypool_get_stats(&pool, &stats) == 0);
+    assert(yalloc_block_wait(&pool, &our_block, WAIT_TEST_SHORT_US) == -ETIMEDOUT);
+    if (STATS == 1){
+        assert(ypool_get_stats(&pool, &node_stats) == 0);
+        assert(node_stats.enomem == stats.enomem); /* timed out wait is not -ENOMEM */
+    }
+    printf("                                           Done!\n");
+
+    printf("   testing free to owner node\n");
+    our_block = &cpu;
+    assert(yfree_block(&pool, our_block) == -EXDEV);
+    assert(yfree_blocks(&pool, 1, &our_block) == -EXDEV);
+    for (j = 0; j < blocks_count; j++)
+        assert(memcmp(blocks[j], test_set, BLOCK_SIZE) == 0);
+    assert(yfree_block(&pool, blocks[0]) == 0);
+    assert(yfree_block(&pool, blocks[0]) == -EALREADY);
+    assert(yfree_blocks(&pool, blocks_count, blocks) == blocks_count - 1);
+    assert(yalloc_blocks(&pool, blocks_count, blocks) == blocks_count);
+    assert(yfree_blocks(&pool, blocks_count, blocks) == blocks_count);
+    printf("                                           Done!\n");
+
+    assert(sched_setaffinity(0, sizeof(old_cpus), &old_cpus) == 0);
+
+    if (STATS == 1){
+        printf("   testing per node statistics\n");
+        assert(ypool_get_node_stats(&pool, pool.numa_nodes, &node_stats) == -EINVAL);
+        assert(ypool_get_node_stats(&bad, 0, &node_stats) == -EINVAL);
+        assert(ypool_get_stats(&pool, &stats) == 0);
+        assert(stats.total_blocks == blocks_count && stats.used_blocks == 0);
+        assert(ypool_get_node_stats(&pool, node, &node_stats) == 0);
+        assert(node_stats.total_blocks == pool.numa_pools[node].total_blocks);
+        assert(node_stats.allocs >= local && node_stats.frees == node_stats.allocs);
+        printf("                                           Done!\n");
+    }
+
+    printf("[NUMA pool test] Passed!\n");
+    return 0;
+}
+
+int test_yheap(uint32_t flags){
+    printf("\n[Size class heap test] Start (flags=0x%x)\n", flags);
+
+    yheap_STC heap = {0};
+    yheap_class_stats_STC stats[YHEAP_CLASS_COUNT];
+    AD_POINTER blocks[YHEAP_TEST_POOL_SIZE / YHEAP_MIN_SIZE];
+    AD_POINTER our_block;
+    size_t size, capacity;
+    int i;
+
+    printf("   initializing heap\n");
+    heap.class_pool_size = YHEAP_TEST_POOL_SIZE;
+    heap.flags = flags | YPOOL_FLAG_GROWABLE;
+    assert(yheap_init(&heap) == -EINVAL);
+    heap.flags = flags;
+    assert(yheap_init(&heap) == 0);
+    assert(yheap_init(&heap) == -EALREADY);
+    printf("                                           Done!\n");
+
+    printf("   testing size to class mapping\n");
+    assert(yheap_alloc(&heap, 0, &our_block) == -EINVAL);
+    assert(yheap_alloc(&heap, YHEAP_MAX_SIZE + 1, &our_block) == -E2BIG);
+    for(size = 1; size <= YHEAP_MAX_SIZE; size++){
+        assert(yheap_alloc(&heap, size, &our_block) == 0);
+        memset(our_block, 0xA5, size);
+        assert(yheap_get_stats(&heap, stats) == YHEAP_CLASS_COUNT);
+        for(i = 0; stats[i].used == 0; i++)
+            ;
+        /* smallest fitting class, at most 25% above requested size (16 byte steps below 64) */
+        assert(stats[i].block_size >= size);
+        assert(i == 0 || stats[i - 1].block_size < size);
+        assert(stats[i].block_size - size < YHEAP_MIN_SIZE || (stats[i].block_size - size) * 4 <= stats[i].block_size);
+        assert(yheap_free(&heap, our_block) == 0);
+    }
+    printf("                                           Done!\n");
+
+    printf("   testing class exhaustion & stats\n");
+    assert(yheap_get_stats(&heap, stats) == YHEAP_CLASS_COUNT);
+    capacity = stats[0].capacity;
+    assert(capacity == YHEAP_TEST_POOL_SIZE / YHEAP_MIN_SIZE);
+    for(i = 0; i < capacity; i++)
+        assert(yheap_alloc(&heap, YHEAP_MIN_SIZE, &blocks[i]) == 0);
+    assert(yheap_alloc(&heap, 1, &our_block) == -ENOMEM);
+    assert(yheap_alloc(&heap, YHEAP_MIN_SIZE + 1, &our_block) == 0);
+    assert(yheap_get_stats(&heap, stats) == YHEAP_CLASS_COUNT);
+    assert(stats[0].used == capacity && stats[0].peak == capacity && stats[0].failures == 1);
+    assert(stats[1].used == 1);
+    printf("                                           Done!\n");
+
+    printf("   testing free errors\n");
+    assert(yheap_free(&heap, (AD_POINTER)&our_block) == -EXDEV);
+    assert(yheap_free(&heap, our_block) == 0);
+    assert(yheap_free(&heap, our_block) == -EALREADY);
+    for(i = 0; i < capacity; i++)
+        assert(yheap_free(&heap, blocks[i]) == 0);
+    assert(yheap_get_stats(&heap, stats) == YHEAP_CLASS_COUNT);
+    for(i = 0; i < YHEAP_CLASS_COUNT; i++)
+        assert(stats[i].used == 0 && stats[i].allocs == stats[i].frees);
+    assert(stats[0].peak == capacity);
+    printf("                                           Done!\n");
+
+    printf("   testing default heap\n");
+    assert(yalloc(YHEAP_MAX_SIZE, &our_block) == 0);
+    memset(our_block, 0xA5, YHEAP_MAX_SIZE);
+    assert(yfree((AD_POINTER)&our_block) == -EXDEV);
+    assert(yfree(our_block) == 0);
+    assert(yfree(our_block) == -EALREADY);
+    printf("                                           Done!\n");
+
+    printf("[Size class heap test] Passed!\n");
+    return 0;
+}
+
+typedef struct _wait_arg
+{
+    ypool_STC * pool;
+    AD_POINTER  block;
+    int         ret;
+    int         order;  /* position in which waiter got its block */
+}wait_arg_STC;
+
+volatile int wait_served = 0;
+
+void *wait_thread(void *vargp)
+{
+    wait_arg_STC *arg = vargp;
+
+    arg->ret = yalloc_block_wait(arg->pool, &arg->block, WAIT_TEST_TIMEOUT_US);
+    arg->order = __atomic_fetch_add(&wait_served, 1, __ATOMIC_SEQ_CST);
+
+    return NULL;
+}
+
+int test_yalloc_wait(uint32_t flags){
+    printf("\n[Blocking allocation test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    AD_POINTER blocks[POOL_SIZE/BLOCK_SIZE];
+    AD_POINTER our_block;
+    wait_arg_STC args[WAIT_TEST_THREADS];
+    pthread_t threads[WAIT_TEST_THREADS];
+    ypool_stats_STC stats;
+    struct timespec start, end;
+    long elapsed_us;
+    int i;
+
+    pool.flags = flags;
+    assert(ypool_init(&pool) == 0);
+
+    printf("   testing free pool is not waiting\n");
+    assert(yalloc_block_wait(&pool, &our_block, WAIT_TEST_TIMEOUT_US) == 0);
+    assert(yfree_block(&pool, our_block) == 0);
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++)
+        assert(yalloc_block_wait(&pool, &blocks[i], 0) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing timeout of exhausted pool\n");
+    assert(yalloc_block_wait(&pool, &our_block, 0) == -ENOMEM);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    assert(yalloc_block_wait(&pool, &our_block, WAIT_TEST_SHORT_US) == -ETIMEDOUT);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed_us = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    assert(elapsed_us >= WAIT_TEST_SHORT_US);
+    assert(pool.waiters == 0 && pool.wait_head == NULL && pool.wait_tail == NULL);
+    printf("                                           Done!\n");
+
+    printf("   testing FIFO hand-over to %d parked threads\n", WAIT_TEST_THREADS);
+    wait_served = 0;
+    for(i = 0; i < WAIT_TEST_THREADS; i++){
+        args[i].pool = &pool;
+        args[i].block = NULL;
+        assert(pthread_create(&threads[i], NULL, wait_thread, &args[i]) == 0);
+        /* park threads one by one, so queue order is known */
+        while (__atomic_load_n(&pool.waiters, __ATOMIC_SEQ_CST) != i + 1)
+            sched_yield();
+    }
+    for(i = 0; i < WAIT_TEST_THREADS; i++){
+        assert(yfree_block(&pool, blocks[i]) == 0);
+        while (__atomic_load_n(&wait_served, __ATOMIC_SEQ_CST) != i + 1)
+            sched_yield();
+    }
+    for(i = 0; i < WAIT_TEST_THREADS; i++){
+        pthread_join(threads[i], NULL);
+        assert(args[i].ret == 0 && args[i].order == i);
+        assert(args[i].block == blocks[i]);
+        memcpy(args[i].block, test_set, BLOCK_SIZE);
+    }
+    assert(pool.waiters == 0 && pool.wait_head == NULL);
+    /* only the call which didn't wait returned -ENOMEM */
+    if (STATS == 1){
+        assert(ypool_get_stats(&pool, &stats) == 0);
+        assert(stats.enomem == 1 && stats.allocs == POOL_SIZE/BLOCK_SIZE + 1 + WAIT_TEST_THREADS);
+    }
+    printf("                                           Done!\n");
+
+    printf("   testing hand-over is a regular allocation\n");
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++)
+        assert(yfree_block(&pool, blocks[i]) == 0);
+    assert(yfree_block(&pool, blocks[0]) == -EALREADY);
+    printf("                                           Done!\n");
+
+    printf("[Blocking allocation test] Passed!\n");
+    return 0;
+}
+
+int test_ypool_shared(uint32_t flags){
+    printf("\n[Shared pool test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool_a = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    ypool_STC pool_b = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    ypool_STC pool_c = {NULL, BLOCK_SIZE * 2, POOL_SIZE, NULL, 0};
+    ypool_STC pool_m = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    AD_POINTER blocks[POOL_SIZE/BLOCK_SIZE];
+    AD_POINTER our_block;
+    char name[64];
+    size_t offset;
+    int pipe_fd[2];
+    int status;
+    pid_t pid;
+    int i, j;
+
+    snprintf(name, sizeof(name), "/yad_test_%d", (int)getpid());
+    shm_unlink(name);
+
+    printf("   checking unsupported flags\n");
+    pool_a.shm_name = name;
+    pool_a.flags = flags | YPOOL_FLAG_TCACHE;
+    assert(ypool_init(&pool_a) == -EINVAL);
+    printf("                                           Done!\n");
+
+    printf("   creating & attaching named pool\n");
+    pool_a.flags = flags;
+    assert(ypool_init(&pool_a) == 0);
+    assert((pool_a.backing & YPOOL_BACKING_SHARED) && (pool_a.flags & YPOOL_FLAG_LOCKFREE));
+    pool_b.shm_name = name;
+    pool_b.flags = flags;
+    assert(ypool_init(&pool_b) == 0);
+    assert(pool_b.start_PTR != pool_a.start_PTR);
+    pool_c.shm_name = name;
+    pool_c.flags = flags;
+    assert(ypool_init(&pool_c) == -EINVAL);
+    printf("                                           Done!\n");
+
+    printf("   testing block hand-over between mappings\n");
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++){
+        assert(yalloc_block(&pool_a, &blocks[i]) == 0);
+        memcpy(blocks[i],test_set,BLOCK_SIZE);
+    }
+    assert(yalloc_block(&pool_a, &our_block) == -ENOMEM);
+    assert(yalloc_block(&pool_b, &our_block) == -ENOMEM);
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++){
+        our_block = pool_b.start_PTR + (blocks[i] - pool_a.start_PTR);
+        assert(memcmp(our_block, test_set, BLOCK_SIZE) == 0);
+        assert(yfree_block(&pool_b, our_block) == 0);
+    }
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++)
+        assert(yfree_block(&pool_a, blocks[i]) == -EALREADY);
+    assert(shm_unlink(name) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing memfd pool shared with child process\n");
+    pool_m.flags = flags;
+    assert(ypool_init(&pool_m) == 0);
+    assert(pool_m.shm_fd > 0);
+    assert(pipe(pipe_fd) == 0);
+
+    pid = fork();
+    assert(pid >= 0);
+
+    if (pid == 0){
+        /* child attaches its own mapping, fills blocks & exits without freeing them */
+        ypool_STC pool_child = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+
+        pool_child.flags = flags;
+        pool_child.shm_fd = pool_m.shm_fd;
+        if (ypool_init(&pool_child) != 0)
+            _exit(1);
+
+        for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++){
+            if (yalloc_block(&pool_child, &our_block) != 0)
+                _exit(2);
+            memset(our_block, i, BLOCK_SIZE);
+            offset = our_block - pool_child.start_PTR;
+            if (write(pipe_fd[1], &offset, sizeof(offset)) != sizeof(offset))
+                _exit(3);
+        }
+        _exit(0);
+    }
+
+    close(pipe_fd[1]);
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(yalloc_block(&pool_m, &our_block) == -ENOMEM);
+
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++){
+        assert(read(pipe_fd[0], &offset, sizeof(offset)) == sizeof(offset));
+        our_block = pool_m.start_PTR + offset;
+        for(j = 0; j < BLOCK_SIZE; j++)
+            assert(((uint8_t*)our_block)[j] == i);
+        assert(yfree_block(&pool_m, our_block) == 0);
+    }
+    close(pipe_fd[0]);
+
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE; i++)
+        assert(yalloc_block(&pool_m, &blocks[i]) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing concurrent attach & detach\n");
+    memset(&pool_a, 0, sizeof(pool_a));
+    pool_a.block_size = BLOCK_SIZE;
+    pool_a.pool_size = POOL_SIZE;
+    pool_a.shm_name = name;
+    pool_a.flags = flags;
+    assert(ypool_init(&pool_a) == 0);
+    assert(ypool_close(&pool_a) == 0);
+
+    for(j = 0; j < SHARED_TEST_CHILDREN; j++){
+        pid = fork();
+        assert(pid >= 0);
+
+        if (pid == 0){
+            /* users come & go cleanly, attach never sees torn pool */
+            for(i = 0; i < SHARED_TEST_ATTACHES; i++){
+                ypool_STC pool_child = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+
+                pool_child.shm_name = name;
+                pool_child.flags = flags;
+                if (ypool_init(&pool_child) != 0)
+                    _exit(1);
+                if (ypool_close(&pool_child) != 0)
+                    _exit(2);
+            }
+            _exit(0);
+        }
+    }
+    for(j = 0; j < SHARED_TEST_CHILDREN; j++){
+        assert(wait(&status) > 0);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    assert(shm_unlink(name) == 0);
+    printf("                                           Done!\n");
+
+    printf("[Shared pool test] Passed!\n");
+    return 0;
+}
+
+int test_ypool_persistent(uint32_t flags){
+    printf("\n[Persistent pool test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    ypool_STC local_pool = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    size_t offsets[POOL_SIZE/BLOCK_SIZE/2];
+    AD_POINTER our_block;
+    char path[64];
+    int status;
+    pid_t pid;
+    int i;
+
+    snprintf(path, sizeof(path), "/tmp/yad_test_%d.pool", (int)getpid());
+    unlink(path);
+
+    printf("   checking pool file is needed\n");
+    pool.flags = flags;
+    assert(ypool_init(&pool) == -EINVAL);
+    assert(ypool_init(&local_pool) == 0);
+    assert(ypool_close(&local_pool) == 0);
+    printf("                                           Done!\n");
+
+    printf("   creating pool file & filling half of it\n");
+    pool.file_path = path;
+    assert(ypool_init(&pool) == 0);
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE/2; i++){
+        assert(yalloc_block(&pool, &our_block) == 0);
+        memset(our_block, i, BLOCK_SIZE);
+        offsets[i] = our_block - pool.start_PTR;
+    }
+    assert(ypool_close(&pool) == 0);
+    assert(pool.start_PTR == NULL);
+    printf("                                           Done!\n");
+
+    printf("   testing warm restart\n");
+    pool.block_size = BLOCK_SIZE * 2;
+    assert(ypool_init(&pool) == -EINVAL);
+    pool.block_size = BLOCK_SIZE;
+    assert(ypool_init(&pool) == 0);
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE/2; i++){
+        our_block = pool.start_PTR + offsets[i];
+        assert(((uint8_t*)our_block)[0] == i && ((uint8_t*)our_block)[BLOCK_SIZE - 1] == i);
+    }
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE - POOL_SIZE/BLOCK_SIZE/2; i++)
+        assert(yalloc_block(&pool, &our_block) == 0);
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+    for(i = 0; i < POOL_SIZE/BLOCK_SIZE/2; i++)
+        assert(yfree_block(&pool, pool.start_PTR + offsets[i]) == 0);
+    assert(yfree_block(&pool, pool.start_PTR + offsets[0]) == -EALREADY);
+    assert(ypool_close(&pool) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing crash detection\n");
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0){
+        /* attach & die without ypool_close() */
+        if (ypool_init(&pool) != 0 || yalloc_block(&pool, &our_block) != 0)
+            _exit(1);
+        _exit(0);
+    }
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(ypool_init(&pool) == -EUCLEAN);
+    assert(pool.start_PTR == NULL);
+    printf("                                           Done!\n");
+
+    assert(unlink(path) == 0);
+
+    printf("[Persistent pool test] Passed!\n");
+    return 0;
+}
+
+typedef struct _peak_arg
+{
+    ypool_STC         * pool;
+    pthread_barrier_t * step;
+    int                 blocks;     /* allocated by holder in the middle step, by churner before & after it */
+    bool                holder;
+}peak_arg_STC;
+
+void *peak_thread(void *vargp)
+{
+    peak_arg_STC * arg = vargp;
+    AD_POINTER blocks[POOL_SIZE/BLOCK_SIZE];
+    int i;
+
+    if (!arg->holder){
+        for(i = 0; i < arg->blocks; i++)
+            assert(yalloc_block(arg->pool, &blocks[i]) == 0);
+        for(i = 0; i < arg->blocks; i++)
+            assert(yfree_block(arg->pool, blocks[i]) == 0);
+    }
+
+    pthread_barrier_wait(arg->step);
+    if (arg->holder)
+        assert(yalloc_block(arg->pool, &blocks[0]) == 0); /* kept allocated */
+    pthread_barrier_wait(arg->step);
+
+    /* churner's shard only reaches its old max, pool count is 1 above it */
+    if (!arg->holder){
+        for(i = 0; i < arg->blocks; i++)
+            assert(yalloc_block(arg->pool, &blocks[i]) == 0);
+        for(i = 0; i < arg->blocks; i++)
+            assert(yfree_block(arg->pool, blocks[i]) == 0);
+    }
+
+    return NULL;
+}
+
+/* return: 0 if peak of new pool is (blocks - 1) allocated by one thread + 1 held by another one */
+int stats_peak_threads(uint32_t flags)
+{
+    ypool_STC pool = {NULL, BLOCK_SIZE, POOL_SIZE * 2, NULL, 0}; /* churner's thread cache doesn't take all blocks */
+    pthread_barrier_t step;
+    peak_arg_STC args[2];
+    pthread_t thread_id[2];
+    ypool_stats_STC stats;
+    int i;
+
+    pool.flags = flags;
+    assert(ypool_init(&pool) == 0);
+
+    pthread_barrier_init(&step, NULL, 2);
+    for(i = 0; i < 2; i++){
+        args[i].pool = &pool;
+        args[i].step = &step;
+        args[i].blocks = POOL_SIZE/BLOCK_SIZE - 1;
+        args[i].holder = (i == 1);
+        pthread_create(&thread_id[i], NULL, peak_thread, &args[i]);
+    }
+    for(i = 0; i < 2; i++)
+        pthread_join(thread_id[i], NULL);
+    pthread_barrier_destroy(&step);
+
+    assert(ypool_get_stats(&pool, &stats) == 0);
+    return (stats.used_blocks == 1 && stats.peak_used == POOL_SIZE/BLOCK_SIZE) ? 0 : -1;
+}
+
+int test_ypool_stats(uint32_t flags){
+    printf("\n[Statistics test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    ypool_stats_STC stats;
+    AD_POINTER blocks[POOL_SIZE/BLOCK_SIZE + 1];
+    AD_POINTER our_block;
+    int blocks_count = POOL_SIZE/BLOCK_SIZE;
+    int i;
+
+    pool.flags = flags;
+    assert(ypool_get_stats(&pool, &stats) == -EINVAL);
+    assert(ypool_init(&pool) == 0);
+    assert(ypool_get_stats(&pool, NULL) == -EFAULT);
+
+    if (STATS != 1){
+        assert(ypool_get_stats(&pool, &stats) == -ENOTSUP);
+        printf("[Statistics test] Skipped (STATS=%d)\n", STATS);
+        return 0;
+    }
+
+    printf("   testing empty pool stats\n");
+    assert(ypool_get_stats(&pool, &stats) == 0);
+    assert(stats.total_blocks == blocks_count && stats.free_blocks == blocks_count);
+    assert(stats.used_blocks == 0 && stats.peak_used == 0 && stats.allocs == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing allocation counters\n");
+    for(i = 0; i < blocks_count; i++)
+        assert(yalloc_block(&pool, &blocks[i]) == 0);
+    assert(yalloc_block(&pool, &our_block) == -ENOMEM);
+    assert(ypool_get_stats(&pool, &stats) == 0);
+    assert(stats.allocs == blocks_count && stats.enomem == 1);
+    assert(stats.used_blocks == blocks_count && stats.free_blocks == 0 && stats.peak_used == blocks_count);
+    printf("                                           Done!\n");
+
+    printf("   testing free counters\n");
+    for(i = 0; i < blocks_count/2; i++)
+        assert(yfree_block(&pool, blocks[i]) == 0);
+    assert(yfree_block(&pool, blocks[0]) == -EALREADY);
+    assert(yfree_block(&pool, (AD_POINTER)&our_block) == -EXDEV);
+    assert(ypool_get_stats(&pool, &stats) == 0);
+    assert(stats.frees == blocks_count/2 && stats.ealready == 1 && stats.exdev == 1);
+    assert(stats.used_blocks == blocks_count - blocks_count/2 && stats.peak_used == blocks_count);
+    printf("                                           Done!\n");
+
+    printf("   testing batch counters\n");
+    blocks[blocks_count] = blocks[blocks_count - 1]; /* duplicate */
+    assert(yfree_blocks(&pool, blocks_count - blocks_count/2 + 1, blocks + blocks_count/2) == blocks_count - blocks_count/2);
+    assert(ypool_get_stats(&pool, &stats) == 0);
+    assert(stats.frees == blocks_count && stats.ealready == 2 && stats.used_blocks == 0);
+    assert(yalloc_blocks(&pool, 2, blocks) == 2);
+    assert(ypool_get_stats(&pool, &stats) == 0);
+    assert(stats.allocs == blocks_count + 2 && stats.used_blocks == 2 && stats.peak_used == blocks_count);
+    printf("                                           Done!\n");
+
+    printf("   testing uncontended mutex is not counted\n");
+    assert(stats.mutex_waits == 0 && stats.mutex_wait_ns == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing peak made of two threads' shards\n");
+    assert(stats_peak_threads(flags) == 0);
+    printf("                                           Done!\n");
+
+    printf("[Statistics test] Passed!\n");
+    return 0;
+}
+
+int test_yfree_lookup(uint32_t flags){
+    printf("\n[Pool-less free test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pools[LOOKUP_TEST_POOLS];
+    ypool_STC tiny[LOOKUP_TEST_TINY];
+    AD_POINTER tiny_blocks[LOOKUP_TEST_TINY];
+    AD_POINTER blocks[LOOKUP_TEST_POOLS][LOOKUP_TEST_BLOCKS];
+    size_t counts[LOOKUP_TEST_POOLS];
+    ypool_STC *owner;
+    AD_POINTER foreign;
+    size_t i, j;
+    int ret;
+
+    printf("   initializing pools\n");
+    for(i = 0; i < LOOKUP_TEST_POOLS; i++){
+        memset(&pools[i], 0, sizeof(pools[i]));
+        pools[i].block_size = BLOCK_SIZE * (i + 1);
+        pools[i].pool_size = POOL_SIZE * (i + 1);
+        pools[i].flags = flags;
+        pools[i].growth_factor = 2;
+        pools[i].max_pool_size = LOOKUP_TEST_BLOCKS * pools[i].block_size;
+        assert(ypool_init(&pools[i]) == 0);
+    }
+    printf("                                           Done!\n");
+
+    printf("   testing lookup of blocks of all pools\n");
+    for(i = 0; i < LOOKUP_TEST_POOLS; i++){
+        for(counts[i] = 0; counts[i] < LOOKUP_TEST_BLOCKS; counts[i]++){
+            ret = yalloc_block(&pools[i], &blocks[i][counts[i]]);
+            if (ret == -ENOMEM)
+                break;
+            assert(ret == 0);
+            assert(ypool_lookup(blocks[i][counts[i]], &owner) == 0 && owner == &pools[i]);
+        }
+        assert(counts[i] == ((flags & YPOOL_FLAG_GROWABLE) ? LOOKUP_TEST_BLOCKS : POOL_SIZE/BLOCK_SIZE));
+    }
+    assert(ypool_lookup(blocks[0][0], NULL) == -EFAULT);
+    assert(ypool_lookup((AD_POINTER)&owner, &owner) == -EXDEV && owner == NULL);
+    printf("                                           Done!\n");
+
+    printf("   testing free of foreign pointers\n");
+    foreign = malloc(BLOCK_SIZE);
+    assert(foreign != NULL);
+    assert(yfree(foreign) == -EXDEV);
+    assert(yfree((AD_POINTER)blocks) == -EXDEV);
+    assert(yfree(NULL) == -EXDEV);
+    free(foreign);
+    printf("                                           Done!\n");
+
+    printf("   testing free without pool in mixed order\n");
+    for(j = 0; j < LOOKUP_TEST_BLOCKS; j++)
+        for(i = 0; i < LOOKUP_TEST_POOLS; i++)
+            if (j < counts[LOOKUP_TEST_POOLS - 1 - i])
+                assert(yfree(blocks[LOOKUP_TEST_POOLS - 1 - i][counts[LOOKUP_TEST_POOLS - 1 - i] - 1 - j]) == 0);
+    for(i = 0; i < LOOKUP_TEST_POOLS; i++){
+        for(j = 0; j < counts[i]; j++)
+            assert(yfree(blocks[i][j]) == -EALREADY);
+
+        /* every block is back in its own pool */
+        for(j = 0; j < counts[i]; j++)
+            assert(yalloc_block(&pools[i], &blocks[i][j]) == 0);
+        assert(yalloc_block(&pools[i], &foreign) == -ENOMEM);
+        for(j = 0; j < counts[i]; j++)
+            assert(yfree(blocks[i][j]) == 0);
+    }
+    printf("                                           Done!\n");
+
+    /* small malloc arenas are not rounded to the grain & share it */
+    if (flags == 0){
+        printf("   testing pools sharing map grains\n");
+        for(i = 0; i < LOOKUP_TEST_TINY; i++){
+            memset(&tiny[i], 0, sizeof(tiny[i]));
+            tiny[i].block_size = BLOCK_SIZE;
+            tiny[i].pool_size = BLOCK_SIZE * 4;
+            assert(ypool_init(&tiny[i]) == 0);
+            assert(tiny[i].arena_size < YPOOL_MAP_GRAIN);
+            assert(yalloc_block(&tiny[i], &tiny_blocks[i]) == 0);
+        }
+        for(i = 0; i < LOOKUP_TEST_TINY; i++)
+            assert(ypool_lookup(tiny_blocks[i], &owner) == 0 && owner == &tiny[i]);
+
+        /* closed neighbours don't hide the rest */
+        for(i = 0; i < LOOKUP_TEST_TINY; i += 2)
+            assert(ypool_close(&tiny[i]) == 0);
+        for(i = 0; i < LOOKUP_TEST_TINY; i += 2)
+            assert(ypool_lookup(tiny_blocks[i], &owner) == -EXDEV);
+        for(i = 1; i < LOOKUP_TEST_TINY; i += 2){
+            assert(ypool_lookup(tiny_blocks[i], &owner) == 0 && owner == &tiny[i]);
+            assert(yfree(tiny_blocks[i]) == 0);
+            assert(ypool_close(&tiny[i]) == 0);
+        }
+        printf("                                           Done!\n");
+    }
+
+    /* released arena, slabs & detached mapping are unregistered */
+    printf("   testing lookup after close\n");
+    for(i = 0; i < LOOKUP_TEST_POOLS; i++){
+        assert(ypool_close(&pools[i]) == 0);
+        assert(ypool_close(&pools[i]) == -EINVAL);
+        for(j = 0; j < counts[i]; j++)
+            assert(ypool_lookup(blocks[i][j], &owner) == -EXDEV);
+    }
+
+    /* closed pool may be initialized again */
+    assert(ypool_init(&pools[0]) == 0);
+    assert(yalloc_block(&pools[0], &blocks[0][0]) == 0);
+    assert(ypool_lookup(blocks[0][0], &owner) == 0 && owner == &pools[0]);
+    assert(ypool_close(&pools[0]) == 0);
+    printf("                                           Done!\n");
+
+    printf("[Pool-less free test] Passed!\n");
+    return 0;
+}
+
+typedef struct _epoch_node
+{
+    uint64_t            value;
+    uint64_t            check;      /* ~value (poison or other writer's node breaks it) */
+}epoch_node_STC;
+
+typedef struct _epoch_arg
+{
+    ypool_STC         * pool;
+    epoch_node_STC   ** slots;
+    uint64_t            id;
+    int               * stop;       /* readers run until writers are done */
+}epoch_arg_STC;
+
+void *epoch_writer(void *vargp)
+{
+    epoch_arg_STC * arg = vargp;
+    epoch_node_STC * node;
+    epoch_node_STC * old;
+    AD_POINTER block;
+    uint64_t n;
+
+    for (n = 0; n < EPOCH_TEST_OPS; n++){
+        /* garbage is bounded, so the pool never runs dry */
+        assert(yalloc_block(arg->pool, &block) == 0);
+        node = block;
+        node->value = (arg->id << 32) | n;
+        node->check = ~node->value;
+
+        old = __atomic_exchange_n(&arg->slots[(n * 7 + arg->id) % EPOCH_TEST_SLOTS], node, __ATOMIC_ACQ_REL);
+
+        if (old != NULL)
+            assert(yfree_block_deferred(arg->pool, old) == 0);
+    }
+
+    return NULL;
+}
+
+void *epoch_reader(void *vargp)
+{
+    epoch_arg_STC * arg = vargp;
+    epoch_node_STC * node;
+    uint64_t value;
+    uint64_t n = 0;
+    int i;
+
+    while (!__atomic_load_n(arg->stop, __ATOMIC_ACQUIRE)){
+        assert(ypool_enter(arg->pool) == 0);
+        for (i = 0; i < EPOCH_TEST_SLOTS; i++){
+            node = __atomic_load_n(&arg->slots[(i + n) % EPOCH_TEST_SLOTS], __ATOMIC_ACQUIRE);
+            if (node == NULL)
+                continue;
+
+            /* node is not reused under the reader */
+            value = __atomic_load_n(&node->value, __ATOMIC_RELAXED);
+            assert(__atomic_load_n(&node->check, __ATOMIC_RELAXED) == ~value);
+            sched_yield();
+            assert(__atomic_load_n(&node->value, __ATOMIC_RELAXED) == value);
+        }
+        assert(ypool_exit(arg->pool) == 0);
+        n++;
+    }
+
+    return NULL;
+}
+
+int test_ypool_epoch(uint32_t flags){
+    printf("\n[Epoch reclamation test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, sizeof(epoch_node_STC), sizeof(epoch_node_STC) * EPOCH_TEST_BLOCKS, NULL, 0};
+    ypool_STC plain = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    ypool_STC bad = {NULL, BLOCK_SIZE, POOL_SIZE, NULL, 0};
+    epoch_node_STC * slots[EPOCH_TEST_SLOTS] = {0};
+    epoch_arg_STC args[EPOCH_TEST_WRITERS + EPOCH_TEST_READERS];
+    pthread_t thread_id[EPOCH_TEST_WRITERS + EPOCH_TEST_READERS];
+    AD_POINTER blocks[EPOCH_TEST_BLOCKS];
+    AD_POINTER our_block;
+    size_t count, retired;
+    int stop = 0;
+    int i, ret;
+
+    pool.flags = flags | YPOOL_FLAG_EPOCH;
+
+    printf("   initializing pool\n");
+    assert(ypool_init(&pool) == 0);
+    assert(ypool_init(&plain) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing errors\n");
+    assert(ypool_enter(NULL) == -EFAULT);
+    assert(ypool_enter(&plain) == -ENOTSUP);
+    assert(ypool_exit(&plain) == -ENOTSUP);
+    assert(ypool_synchronize(&plain) == -ENOTSUP);
+    assert(yalloc_block(&plain, &our_block) == 0);
+    assert(yfree_block_deferred(&plain, our_block) == -ENOTSUP);
+    assert(yfree_block_deferred(&pool, our_block) == -EXDEV);
+    assert(ypool_exit(&pool) == -EINVAL);
+
+    /* failed init leaves no thread keys behind */
+    for (i = 0; i < KEYS_TEST_INITS; i++){
+        bad.flags = YPOOL_FLAG_TRACE | YPOOL_FLAG_EPOCH | YPOOL_FLAG_NUMA | YPOOL_FLAG_GROWABLE;
+        assert(ypool_init(&bad) == -EINVAL);
+    }
+    bad.flags = YPOOL_FLAG_TRACE | YPOOL_FLAG_EPOCH | YPOOL_FLAG_TCACHE;
+    assert(ypool_init(&bad) == 0);
+    assert(ypool_close(&bad) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing retired block is kept while read section is open\n");
+    assert(yalloc_block(&pool, &our_block) == 0);
+    assert(ypool_enter(&pool) == 0);
+    assert(ypool_enter(&pool) == 0);
+    assert(yfree_block_deferred(&pool, our_block) == 0);
+    assert(ypool_synchronize(&pool) == -EBUSY);
+    assert(ypool_exit(&pool) == 0);
+    assert(ypool_synchronize(&pool) == -EBUSY);
+    assert(ypool_exit(&pool) == 0);
+    assert(ypool_exit(&pool) == -EINVAL);
+    for(count = 0; yalloc_block(&pool, &blocks[count]) == 0; count++)
+        assert(blocks[count] != our_block);
+    assert(count == EPOCH_TEST_BLOCKS - 1);
+    for(i = 0; i < count; i++)
+        assert(yfree_block(&pool, blocks[i]) == 0);
+    assert(ypool_synchronize(&pool) == 0);
+    assert(yalloc_block(&pool, &our_block) == 0);
+    assert(yfree_block(&pool, our_block) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing bounded garbage inside read section\n");
+    for(count = 0; yalloc_block(&pool, &blocks[count]) == 0; count++)
+        ;
+    assert(count == EPOCH_TEST_BLOCKS);
+    assert(ypool_enter(&pool) == 0);
+    for(retired = 0; (ret = yfree_block_deferred(&pool, blocks[retired])) == 0; retired++)
+        ;
+    assert(ret == -EBUSY);
+    assert(retired >= YPOOL_EBR_BATCH && retired <= 3 * YPOOL_EBR_BATCH);
+    assert(ypool_exit(&pool) == 0);
+    /* outside read section full bag moves the epoch on */
+    for(i = retired; i < count; i++)
+        assert(yfree_block_deferred(&pool, blocks[i]) == 0);
+    assert(ypool_synchronize(&pool) == 0);
+    for(count = 0; yalloc_block(&pool, &blocks[count]) == 0; count++)
+        ;
+    assert(count == EPOCH_TEST_BLOCKS);
+    for(i = 0; i < count; i++)
+        assert(yfree_block(&pool, blocks[i]) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing %d writers & %d readers\n", EPOCH_TEST_WRITERS, EPOCH_TEST_READERS);
+    for(i = 0; i < EPOCH_TEST_WRITERS + EPOCH_TEST_READERS; i++){
+        args[i].pool = &pool;
+        args[i].slots = slots;
+        args[i].id = i;
+        args[i].stop = &stop;
+        pthread_create(&thread_id[i], NULL, (i < EPOCH_TEST_WRITERS) ? epoch_writer : epoch_reader, &args[i]);
+    }
+    for(i = 0; i < EPOCH_TEST_WRITERS; i++)
+        pthread_join(thread_id[i], NULL);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+    for(i = EPOCH_TEST_WRITERS; i < EPOCH_TEST_WRITERS + EPOCH_TEST_READERS; i++)
+        pthread_join(thread_id[i], NULL);
+    printf("                                           Done!\n");
+
+    printf("   testing all blocks are back after synchronize\n");
+    for(i = 0; i < EPOCH_TEST_SLOTS; i++)
+        if (slots[i] != NULL)
+            assert(yfree_block_deferred(&pool, slots[i]) == 0);
+    /* bags of exited writers are reclaimed too */
+    assert(ypool_synchronize(&pool) == 0);
+    for(count = 0; yalloc_block(&pool, &blocks[count]) == 0; count++)
+        ;
+    assert(count == EPOCH_TEST_BLOCKS);
+    printf("                                           Done!\n");
+
+    printf("[Epoch reclamation test] Passed!\n");
+    return 0;
+}
@@ -2,6 +2,7 @@
 #define TEST_H
 #include "../libBlockAllocator/bin/allocator.h"
 #include "../libBlockAllocator/bin/autoconf.h"
+#include "../libBlockAllocator/bin/yheap.h"
 
 #define VERBOSE 0
 
@@ -10,9 +11,102 @@
 #define THREADS_COUNT            20 /* how many threads will use our allocator asynchronously */
 #define ALLOC_RETRY_WAIT_US    5000 /* how long wait to re-request block allocation */
 
+/* thread scaling mode */
+#define SCALING_ITERATIONS           100000 /* alloc/free pairs per thread */
+#define SCALING_BLOCKS_PER_THREAD         2 /* pool capacity per thread (keeps free list contended) */
+
+/* backing mode */
+#define BACKING_TEST_POOL_SIZE   (BLOCK_SIZE * 65536) /* several pages of arena */
+
+/* lazy format mode */
+#define LAZY_TEST_POOL_SIZE      (16 << 20)
+
+/* growable mode: POOL_SIZE arena + slabs of x2, x4, x8 (capped) */
+#define GROW_TEST_MAX_BLOCKS     (POOL_SIZE/BLOCK_SIZE * 8)
+#define GROW_TEST_SLABS          3
+
+/* NUMA pool: several blocks per node */
+#define NUMA_TEST_POOL_SIZE      (BLOCK_SIZE * 64)
+
+/* shared pool: processes attaching & detaching at once */
+#define SHARED_TEST_CHILDREN     4
+#define SHARED_TEST_ATTACHES     2000
+
+/* blocking allocation */
+#define WAIT_TEST_THREADS        4
+#define WAIT_TEST_TIMEOUT_US     5000000 /* parked threads must be served long before it */
+#define WAIT_TEST_SHORT_US       20000
+
+/* lowest-first pool: two summary levels over alloc_map */
+#define LOW_TEST_BLOCKS          (64 * 64 * 2 + 5)
+#define LOW_TEST_HOLE_START      4090 /* freed range crossing summary word boundary */
+#define LOW_TEST_HOLE_END        4200
+#define LOW_TEST_THREADS         4
+
+/* trim: arena of 256 pages (16 byte stride) */
+#define TRIM_TEST_BLOCKS         (65536)
+
+/* zeroed allocation: arena of several pages, big blocks are cleared with non-temporal stores */
+#define ZERO_TEST_BLOCK_SIZE     64
+#define ZERO_TEST_BLOCKS         4096
+#define ZERO_TEST_BIG_SIZE       (YPOOL_ZERO_NT_SIZE + 24) /* unaligned tail */
+#define ZERO_TEST_BIG_BLOCKS     4
+
+/* tracing: rings of concurrent threads wrap */
+#define TRACE_TEST_THREADS       4
+#define TRACE_TEST_POOL_SIZE     (BLOCK_SIZE * (TRACE_TEST_THREADS + 1) * (YTCACHE_SIZE + YTCACHE_BATCH)) /* thread caches don't starve others */
+#define TRACE_TEST_PAIRS         YPOOL_TRACE_EVENTS /* alloc/free pairs per thread (ring keeps the last YPOOL_TRACE_EVENTS - 1 events) */
+
+/* live block iteration: several scan chunks of YPOOL_SCAN_WORDS words */
+#define ITER_TEST_POOL_SIZE      (BLOCK_SIZE * 10000)
+#define ITER_TEST_CURSOR_BATCH   7
+#define ITER_TEST_CHURN_BLOCKS   8  /* blocks allocated & freed by churn thread during walks */
+#define ITER_TEST_WALKS          50
+
+/* pool-less free: blocks of several pools freed in mixed order */
+#define LOOKUP_TEST_POOLS        4
+#define LOOKUP_TEST_BLOCKS       (POOL_SIZE/BLOCK_SIZE * 4) /* blocks per pool (growable pool: arena + slabs) */
+#define LOOKUP_TEST_TINY         64 /* malloc pools far below a map grain */
+
+/* epoch-based reclamation: writers replace nodes of shared slots while readers check them */
+#define KEYS_TEST_INITS          (2 * PTHREAD_KEYS_MAX) /* failed inits, each one used to leak its keys */
+#define EPOCH_TEST_SLOTS         64
+#define EPOCH_TEST_WRITERS       4
+#define EPOCH_TEST_READERS       4
+#define EPOCH_TEST_OPS           200000 /* replacements per writer */
+#define EPOCH_TEST_BLOCKS        (EPOCH_TEST_SLOTS + (EPOCH_TEST_WRITERS + 1) * (3 * YPOOL_EBR_BATCH + YTCACHE_SIZE + YTCACHE_BATCH)) /* garbage bound + thread caches */
+
+/* size class heap */
+#define YHEAP_TEST_POOL_SIZE     4096 /* arena of every class pool */
+
+/* thread cache mode */
+#define TCACHE_TEST_BLOCKS     (YTCACHE_SIZE + YTCACHE_BATCH) /* one flush leaves YTCACHE_BATCH blocks in shared free list */
+
 /* funcs */
-int test_yalloc_single_thread();
+int test_yalloc_single_thread(uint32_t flags);
 int test_yalloc_multithreaded(int threads);  
+int test_yalloc_thread_scaling(int max_threads);
+int test_yalloc_tcache();
+int test_yalloc_batch(uint32_t flags);
+int test_yalloc_compact(uint32_t flags);
+int test_ypool_backing(uint32_t flags);
+int test_yalloc_lazy(uint32_t flags);
+int test_yalloc_growable(uint32_t flags);
+int test_ypool_hardened(uint32_t flags);
+int test_ypool_reset(uint32_t flags);
+int test_yalloc_lowfirst(uint32_t flags);
+int test_ypool_trim(uint32_t flags);
+int test_yalloc_zeroed(uint32_t flags);
+int test_ypool_trace(uint32_t flags);
+int test_ypool_for_each(uint32_t flags);
+int test_ypool_numa(uint32_t flags);
+int test_ypool_shared(uint32_t flags);
+int test_ypool_persistent(uint32_t flags);
+int test_ypool_stats(uint32_t flags);
+int test_yalloc_wait(uint32_t flags);
+int test_yheap(uint32_t flags);
+int test_yfree_lookup(uint32_t flags);
+int test_ypool_epoch(uint32_t flags);
 int emulate_pool_usage(ypool_STC * ypool);
 
 /* data used to test one block */
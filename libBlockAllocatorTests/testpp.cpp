@@ -0,0 +1,344 @@
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../libBlockAllocator/bin/ypool.hpp"
+#include "../libBlockAllocator/bin/ypool_resource.hpp"
+
+/* C++ tests: template pools (header-only) & adapters of ypool_STC */
+
+#define TPL_TEST_BLOCKS        64
+#define TPL_TEST_THREADS        4
+#define TPL_TEST_ITERATIONS 10000
+#define TPL_TEST_ROUNDS       100
+
+#define PMR_TEST_BLOCK_SIZE    64  /* fits list & map nodes */
+#define PMR_TEST_BLOCKS        32
+
+static int test_ypool_template();
+static int test_object_pool();
+static int test_ypool_template_threads();
+static int test_ypool_resource(uint32_t flags);
+
+int main()
+{
+    printf("[C++ tests] Start\n");
+
+    assert(test_ypool_template() == 0);
+    assert(test_object_pool() == 0);
+    assert(test_ypool_template_threads() == 0);
+    assert(test_ypool_resource(0) == 0);
+    assert(test_ypool_resource(YPOOL_FLAG_COMPACT | YPOOL_FLAG_TCACHE) == 0);
+    assert(test_ypool_resource(YPOOL_FLAG_COMPACT | YPOOL_FLAG_CANARY) == 0);
+
+    printf("[C++ tests] Successfuly end !\n");
+    return 0;
+}
+
+static int test_ypool_template(){
+    printf("\n[Template pool test] Start\n");
+
+    static yad::ypool<24, TPL_TEST_BLOCKS, 8, yad::ynull_mutex> pool;
+    static yad::ypool<1, 3, 64> wide;
+    void *blocks[TPL_TEST_BLOCKS];
+    void *block;
+    int i;
+
+    static_assert(decltype(pool)::stride == 8 + 24, "stride is header + block");
+    static_assert(decltype(wide)::stride == 128, "stride keeps alignment");
+
+    printf("   testing %d blocks allocation\n", TPL_TEST_BLOCKS);
+    for (i = 0; i < TPL_TEST_BLOCKS; i++){
+        assert(pool.alloc_block(&blocks[i]) == 0);
+        assert(reinterpret_cast<uintptr_t>(blocks[i]) % 8 == 0);
+        memset(blocks[i], i, 24);
+    }
+
+    assert(pool.alloc_block(&block) == -ENOMEM);
+    assert(pool.used_blocks() == TPL_TEST_BLOCKS);
+
+    for (i = 0; i < TPL_TEST_BLOCKS; i++)
+        assert(static_cast<unsigned char *>(blocks[i])[23] == i);
+    printf("                                           Done!\n");
+
+    printf("   testing errors\n");
+    assert(pool.free_block(static_cast<char *>(blocks[0]) + 1) == -EXDEV);
+    assert(pool.free_block(static_cast<char *>(blocks[TPL_TEST_BLOCKS - 1]) + decltype(pool)::stride) == -EXDEV);
+    assert(pool.free_block(&block) == -EXDEV);
+    assert(pool.free_block(blocks[5]) == 0);
+    assert(pool.free_block(blocks[5]) == -EALREADY);
+    printf("                                           Done!\n");
+
+    printf("   testing LIFO reuse\n");
+    assert(pool.alloc_block(&block) == 0 && block == blocks[5]);
+    for (i = 0; i < TPL_TEST_BLOCKS; i++)
+        assert(pool.free_block(blocks[i]) == 0);
+    assert(pool.free_blocks() == TPL_TEST_BLOCKS);
+    assert(pool.alloc_block(&block) == 0 && block == blocks[TPL_TEST_BLOCKS - 1]);
+    assert(pool.free_block(block) == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing never allocated block\n");
+    assert(wide.alloc_block(&block) == 0);
+    assert(reinterpret_cast<uintptr_t>(block) % 64 == 0);
+    assert(wide.free_block(static_cast<char *>(block) + decltype(wide)::stride) == -EALREADY);
+    assert(wide.free_block(block) == 0);
+    printf("                                           Done!\n");
+
+    printf("[Template pool test] Passed!\n");
+    return 0;
+}
+
+struct tracked
+{
+    static int alive;
+    alignas(32) uint64_t value;
+
+    explicit tracked(uint64_t v) : value(v) {
+        if (v == 0)
+            throw std::invalid_argument("zero");
+        alive++;
+    }
+    ~tracked() { alive--; }
+};
+
+int tracked::alive = 0;
+
+static int test_object_pool(){
+    printf("\n[Object pool test] Start\n");
+
+    static yad::object_pool<tracked, 4> pool;
+    tracked *objects[4];
+    tracked outside(7);
+    bool thrown = false;
+    int i;
+
+    printf("   testing construct/destroy\n");
+    for (i = 0; i < 4; i++){
+        objects[i] = pool.construct(i + 1);
+        assert(objects[i] != nullptr && objects[i]->value == (uint64_t)i + 1);
+        assert(reinterpret_cast<uintptr_t>(objects[i]) % 32 == 0);
+    }
+    assert(pool.construct(5) == nullptr);
+    assert(tracked::alive == 5);
+
+    assert(pool.destroy(&outside) == -EXDEV);
+    assert(pool.destroy(objects[0]) == 0);
+    assert(pool.destroy(objects[0]) == -EALREADY);
+    assert(tracked::alive == 4);
+    printf("                                           Done!\n");
+
+    printf("   testing throwing constructor\n");
+    try{
+        pool.construct(0);
+    }catch (const std::invalid_argument &){
+        thrown = true;
+    }
+    assert(thrown && pool.used() == 3);
+    printf("                                           Done!\n");
+
+    printf("   testing unique_ptr\n");
+    {
+        auto owned = pool.make_unique(42);
+        assert(owned && owned->value == 42 && pool.available() == 0);
+        assert(!pool.make_unique(43));
+    }
+    assert(pool.available() == 1 && tracked::alive == 4);
+
+    for (i = 1; i < 4; i++)
+        assert(pool.destroy(objects[i]) == 0);
+    assert(pool.used() == 0 && tracked::alive == 1);
+    printf("                                           Done!\n");
+
+    printf("[Object pool test] Passed!\n");
+    return 0;
+}
+
+struct destroyed_once
+{
+    static std::atomic<int> destroyed;
+    uint64_t value = 1;
+
+    /* yield keeps block allocated longer while other threads destroy the same object */
+    ~destroyed_once() { value = 0; destroyed++; std::this_thread::yield(); }
+};
+
+std::atomic<int> destroyed_once::destroyed{0};
+
+static int test_ypool_template_threads(){
+    printf("\n[Template pool threads test] Start\n");
+
+    static yad::ypool<16, TPL_TEST_THREADS * 2> pool;
+    static yad::object_pool<destroyed_once, TPL_TEST_BLOCKS> objects;
+    destroyed_once *created[TPL_TEST_BLOCKS];
+    std::atomic<int> destroys{0};
+    std::vector<std::thread> threads;
+    int i, round;
+
+    printf("   testing alloc/free from threads\n");
+    for (i = 0; i < TPL_TEST_THREADS; i++){
+        threads.emplace_back([i]{
+            void *block;
+            int n;
+
+            for (n = 0; n < TPL_TEST_ITERATIONS; n++){
+                assert(pool.alloc_block(&block) == 0);
+                memset(block, i, 16);
+                assert(static_cast<unsigned char *>(block)[15] == i);
+                assert(pool.free_block(block) == 0);
+            }
+        });
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    assert(pool.used_blocks() == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing destroy of the same objects from threads\n");
+    for (round = 0; round < TPL_TEST_ROUNDS; round++){
+        for (i = 0; i < TPL_TEST_BLOCKS; i++)
+            assert((created[i] = objects.construct()) != nullptr);
+
+        threads.clear();
+        for (i = 0; i < TPL_TEST_THREADS; i++){
+            threads.emplace_back([&]{
+                int n, ret;
+
+                for (n = 0; n < TPL_TEST_BLOCKS; n++){
+                    ret = objects.destroy(created[n]);
+                    assert(ret == 0 || ret == -EALREADY);
+                    if (ret == 0)
+                        destroys++;
+                }
+            });
+        }
+
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    /* every object destructed once, by the thread which won its block */
+    assert(destroys == TPL_TEST_ROUNDS * TPL_TEST_BLOCKS);
+    assert(destroyed_once::destroyed == TPL_TEST_ROUNDS * TPL_TEST_BLOCKS);
+    assert(objects.used() == 0);
+    printf("                                           Done!\n");
+
+    printf("[Template pool threads test] Passed!\n");
+    return 0;
+}
+
+/* upstream which counts requests pool didn't serve */
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+    size_t allocs = 0;
+    size_t live = 0;
+
+private:
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        allocs++;
+        live++;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *block, size_t bytes, size_t alignment) override {
+        live--;
+        std::pmr::new_delete_resource()->deallocate(block, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
+
+static int test_ypool_resource(uint32_t flags){
+    printf("\n[Memory resource test] Start (flags=0x%x)\n", flags);
+
+    ypool_STC pool = {NULL, PMR_TEST_BLOCK_SIZE, PMR_TEST_BLOCK_SIZE * PMR_TEST_BLOCKS, NULL, 0};
+    counting_resource upstream;
+    int i;
+
+    pool.flags = flags;
+    assert(ypool_init(&pool) == 0);
+
+    yad::ypool_resource resource(&pool, &upstream);
+
+    assert(resource.block_alignment() >= alignof(void *));
+
+    printf("   testing pmr containers\n");
+    {
+        std::pmr::list<int> list(&resource);
+        std::pmr::map<int, int> map(&resource);
+
+        for (i = 0; i < PMR_TEST_BLOCKS / 2; i++){
+            list.push_back(i);
+            map[i] = i;
+        }
+        assert(upstream.allocs == 0);
+
+        /* pool is exhausted, next nodes come from upstream */
+        list.push_back(-1);
+        assert(upstream.allocs == 1);
+
+        /* request bigger than block */
+        std::pmr::vector<int> vector(PMR_TEST_BLOCK_SIZE, 7, &resource);
+        assert(upstream.allocs == 2);
+
+        for (i = 0; i < PMR_TEST_BLOCKS / 2; i++)
+            assert(map[i] == i);
+    }
+    assert(upstream.live == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing allocator adapter\n");
+    {
+        yad::ypool_allocator<int> allocator(&resource);
+        std::list<int, yad::ypool_allocator<int>> list(allocator);
+
+        for (i = 0; i < PMR_TEST_BLOCKS; i++)
+            list.push_back(i);
+        assert(upstream.allocs == 2);
+
+        assert(list.get_allocator() == allocator);
+        assert(yad::ypool_allocator<long>(allocator) == allocator);
+        assert(list.back() == PMR_TEST_BLOCKS - 1);
+    }
+    assert(upstream.live == 0);
+    printf("                                           Done!\n");
+
+    printf("   testing block alignment\n");
+    {
+        void *blocks[PMR_TEST_BLOCKS];
+        size_t allocs = upstream.allocs;
+
+        /* guard word is part of the stride (YPOOL_FLAG_CANARY) */
+        if (flags & YPOOL_FLAG_CANARY)
+            assert(resource.block_alignment() == sizeof(uint64_t));
+
+        for (i = 0; i < PMR_TEST_BLOCKS; i++){
+            blocks[i] = resource.allocate(PMR_TEST_BLOCK_SIZE, resource.block_alignment());
+            assert(reinterpret_cast<uintptr_t>(blocks[i]) % resource.block_alignment() == 0);
+        }
+        assert(upstream.allocs == allocs);
+
+        for (i = 0; i < PMR_TEST_BLOCKS; i++)
+            resource.deallocate(blocks[i], PMR_TEST_BLOCK_SIZE, resource.block_alignment());
+
+        /* wider alignment than blocks have goes upstream */
+        blocks[0] = resource.allocate(PMR_TEST_BLOCK_SIZE, resource.block_alignment() * 2);
+        assert(reinterpret_cast<uintptr_t>(blocks[0]) % (resource.block_alignment() * 2) == 0);
+        assert(upstream.allocs == allocs + 1);
+        resource.deallocate(blocks[0], PMR_TEST_BLOCK_SIZE, resource.block_alignment() * 2);
+    }
+    assert(upstream.live == 0);
+    printf("                                           Done!\n");
+
+    printf("[Memory resource test] Passed!\n");
+    return 0;
+}
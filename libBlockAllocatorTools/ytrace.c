@@ -0,0 +1,362 @@
+#include <stdio.h>
+#include <memory.h>
+#include <unistd.h>
+
+#include "ytrace.h"
+
+/**
+    \file
+    \brief Offline report of ypool_trace_dump() output: block lifetimes, hot call sites & per-thread patterns
+
+    \details
+        Events of all rings are merged by time. Every free is matched with
+        the last allocation of the same block, lifetimes go to a log2
+        histogram & to the allocating call site. Call sites are return
+        addresses: resolve them with addr2line -e <app> (PIE apps need the
+        load base, see /proc/<pid>/maps of the traced process).
+*/
+
+/**
+    \brief Read dump file
+    \param[in] path Dump written by ypool_trace_dump()
+    \param[out] header Dump header
+    \param[out] events Events (malloc, caller frees)
+    \return 0 or -errno (-EINVAL - not a dump of this version)
+*/
+
+int ytrace_load(const char *path, ytrace_header_STC *header, ytrace_event_STC **events){
+    FILE *file;
+    int ret = 0;
+
+    file = fopen(path, "rb");
+
+    if (file == NULL)
+        return -errno;
+
+    *events = NULL;
+
+    if (fread(header, sizeof(*header), 1, file) != 1 || header->magic != YTRACE_MAGIC
+        || header->version != YTRACE_VERSION || header->event_size != sizeof(ytrace_event_STC)){
+        ret = -EINVAL;
+    }else if (header->events != 0){
+        *events = malloc(header->events * sizeof(ytrace_event_STC));
+
+        if (*events == NULL)
+            ret = -ENOMEM;
+        else if (fread(*events, sizeof(ytrace_event_STC), header->events, file) != header->events)
+            ret = -EINVAL;
+    }
+
+    fclose(file);
+
+    if (ret != 0){
+        free(*events);
+        *events = NULL;
+    }
+
+    return ret;
+}
+
+static int cmp_ticks(const void *a, const void *b){
+    const ytrace_event_STC *x = a;
+    const ytrace_event_STC *y = b;
+
+    if (x->ticks != y->ticks)
+        return (x->ticks < y->ticks) ? -1 : 1;
+
+    /* free of a block & its next allocation may share a tick */
+    return (int)y->op - (int)x->op;
+}
+
+static int cmp_sites(const void *a, const void *b){
+    const ytrace_site_STC *x = a;
+    const ytrace_site_STC *y = b;
+
+    if (x->allocs != y->allocs)
+        return (x->allocs > y->allocs) ? -1 : 1;
+
+    return (x->failed > y->failed) ? -1 : (x->failed < y->failed);
+}
+
+static uint64_t hash_block(uint64_t block){
+    return block * 0x9E3779B97F4A7C15ull;
+}
+
+static ytrace_live_STC *live_find(ytrace_report_STC *report, uint64_t block){
+    size_t i = hash_block(block) & (report->live_size - 1);
+
+    while (report->live[i].block != 0 && report->live[i].block != block)
+        i = (i + 1) & (report->live_size - 1);
+
+    return &report->live[i];
+}
+
+/* backward shift deletion keeps probe chains without tombstones */
+static void live_remove(ytrace_report_STC *report, ytrace_live_STC *slot){
+    size_t mask = report->live_size - 1;
+    size_t hole = slot - report->live;
+    size_t i = hole;
+    size_t home;
+
+    while (true)
+    {
+        i = (i + 1) & mask;
+
+        if (report->live[i].block == 0)
+            break;
+
+        home = hash_block(report->live[i].block) & mask;
+
+        /* entry may move to the hole if its home is not inside (hole, i] */
+        if (((i - home) & mask) >= ((i - hole) & mask)){
+            report->live[hole] = report->live[i];
+            hole = i;
+        }
+    }
+
+    report->live[hole].block = 0;
+    report->live_count--;
+}
+
+static uint32_t site_of(ytrace_report_STC *report, uint64_t caller){
+    size_t i;
+
+    for (i = 0; i < report->sites_count; i++)
+        if (report->sites[i].caller == caller)
+            return i;
+
+    memset(&report->sites[i], 0, sizeof(ytrace_site_STC));
+    report->sites[i].caller = caller;
+    report->sites_count++;
+
+    return i;
+}
+
+static ytrace_thread_STC *thread_of(ytrace_report_STC *report, uint32_t thread){
+    size_t i;
+
+    for (i = 0; i < report->threads_count; i++)
+        if (report->threads[i].thread == thread)
+            return &report->threads[i];
+
+    memset(&report->threads[i], 0, sizeof(ytrace_thread_STC));
+    report->threads[i].thread = thread;
+    report->threads_count++;
+
+    return &report->threads[i];
+}
+
+/**
+    \brief Merge events by time & build the report
+    \param[in] header Dump header
+    \param[in/out] events Dump events (sorted by time on return)
+    \param[out] report Report (release with free() of live, sites & threads)
+    \return 0 or -ENOMEM
+*/
+
+int ytrace_analyze(ytrace_header_STC *header, ytrace_event_STC *events, ytrace_report_STC *report){
+    ytrace_event_STC *event;
+    ytrace_live_STC *live;
+    ytrace_thread_STC *thread;
+    double lifetime;
+    uint64_t i;
+    int bucket;
+
+    memset(report, 0, sizeof(*report));
+
+    /* TSC to ns scale from the two clock pairs */
+    report->ns_per_tick = 1.0;
+    if (header->dump_ticks > header->start_ticks && header->dump_ns > header->start_ns)
+        report->ns_per_tick = (double)(header->dump_ns - header->start_ns) / (double)(header->dump_ticks - header->start_ticks);
+
+    for (report->live_size = 64; report->live_size < header->events * 2; report->live_size *= 2)
+        ;
+
+    report->live = calloc(report->live_size, sizeof(ytrace_live_STC));
+    report->sites = malloc((header->events + 1) * sizeof(ytrace_site_STC));
+    report->threads = malloc((header->events + 1) * sizeof(ytrace_thread_STC));
+
+    if (report->live == NULL || report->sites == NULL || report->threads == NULL)
+        return -ENOMEM;
+
+    qsort(events, header->events, sizeof(ytrace_event_STC), cmp_ticks);
+
+    for (i = 0; i < header->events; i++)
+    {
+        event = &events[i];
+        thread = thread_of(report, event->thread);
+
+        if (event->ret != 0){
+            thread->errors++;
+
+            if (event->op == YTRACE_ALLOC)
+                report->sites[site_of(report, event->caller)].failed++;
+            continue;
+        }
+
+        live = live_find(report, event->block);
+
+        if (event->op == YTRACE_ALLOC){
+            if (live->block == 0)
+                report->live_count++;
+
+            live->block = event->block;
+            live->ticks = event->ticks;
+            live->site = site_of(report, event->caller);
+            live->thread = event->thread;
+
+            report->sites[live->site].allocs++;
+            thread->allocs++;
+            continue;
+        }
+
+        thread->frees++;
+
+        if (live->block == 0){
+            report->unmatched_frees++;
+            continue;
+        }
+
+        lifetime = (double)(event->ticks - live->ticks) * report->ns_per_tick;
+
+        for (bucket = 0; bucket < YTRACE_BUCKETS - 1 && lifetime >= (double)(1ull << bucket); bucket++)
+            ;
+        report->histogram[bucket]++;
+
+        report->sites[live->site].frees++;
+        report->sites[live->site].lifetime_ns += lifetime;
+
+        if (live->thread != event->thread)
+            thread->remote_frees++;
+
+        live_remove(report, live);
+    }
+
+    qsort(report->sites, report->sites_count, sizeof(ytrace_site_STC), cmp_sites);
+
+    return 0;
+}
+
+static void print_ns(double ns){
+    if (ns < 1000.0)
+        printf("%8.0f ns", ns);
+    else if (ns < 1000000.0)
+        printf("%8.1f us", ns / 1000.0);
+    else if (ns < 1000000000.0)
+        printf("%8.1f ms", ns / 1000000.0);
+    else
+        printf("%8.1f s ", ns / 1000000000.0);
+}
+
+/**
+    \brief Print lifetime histogram, hot call sites & per-thread table
+    \param[in] header Dump header
+    \param[in] report Report of ytrace_analyze()
+    \param[in] top_sites Call sites to print
+*/
+
+void ytrace_print(ytrace_header_STC *header, ytrace_report_STC *report, size_t top_sites){
+    uint64_t max = 0;
+    uint64_t total = 0;
+    size_t i;
+    int bucket, bar;
+
+    printf("events: %llu (lost %llu), block size: %llu, ns per tick: %.4f\n",
+        (unsigned long long)header->events, (unsigned long long)header->lost,
+        (unsigned long long)header->block_size, report->ns_per_tick);
+    printf("live at dump: %zu, frees without recorded allocation: %llu\n",
+        report->live_count, (unsigned long long)report->unmatched_frees);
+
+    for (bucket = 0; bucket < YTRACE_BUCKETS; bucket++)
+    {
+        total += report->histogram[bucket];
+        if (report->histogram[bucket] > max)
+            max = report->histogram[bucket];
+    }
+
+    printf("\nblock lifetime (%llu freed blocks)\n", (unsigned long long)total);
+    for (bucket = 0; bucket < YTRACE_BUCKETS && total != 0; bucket++)
+    {
+        if (report->histogram[bucket] == 0)
+            continue;
+
+        printf("  < ");
+        print_ns((double)(1ull << bucket));
+        printf(" %10llu %5.1f%% ", (unsigned long long)report->histogram[bucket], 100.0 * report->histogram[bucket] / total);
+
+        for (bar = 0; bar < (int)((report->histogram[bucket] * YTRACE_BAR_WIDTH + max - 1) / max); bar++)
+            putchar('#');
+        putchar('\n');
+    }
+
+    printf("\nhot call sites (by allocations)\n");
+    printf("  %-18s %10s %10s %10s %13s\n", "caller", "allocs", "frees", "failed", "mean life");
+    for (i = 0; i < report->sites_count && i < top_sites; i++)
+    {
+        printf("  0x%016llx %10llu %10llu %10llu ", (unsigned long long)report->sites[i].caller,
+            (unsigned long long)report->sites[i].allocs, (unsigned long long)report->sites[i].frees,
+            (unsigned long long)report->sites[i].failed);
+
+        if (report->sites[i].frees != 0)
+            print_ns(report->sites[i].lifetime_ns / report->sites[i].frees);
+        else
+            printf("%11s", "-");
+        putchar('\n');
+    }
+
+    printf("\nthreads\n");
+    printf("  %-10s %10s %10s %12s %10s\n", "thread", "allocs", "frees", "remote frees", "errors");
+    for (i = 0; i < report->threads_count; i++)
+    {
+        printf("  %-10u %10llu %10llu %12llu %10llu\n", report->threads[i].thread,
+            (unsigned long long)report->threads[i].allocs, (unsigned long long)report->threads[i].frees,
+            (unsigned long long)report->threads[i].remote_frees, (unsigned long long)report->threads[i].errors);
+    }
+}
+
+static void usage(const char *app){
+    fprintf(stderr, "usage: %s [-s top_sites] dump\n", app);
+}
+
+int main(int argc, char *argv[]){
+    ytrace_header_STC header;
+    ytrace_event_STC *events;
+    ytrace_report_STC report;
+    size_t top_sites = YTRACE_TOP_SITES;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': top_sites = strtoul(optarg, NULL, 0); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    if (optind != argc - 1){
+        usage(argv[0]);
+        return 1;
+    }
+
+    ret = ytrace_load(argv[optind], &header, &events);
+
+    if (ret != 0){
+        fprintf(stderr, "[ytrace] unable to load %s: %s\n", argv[optind], strerror(-ret));
+        return 1;
+    }
+
+    ret = ytrace_analyze(&header, events, &report);
+
+    if (ret == 0)
+        ytrace_print(&header, &report, top_sites);
+    else
+        fprintf(stderr, "[ytrace] %s\n", strerror(-ret));
+
+    free(report.live);
+    free(report.sites);
+    free(report.threads);
+    free(events);
+
+    return (ret == 0) ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+#ifndef YTRACE_H
+#define YTRACE_H
+#include "../libBlockAllocator/bin/allocator.h"
+#include "../libBlockAllocator/bin/autoconf.h"
+
+/* defaults (override with command line options) */
+#define YTRACE_TOP_SITES          10  /* -s: call sites in the hot site report */
+
+/* lifetime histogram: bucket N holds lifetimes of [2^(N-1), 2^N) ns */
+#define YTRACE_BUCKETS            64
+#define YTRACE_BAR_WIDTH          40
+
+typedef struct _ytrace_live
+{
+    uint64_t        block;                  /* 0 - empty slot */
+    uint64_t        ticks;                  /* allocation time */
+    uint32_t        site;                   /* index of allocating call site */
+    uint32_t        thread;                 /* allocating thread */
+}ytrace_live_STC;
+
+typedef struct _ytrace_site
+{
+    uint64_t        caller;
+    uint64_t        allocs;
+    uint64_t        frees;                  /* frees of blocks allocated by the site */
+    uint64_t        failed;                 /* allocations which got no block */
+    double          lifetime_ns;            /* sum over freed blocks */
+}ytrace_site_STC;
+
+typedef struct _ytrace_thread
+{
+    uint32_t        thread;
+    uint64_t        allocs;
+    uint64_t        frees;
+    uint64_t        remote_frees;           /* frees of blocks allocated by other threads */
+    uint64_t        errors;                 /* failed allocations & frees */
+}ytrace_thread_STC;
+
+typedef struct _ytrace_report
+{
+    double          ns_per_tick;
+    ytrace_live_STC * live;                 /* open addressing by block address */
+    size_t          live_size;              /* power of 2 */
+    size_t          live_count;
+    ytrace_site_STC * sites;
+    size_t          sites_count;
+    ytrace_thread_STC * threads;
+    size_t          threads_count;
+    uint64_t        histogram[YTRACE_BUCKETS];
+    uint64_t        unmatched_frees;        /* block allocation was not recorded (lost or before tracing) */
+}ytrace_report_STC;
+
+/* funcs */
+int ytrace_load(const char *path, ytrace_header_STC *header, ytrace_event_STC **events);
+int ytrace_analyze(ytrace_header_STC *header, ytrace_event_STC *events, ytrace_report_STC *report);
+void ytrace_print(ytrace_header_STC *header, ytrace_report_STC *report, size_t top_sites);
+
+#endif //YTRACE_H